@@ -0,0 +1,64 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <iostream>
+#include <iomanip>
+#include "Benchmarks.hpp"
+#include "AnimationBake.hpp"
+
+namespace bench
+{
+    int run_bake_bench(const Args& args)
+    {
+        const std::vector<float> rates = args.sample_rates.size() ?
+            args.sample_rates :
+            std::vector<float>{ 15.0f, 30.0f, 60.0f };
+
+        auto mesh = load_mesh_headless(args);
+        auto pose = mesh->createPose();
+
+        std::cout << "Baked palettes, " << mesh->getNbrAnimations() << " clips, "
+            << pose.bone_matrices.size() << " bones\n";
+        std::cout << std::setw(8) << "rate"
+            << std::setw(10) << "frames"
+            << std::setw(12) << "KiB"
+            << std::setw(12) << "bake ms"
+            << std::setw(14) << "diff at key"
+            << std::setw(14) << "diff between" << "\n";
+
+        for (float rate : rates)
+        {
+            Timer timer;
+            const auto baked = eeng::bake_animations(*mesh, rate);
+            const double bake_ms = timer.elapsed_ms();
+
+            // Error of nearest-frame lookup, at baked frames and half-way between them
+            float diff_at_key = 0.0f, diff_between = 0.0f;
+            for (unsigned clip = 0; clip < baked.clips.size(); clip++)
+            {
+                const auto& baked_clip = baked.clips[clip];
+                for (uint32_t frame = 0; frame + 1 < baked_clip.nbr_frames; frame++)
+                {
+                    for (float ofs : { 0.0f, 0.49f })
+                    {
+                        const float ntime = (frame + ofs) / (baked_clip.nbr_frames - 1);
+                        mesh->animate(pose, clip, ntime, eeng::AnmationTimeFormat::NormalizedTime);
+                        const auto baked_frame = baked.frameAt(clip, ntime, eeng::AnmationTimeFormat::NormalizedTime);
+                        const float diff = max_difference(pose.bone_matrices.data(), baked.palette(baked_frame), baked.nbr_bones);
+                        float& max_diff = (ofs == 0.0f) ? diff_at_key : diff_between;
+                        max_diff = std::max(max_diff, diff);
+                    }
+                }
+            }
+
+            std::cout << std::setw(8) << rate
+                << std::setw(10) << baked.nbrFrames()
+                << std::setw(12) << std::fixed << std::setprecision(1) << baked.byteSize() / 1024.0
+                << std::setw(12) << std::setprecision(2) << bake_ms
+                << std::setw(14) << std::scientific << std::setprecision(1) << diff_at_key
+                << std::setw(14) << diff_between
+                << std::defaultfloat << "\n";
+        }
+        return 0;
+    }
+
+} // namespace bench
@@ -0,0 +1,91 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include "Benchmarks.hpp"
+#include "AnimationBatch.hpp"
+
+namespace bench
+{
+    int run_batch_bench(const Args& args)
+    {
+        auto mesh = load_mesh_headless(args);
+        const unsigned nbr_clips = mesh->getNbrAnimations();
+        if (!nbr_clips || args.instances <= 0)
+        {
+            std::cerr << "Needs at least one clip and one instance" << std::endl;
+            return 1;
+        }
+
+        // Instances blend between different clips at different times
+        std::vector<eeng::AnimationPose> poses(args.instances, mesh->createPose());
+        std::vector<eeng::AnimationJob> jobs(args.instances);
+        for (int i = 0; i < args.instances; i++)
+        {
+            auto& job = jobs[i];
+            job.mesh = mesh.get();
+            job.pose = &poses[i];
+            job.anim_index0 = i % nbr_clips;
+            job.anim_index1 = (i + 1) % nbr_clips;
+            job.frac = float(i % 11) / 10.0f;
+        }
+
+        // Thread counts 1, 2, 4, ... up to the requested or available number
+        const unsigned max_threads = args.threads > 0 ?
+            (unsigned)args.threads :
+            std::max(1u, std::thread::hardware_concurrency());
+        std::vector<unsigned> thread_counts;
+        for (unsigned n = 1; n < max_threads; n *= 2)
+            thread_counts.push_back(n);
+        thread_counts.push_back(max_threads);
+
+        std::cout << "Batch evaluation, " << args.instances << " blended instances, "
+            << args.frames << " frames, " << poses[0].nbr_nodes() << " nodes per pose\n";
+        std::cout << std::setw(10) << "threads"
+            << std::setw(14) << "ms/frame"
+            << std::setw(16) << "us/instance"
+            << std::setw(12) << "speedup"
+            << std::setw(14) << "efficiency" << "\n";
+
+        double single_thread_ms = 0.0;
+        float reference_checksum = 0.0f;
+        for (unsigned nbr_threads : thread_counts)
+        {
+            eeng::ThreadPool pool(nbr_threads);
+            float checksum = 0.0f;
+
+            Timer timer;
+            for (int frame = 0; frame < args.frames; frame++)
+            {
+                const float time = frame / 60.0f;
+                for (int i = 0; i < args.instances; i++)
+                {
+                    jobs[i].time0 = time + i * 0.01f;
+                    jobs[i].time1 = time + i * 0.02f;
+                }
+                eeng::animate_batch(pool, jobs);
+                checksum += pose_checksum(poses[frame % args.instances]);
+            }
+            const double ms = timer.elapsed_ms() / args.frames;
+            consume(checksum);
+
+            if (nbr_threads == thread_counts.front())
+            {
+                single_thread_ms = ms;
+                reference_checksum = checksum;
+            }
+            else if (checksum != reference_checksum)
+                std::cerr << "Warning: poses differ from single-threaded evaluation" << std::endl;
+
+            const double speedup = single_thread_ms / ms;
+            std::cout << std::setw(10) << nbr_threads
+                << std::setw(14) << std::fixed << std::setprecision(3) << ms
+                << std::setw(16) << 1e3 * ms / args.instances
+                << std::setw(12) << std::setprecision(2) << speedup
+                << std::setw(13) << std::setprecision(0) << 100.0 * speedup / nbr_threads << "%\n";
+        }
+        return 0;
+    }
+
+} // namespace bench
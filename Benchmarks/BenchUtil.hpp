@@ -0,0 +1,87 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef BenchUtil_hpp
+#define BenchUtil_hpp
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "RenderableMesh.hpp"
+
+namespace bench
+{
+    /// @brief Command line options shared by all benchmarks
+    struct Args
+    {
+        std::string mesh_file = "assets/Amy/Ch46_nonPBR.fbx";
+        std::vector<std::string> clip_files = {
+            "assets/Amy/idle.fbx",
+            "assets/Amy/walking.fbx",
+            "assets/Amy/running.fbx" };
+        std::vector<float> sample_rates;    //!< Empty means benchmark default
+        int iterations = 2000;
+        int frames = 60;                    //!< Frames of multi-instance benchmarks
+        int instances = 1000;
+        int threads = 0;                    //!< 0 means hardware concurrency
+        bool compress = false;              //!< Load clips compressed
+    };
+
+    /// @brief Parse options of the form --mesh file --clips a,b,c --rates 15,30 --iters N --frames N --instances N --threads N --compress 0|1
+    Args parse_args(int argc, char* argv[], int first_arg);
+
+    /// @brief Load a mesh and its clips without a GL context
+    /// @param xiflags Flags added to those of a headless load, e.g. xi_keep_cpu_geometry
+    std::shared_ptr<eeng::RenderableMesh> load_mesh_headless(
+        const Args& args,
+        float sample_rate = eeng::DefaultAnimationSampleRate,
+        unsigned xiflags = 0);
+
+    /// @brief Wall-clock timer
+    class Timer
+    {
+        using clock = std::chrono::steady_clock;
+        clock::time_point start_ = clock::now();
+
+    public:
+        void reset() { start_ = clock::now(); }
+
+        double elapsed_ms() const
+        {
+            return std::chrono::duration<double, std::milli>(clock::now() - start_).count();
+        }
+    };
+
+    /// @brief Keep the compiler from optimizing away benchmarked work
+    inline void consume(float value)
+    {
+        static volatile float sink;
+        sink = value;
+    }
+
+    /// @brief Cheap checksum of a pose, passed to consume()
+    inline float pose_checksum(const eeng::AnimationPose& pose)
+    {
+        float sum = 0.0f;
+        for (const auto& M : pose.bone_matrices)
+            sum += M.rows[0].w + M.rows[1].w + M.rows[2].w;
+        return sum;
+    }
+
+    /// @brief Largest element difference between two palettes
+    inline float max_difference(const eeng::Affine* a, const eeng::Affine* b, size_t nbr_bones)
+    {
+        float diff = 0.0f;
+        for (size_t i = 0; i < nbr_bones; i++)
+            for (int r = 0; r < 3; r++)
+                for (int c = 0; c < 4; c++)
+                    diff = std::max(diff, std::abs(a[i].rows[r][c] - b[i].rows[r][c]));
+        return diff;
+    }
+
+} // namespace bench
+
+#endif /* BenchUtil_hpp */
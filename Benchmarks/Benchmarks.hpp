@@ -0,0 +1,39 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef Benchmarks_hpp
+#define Benchmarks_hpp
+
+#include "BenchUtil.hpp"
+
+namespace bench
+{
+    /// @brief Cost of single-clip pose evaluation per node, for a range of sample rates
+    int run_sample_bench(const Args& args);
+
+    /// @brief Blended pose evaluation of many instances on a thread pool, for a range of thread counts
+    int run_batch_bench(const Args& args);
+
+    /// @brief Scalar (glm) vs SIMD evaluation of single-clip and blended poses
+    int run_eval_bench(const Args& args);
+
+    /// @brief Baking of palettes, and baked vs live palettes at and between baked frames
+    int run_bake_bench(const Args& args);
+
+    /// @brief CPU skinning throughput, for a range of thread counts
+    int run_skin_bench(const Args& args);
+
+    /// @brief Pose AABB update with and without per-part AABB's
+    int run_bounds_bench(const Args& args);
+
+    /// @brief Cooked clip size and read time, and playback of streamed clips under a memory budget
+    int run_stream_bench(const Args& args);
+
+    /// @brief Motion matching queries per second, scalar vs batched search, for a range of database sizes
+    int run_motion_bench(const Args& args);
+
+    /// @brief Sparse morph target update vs dense accumulation over all vertices
+    int run_morph_bench(const Args& args);
+
+} // namespace bench
+
+#endif /* Benchmarks_hpp */
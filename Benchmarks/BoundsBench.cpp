@@ -0,0 +1,82 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
+#include "Benchmarks.hpp"
+
+namespace bench
+{
+    namespace
+    {
+        float aabb_difference(const eeng::AABB& a, const eeng::AABB& b)
+        {
+            float diff = 0.0f;
+            for (int i = 0; i < 3; i++)
+                diff = std::max({ diff, std::abs(a.min[i] - b.min[i]), std::abs(a.max[i] - b.max[i]) });
+            return diff;
+        }
+    }
+
+    int run_bounds_bench(const Args& args)
+    {
+        auto mesh = load_mesh_headless(args);
+        auto pose = mesh->createPose();
+        const int clip = mesh->getNbrAnimations() ? 0 : -1;
+
+        std::cout << "Pose AABB update, " << args.iterations << " evaluations, "
+            << pose.nbr_bones() << " bones, " << pose.mesh_aabbs.size() << " meshes\n";
+        std::cout << std::setw(14) << "part aabbs"
+            << std::setw(14) << "us/pose" << "\n";
+
+        for (bool part_aabbs : { true, false })
+        {
+            pose.part_aabbs = part_aabbs;
+            Timer timer;
+            for (int i = 0; i < args.iterations; i++)
+            {
+                mesh->animate(pose, clip, float(i) / args.iterations, eeng::AnmationTimeFormat::NormalizedTime);
+                consume(pose.model_aabb.max.x);
+            }
+            const double ms = timer.elapsed_ms();
+
+            std::cout << std::setw(14) << (part_aabbs ? "yes" : "no")
+                << std::setw(14) << std::fixed << std::setprecision(2) << 1e3 * ms / args.iterations
+                << "\n";
+        }
+
+        // Compare with AABB::post_transform() of the bind AABB's
+        pose.part_aabbs = true;
+        mesh->animate(pose, clip, 0.5f, eeng::AnmationTimeFormat::NormalizedTime);
+        eeng::AABB model_aabb;
+        float max_diff = 0.0f;
+        for (size_t i = 0; i < pose.nbr_bones(); i++)
+        {
+            if (!mesh->m_bone_aabbs_bind[i])
+                continue;
+            const auto& M = pose.bone_matrices[i];
+            const auto aabb = mesh->m_bone_aabbs_bind[i].post_transform(M.translation(), M.linear());
+            max_diff = std::max(max_diff, aabb_difference(aabb, pose.bone_aabbs[i]));
+            model_aabb.grow(aabb);
+        }
+        for (size_t i = 0; i < mesh->m_meshes.size(); i++)
+        {
+            const auto& submesh = mesh->m_meshes[i];
+            if (submesh.is_skinned || !mesh->m_mesh_aabbs_bind[i])
+                continue;
+            if (submesh.node_index > EENG_NULL_INDEX)
+            {
+                const auto& M = pose.global_tfms[submesh.node_index];
+                model_aabb.grow(mesh->m_mesh_aabbs_bind[i].post_transform(M.translation(), M.linear()));
+            }
+            else
+                model_aabb.grow(mesh->m_mesh_aabbs_bind[i]);
+        }
+        std::cout << "Max difference to post_transform: " << std::scientific << std::setprecision(1)
+            << max_diff << " (bones), " << aabb_difference(model_aabb, pose.model_aabb) << " (model)"
+            << std::defaultfloat << "\n";
+        return 0;
+    }
+
+} // namespace bench
@@ -0,0 +1,78 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
+#include "Benchmarks.hpp"
+
+namespace bench
+{
+    namespace
+    {
+        /// Time iterations of single-clip (or blended, if clip1 >= 0) evaluation
+        double time_evaluation(
+            const eeng::RenderableMesh& mesh,
+            eeng::AnimationPose& pose,
+            int clip0,
+            int clip1,
+            int iterations)
+        {
+            Timer timer;
+            for (int i = 0; i < iterations; i++)
+            {
+                const float ntime = float(i) / iterations;
+                if (clip1 >= 0)
+                    mesh.animateBlend(pose, clip0, clip1, ntime, 1.0f - ntime, 0.5f,
+                        eeng::AnmationTimeFormat::NormalizedTime,
+                        eeng::AnmationTimeFormat::NormalizedTime);
+                else
+                    mesh.animate(pose, clip0, ntime, eeng::AnmationTimeFormat::NormalizedTime);
+                consume(pose_checksum(pose));
+            }
+            return timer.elapsed_ms();
+        }
+    }
+
+    int run_eval_bench(const Args& args)
+    {
+        using eeng::AnimationEvaluator;
+        auto mesh = load_mesh_headless(args);
+        const int nbr_clips = (int)mesh->getNbrAnimations();
+        auto pose_scalar = mesh->createPose();
+        auto pose_simd = mesh->createPose();
+
+        std::cout << "Scalar vs SIMD evaluation ("
+            << (eeng::pose_evaluator_is_vectorized() ? "SSE" : "scalar fallback") << ", "
+            << eeng::PoseEvaluatorWidth << " nodes at once), "
+            << args.iterations << " evaluations, " << pose_scalar.nbr_nodes() << " nodes\n";
+        std::cout << std::setw(24) << "clip"
+            << std::setw(10) << "blend"
+            << std::setw(14) << "scalar us"
+            << std::setw(14) << "simd us"
+            << std::setw(10) << "speedup"
+            << std::setw(14) << "max diff" << "\n";
+
+        for (int clip = 0; clip < nbr_clips; clip++)
+        {
+            // Single clip, and a blend with the next clip
+            for (int blend_clip : { -1, (clip + 1) % nbr_clips })
+            {
+                mesh->setAnimationEvaluator(AnimationEvaluator::Scalar);
+                const double scalar_ms = time_evaluation(*mesh, pose_scalar, clip, blend_clip, args.iterations);
+                mesh->setAnimationEvaluator(AnimationEvaluator::Simd);
+                const double simd_ms = time_evaluation(*mesh, pose_simd, clip, blend_clip, args.iterations);
+
+                std::cout << std::setw(24) << mesh->getAnimationName(clip).substr(0, 22)
+                    << std::setw(10) << (blend_clip >= 0 ? std::to_string(blend_clip) : "-")
+                    << std::setw(14) << std::fixed << std::setprecision(2) << 1e3 * scalar_ms / args.iterations
+                    << std::setw(14) << 1e3 * simd_ms / args.iterations
+                    << std::setw(10) << scalar_ms / simd_ms
+                    << std::setw(14) << std::scientific << std::setprecision(1) << max_difference(pose_scalar.bone_matrices.data(), pose_simd.bone_matrices.data(), pose_scalar.bone_matrices.size())
+                    << "\n";
+            }
+        }
+        return 0;
+    }
+
+} // namespace bench
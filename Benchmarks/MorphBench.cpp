@@ -0,0 +1,99 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include "Benchmarks.hpp"
+
+namespace bench
+{
+    int run_morph_bench(const Args& args)
+    {
+        auto mesh = load_mesh_headless(args, eeng::DefaultAnimationSampleRate, eeng::xi_keep_cpu_geometry);
+        const size_t nbr_vertices = mesh->getNbrVertices();
+        const std::vector<glm::vec3> base(mesh->getCpuPositions().begin(), mesh->getCpuPositions().end());
+
+        // Synthetic targets that move a block of vertices, if the mesh has none
+        if (!mesh->getNbrMorphTargets())
+        {
+            for (float fraction : { 0.01f, 0.05f, 0.25f, 1.0f })
+            {
+                const size_t count = std::max<size_t>(1, size_t(fraction * nbr_vertices));
+                const size_t first = (nbr_vertices - count) / 2;
+                std::vector<uint32_t> vertices;
+                std::vector<glm::vec3> deltas;
+                for (size_t i = first; i < first + count; i++)
+                {
+                    vertices.push_back((uint32_t)i);
+                    deltas.push_back(glm::vec3(std::sin(i * 0.1f), std::cos(i * 0.1f), 0.5f));
+                }
+                mesh->addMorphTarget("block" + std::to_string(count), vertices, deltas);
+            }
+        }
+
+        const int iterations = std::max(1, args.iterations / 10);
+        std::cout << "Morph target update, " << nbr_vertices << " vertices, " << iterations << " updates per target\n";
+        std::cout << std::setw(24) << "target"
+            << std::setw(12) << "moved"
+            << std::setw(10) << "runs"
+            << std::setw(14) << "sparse us"
+            << std::setw(14) << "dense us"
+            << std::setw(12) << "speedup"
+            << std::setw(12) << "max err" << "\n";
+
+        std::vector<glm::vec3> dense_deltas(nbr_vertices), dense_positions(nbr_vertices);
+        for (unsigned t = 0; t < mesh->getNbrMorphTargets(); t++)
+        {
+            const auto& target = mesh->getMorphTarget(t);
+
+            // Sparse update, alternating weights so that every update is dirty
+            Timer timer;
+            for (int i = 0; i < iterations; i++)
+            {
+                mesh->setMorphWeight(t, (i & 1) ? 0.25f : 0.75f);
+                mesh->updateMorphTargets();
+                consume(mesh->getCpuPositions()[target.begin].x);
+            }
+            const double sparse_us = 1e3 * timer.elapsed_ms() / iterations;
+            const float weight = mesh->getMorphWeight(t);
+
+            // Dense reference: a delta per vertex of the mesh
+            std::fill(dense_deltas.begin(), dense_deltas.end(), glm::vec3(0.0f));
+            for (const auto& run : target.runs)
+                for (uint32_t v = 0; v < run.count; v++)
+                    dense_deltas[run.begin + v] = target.position_deltas[run.delta_ofs + v];
+            timer.reset();
+            for (int i = 0; i < iterations; i++)
+            {
+                const float w = (i & 1) ? 0.25f : 0.75f;
+                for (size_t v = 0; v < nbr_vertices; v++)
+                    dense_positions[v] = base[v] + w * dense_deltas[v];
+                consume(dense_positions[target.begin].x);
+            }
+            const double dense_us = 1e3 * timer.elapsed_ms() / iterations;
+
+            float max_err = 0.0f;
+            const auto positions = mesh->getCpuPositions();
+            for (size_t v = 0; v < nbr_vertices; v++)
+            {
+                const glm::vec3 d = glm::abs(positions[v] - (base[v] + weight * dense_deltas[v]));
+                max_err = std::max(max_err, std::max(d.x, std::max(d.y, d.z)));
+            }
+
+            mesh->setMorphWeight(t, 0.0f);
+            mesh->updateMorphTargets();
+
+            std::cout << std::setw(24) << target.name
+                << std::setw(12) << target.nbrDeltas()
+                << std::setw(10) << target.runs.size()
+                << std::setw(14) << std::fixed << std::setprecision(2) << sparse_us
+                << std::setw(14) << dense_us
+                << std::setw(12) << dense_us / sparse_us
+                << std::setw(12) << std::scientific << std::setprecision(1) << max_err
+                << "\n";
+        }
+        std::cout << std::defaultfloat;
+        return 0;
+    }
+
+} // namespace bench
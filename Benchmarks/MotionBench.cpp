@@ -0,0 +1,98 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <cmath>
+#include "Benchmarks.hpp"
+#include "MotionDatabase.hpp"
+
+namespace bench
+{
+    int run_motion_bench(const Args& args)
+    {
+        auto mesh = load_mesh_headless(args);
+        std::vector<int> clips;
+        for (unsigned i = 0; i < mesh->getNbrAnimations(); i++)
+            clips.push_back(i);
+        if (clips.empty())
+        {
+            std::cout << "No clips to match\n";
+            return 1;
+        }
+
+        const float budget_ms = 0.1f;
+        const int nbr_queries = std::max(1, args.iterations / 4);
+        std::cout << "Motion matching search, " << nbr_queries << " queries per size, "
+            << eeng::MotionFeatureCount << " features, " << eeng::MotionBatchWidth << " frames per batch\n";
+        std::cout << std::setw(10) << "frames"
+            << std::setw(12) << "KB"
+            << std::setw(16) << "scalar q/s"
+            << std::setw(16) << "batched q/s"
+            << std::setw(12) << "speedup"
+            << std::setw(12) << "mismatch"
+            << std::setw(20) << "complete @0.1ms" << "\n";
+
+        // Larger databases list the clips more than once
+        for (int copies : { 1, 4, 16, 64 })
+        {
+            std::vector<int> db_clips;
+            for (int c = 0; c < copies; c++)
+                db_clips.insert(db_clips.end(), clips.begin(), clips.end());
+            eeng::MotionDatabase db;
+            db.build(*mesh, db_clips);
+
+            // Queries from random frames and desired velocities
+            std::mt19937 rng(1234);
+            std::uniform_int_distribution<size_t> frame_dist(0, db.nbrFrames() - 1);
+            std::uniform_real_distribution<float> dir_dist(-1.0f, 1.0f);
+            std::vector<eeng::MotionDatabase::Features> queries;
+            std::vector<size_t> frames;
+            for (int i = 0; i < nbr_queries; i++)
+            {
+                frames.push_back(frame_dist(rng));
+                const glm::vec3 velocity(dir_dist(rng) * 300.0f, 0.0f, dir_dist(rng) * 300.0f);
+                queries.push_back(db.makeQuery(frames.back(), velocity, { dir_dist(rng), 0.0f, dir_dist(rng) }));
+            }
+
+            Timer timer;
+            float sum = 0.0f;
+            for (const auto& query : queries)
+                sum += db.searchScalar(query).cost;
+            const double scalar_ms = timer.elapsed_ms();
+            consume(sum);
+
+            timer.reset();
+            int mismatches = 0;
+            for (int i = 0; i < nbr_queries; i++)
+            {
+                const auto match = db.search(queries[i]);
+                consume(match.cost);
+                // Frames may differ for equal costs
+                const float reference = db.searchScalar(queries[i]).cost;
+                if (std::abs(match.cost - reference) > 1e-4f * std::max(1.0f, reference))
+                    mismatches++;
+            }
+            timer.reset();
+            for (const auto& query : queries)
+                consume(db.search(query).cost);
+            const double batched_ms = timer.elapsed_ms();
+
+            int complete = 0;
+            for (int i = 0; i < nbr_queries; i++)
+                complete += db.search(queries[i], budget_ms, frames[i]).complete;
+
+            std::cout << std::setw(10) << db.nbrFrames()
+                << std::setw(12) << std::fixed << std::setprecision(1) << db.byteSize() / 1024.0
+                << std::setw(16) << std::setprecision(0) << 1e3 * nbr_queries / scalar_ms
+                << std::setw(16) << 1e3 * nbr_queries / batched_ms
+                << std::setw(12) << std::setprecision(2) << scalar_ms / batched_ms
+                << std::setw(12) << mismatches
+                << std::setw(19) << std::setprecision(1) << 100.0 * complete / nbr_queries << "%"
+                << "\n";
+        }
+        std::cout << std::defaultfloat;
+        return 0;
+    }
+
+} // namespace bench
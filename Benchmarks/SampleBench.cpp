@@ -0,0 +1,50 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <iostream>
+#include <iomanip>
+#include "Benchmarks.hpp"
+
+namespace bench
+{
+    int run_sample_bench(const Args& args)
+    {
+        const std::vector<float> rates = args.sample_rates.size() ?
+            args.sample_rates :
+            std::vector<float>{ 15.0f, 30.0f, 60.0f };
+
+        std::cout << "Pose evaluation, " << args.iterations << " evaluations per clip\n";
+        std::cout << std::setw(8) << "rate"
+            << std::setw(24) << "clip"
+            << std::setw(10) << "nodes"
+            << std::setw(14) << "us/pose"
+            << std::setw(14) << "ns/node" << "\n";
+
+        for (float rate : rates)
+        {
+            auto mesh = load_mesh_headless(args, rate);
+            auto pose = mesh->createPose();
+            const size_t nbr_nodes = pose.nbr_nodes();
+
+            for (unsigned clip = 0; clip < mesh->getNbrAnimations(); clip++)
+            {
+                // Sweep normalized time so every key interval is visited
+                Timer timer;
+                for (int i = 0; i < args.iterations; i++)
+                {
+                    const float ntime = float(i) / args.iterations;
+                    mesh->animate(pose, clip, ntime, eeng::AnmationTimeFormat::NormalizedTime);
+                    consume(pose_checksum(pose));
+                }
+                const double ms = timer.elapsed_ms();
+
+                std::cout << std::setw(8) << rate
+                    << std::setw(24) << mesh->getAnimationName(clip).substr(0, 22)
+                    << std::setw(10) << nbr_nodes
+                    << std::setw(14) << std::fixed << std::setprecision(2) << 1e3 * ms / args.iterations
+                    << std::setw(14) << 1e6 * ms / (double(args.iterations) * nbr_nodes) << "\n";
+            }
+        }
+        return 0;
+    }
+
+} // namespace bench
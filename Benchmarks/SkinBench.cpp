@@ -0,0 +1,62 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include "Benchmarks.hpp"
+#include "ThreadPool.hpp"
+
+namespace bench
+{
+    int run_skin_bench(const Args& args)
+    {
+        auto mesh = load_mesh_headless(args, eeng::DefaultAnimationSampleRate, eeng::xi_keep_cpu_geometry);
+        const size_t nbr_vertices = mesh->getNbrVertices();
+        auto pose = mesh->createPose();
+        if (mesh->getNbrAnimations())
+            mesh->animate(pose, 0, 0.5f, eeng::AnmationTimeFormat::NormalizedTime);
+
+        std::vector<glm::vec3> positions(nbr_vertices), normals(nbr_vertices);
+
+        // Thread counts 1, 2, 4, ... up to the requested or available number
+        const unsigned max_threads = args.threads > 0 ?
+            (unsigned)args.threads :
+            std::max(1u, std::thread::hardware_concurrency());
+        std::vector<unsigned> thread_counts;
+        for (unsigned n = 1; n < max_threads; n *= 2)
+            thread_counts.push_back(n);
+        thread_counts.push_back(max_threads);
+
+        const int iterations = std::max(1, args.iterations / 20);
+        std::cout << "CPU skinning (" << eeng::cpu_skinning_isa() << ", "
+            << eeng::cpu_skinning_width() << " vertices at once), "
+            << nbr_vertices << " vertices, " << iterations << " skins\n";
+        std::cout << std::setw(10) << "threads"
+            << std::setw(10) << "normals"
+            << std::setw(14) << "ms/skin"
+            << std::setw(16) << "Mvertices/s" << "\n";
+
+        for (unsigned nbr_threads : thread_counts)
+        {
+            eeng::ThreadPool pool(nbr_threads);
+            for (bool with_normals : { false, true })
+            {
+                Timer timer;
+                for (int i = 0; i < iterations; i++)
+                {
+                    mesh->skin(pose, positions, with_normals ? std::span<glm::vec3>(normals) : std::span<glm::vec3>(), &pool);
+                    consume(positions[i % nbr_vertices].x);
+                }
+                const double ms = timer.elapsed_ms();
+
+                std::cout << std::setw(10) << nbr_threads
+                    << std::setw(10) << (with_normals ? "yes" : "no")
+                    << std::setw(14) << std::fixed << std::setprecision(3) << ms / iterations
+                    << std::setw(16) << std::setprecision(1) << 1e-3 * nbr_vertices * iterations / ms
+                    << "\n";
+            }
+        }
+        return 0;
+    }
+
+} // namespace bench
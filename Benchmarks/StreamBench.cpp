@@ -0,0 +1,105 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include "Benchmarks.hpp"
+#include "ClipStreamer.hpp"
+
+namespace bench
+{
+    int run_stream_bench(const Args& args)
+    {
+        // Compressed clips cannot be cooked
+        Args mesh_args = args;
+        mesh_args.compress = false;
+        auto mesh = load_mesh_headless(mesh_args);
+        const unsigned nbr_clips = mesh->getNbrAnimations();
+        if (!nbr_clips)
+        {
+            std::cout << "No clips to stream\n";
+            return 1;
+        }
+
+        // Cook all clips, with fallback keys at a low rate
+        const float fallback_rate = 5.0f;
+        const auto dir = std::filesystem::temp_directory_path() / "eeng_stream_bench";
+        std::filesystem::create_directories(dir);
+        std::vector<std::string> files;
+        for (unsigned i = 0; i < nbr_clips; i++)
+        {
+            files.push_back((dir / ("clip" + std::to_string(i) + ".eeclip")).string());
+            mesh->cookAnimation(i, files.back(), fallback_rate);
+        }
+
+        std::cout << "Cooked clips, fallback keys at " << fallback_rate << " samples/s\n";
+        std::cout << std::setw(24) << "clip"
+            << std::setw(12) << "KB"
+            << std::setw(14) << "fallback KB"
+            << std::setw(12) << "read ms" << "\n";
+        size_t max_bytes = 0;
+        for (unsigned i = 0; i < nbr_clips; i++)
+        {
+            Timer timer;
+            auto clip = eeng::ClipStreamer::read(files[i], true);
+            const double ms = timer.elapsed_ms();
+            const auto fallback = eeng::ClipStreamer::read(files[i], false);
+            max_bytes = std::max(max_bytes, clip->byteSize());
+
+            std::cout << std::setw(24) << mesh->getAnimationName(i).substr(0, 23)
+                << std::setw(12) << std::fixed << std::setprecision(1) << clip->byteSize() / 1024.0
+                << std::setw(14) << fallback->byteSize() / 1024.0
+                << std::setw(12) << std::setprecision(3) << ms << "\n";
+        }
+
+        // Play the clips in turn, twice, with a budget that fits one clip
+        eeng::ClipStreamer streamer(max_bytes);
+        mesh_args.clip_files.clear();
+        auto streamed_mesh = load_mesh_headless(mesh_args);
+        std::vector<int> clip_indices;
+        for (const auto& file : files)
+            clip_indices.push_back(streamed_mesh->addStreamedAnimation(streamer, file));
+
+        auto pose = streamed_mesh->createPose();
+        size_t fallback_frames = 0, nbr_loads = 0, peak_bytes = 0;
+        double load_ms = 0.0;
+        for (unsigned round = 0; round < 2 * nbr_clips; round++)
+        {
+            const unsigned i = round % nbr_clips;
+            const eeng::StreamedClip* stream = streamer.registerClip(files[i]);
+            const bool was_resident = (stream->resident != nullptr);
+            bool counted = was_resident;
+            Timer timer;
+            for (int frame = 0; frame < args.frames; frame++)
+            {
+                streamer.update();
+                peak_bytes = std::max(peak_bytes, streamer.residentBytes());
+                if (!stream->resident)
+                    fallback_frames++;
+                else if (!counted)
+                {
+                    // Time from first play to first frame with full-rate keys
+                    load_ms += timer.elapsed_ms();
+                    nbr_loads++;
+                    counted = true;
+                }
+                streamed_mesh->animate(pose, clip_indices[i], float(frame) / args.frames, eeng::AnmationTimeFormat::NormalizedTime);
+                consume(pose_checksum(pose));
+            }
+        }
+        streamer.flush();
+
+        std::cout << "Streamed playback, " << 2 * nbr_clips << " clip switches of " << args.frames << " frames, budget "
+            << std::setprecision(1) << max_bytes / 1024.0 << " KB\n"
+            << "Frames on fallback keys: " << fallback_frames << ", " << nbr_loads << " loads, "
+            << std::setprecision(3) << (nbr_loads ? load_ms / nbr_loads : 0.0) << " ms from first play to resident\n"
+            << "Peak resident: " << std::setprecision(1) << peak_bytes / 1024.0 << " KB, resident after: "
+            << streamer.nbrResident() << " of " << streamer.nbrClips() << " clips\n";
+        std::cout << std::defaultfloat;
+
+        std::filesystem::remove_all(dir);
+        return 0;
+    }
+
+} // namespace bench
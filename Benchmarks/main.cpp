@@ -0,0 +1,125 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+// Headless benchmarks for CPU-side animation.
+// Run from the repository root, so that asset paths resolve:
+//      AnimationBench <benchmark> [options]
+
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include "Benchmarks.hpp"
+
+namespace
+{
+    struct Benchmark
+    {
+        const char* name;
+        const char* description;
+        int (*run)(const bench::Args&);
+    };
+
+    const Benchmark benchmarks[] = {
+        { "sample", "Single-clip pose evaluation per node", bench::run_sample_bench },
+        { "batch", "Parallel blended pose evaluation of many instances", bench::run_batch_bench },
+        { "eval", "Scalar vs SIMD pose evaluation", bench::run_eval_bench },
+        { "bake", "Baked animation palettes", bench::run_bake_bench },
+        { "skin", "CPU skinning of all vertices", bench::run_skin_bench },
+        { "bounds", "Pose AABB update", bench::run_bounds_bench },
+        { "stream", "Clip streaming from cooked files", bench::run_stream_bench },
+        { "motion", "Motion matching search", bench::run_motion_bench },
+        { "morph", "Sparse morph target update", bench::run_morph_bench },
+    };
+
+    template<class T>
+    std::vector<T> split_list(const std::string& list)
+    {
+        std::vector<T> values;
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            std::stringstream item_ss(item);
+            T value;
+            item_ss >> value;
+            values.push_back(value);
+        }
+        return values;
+    }
+
+    void print_usage()
+    {
+        std::cout << "Usage: AnimationBench <benchmark> [--mesh file] [--clips a,b,c] [--rates r0,r1]"
+            << " [--iters N] [--frames N] [--instances N] [--threads N] [--compress 0|1]\n"
+            << "Benchmarks:\n";
+        for (const auto& benchmark : benchmarks)
+            std::cout << "\t" << benchmark.name << " - " << benchmark.description << "\n";
+    }
+}
+
+namespace bench
+{
+    Args parse_args(int argc, char* argv[], int first_arg)
+    {
+        Args args;
+        for (int i = first_arg; i + 1 < argc; i += 2)
+        {
+            const std::string option = argv[i];
+            const std::string value = argv[i + 1];
+            if (option == "--mesh") args.mesh_file = value;
+            else if (option == "--clips") args.clip_files = split_list<std::string>(value);
+            else if (option == "--rates") args.sample_rates = split_list<float>(value);
+            else if (option == "--iters") args.iterations = std::stoi(value);
+            else if (option == "--frames") args.frames = std::stoi(value);
+            else if (option == "--instances") args.instances = std::stoi(value);
+            else if (option == "--threads") args.threads = std::stoi(value);
+            else if (option == "--compress") args.compress = (std::stoi(value) != 0);
+            else std::cerr << "Unknown option " << option << std::endl;
+        }
+        return args;
+    }
+
+    std::shared_ptr<eeng::RenderableMesh> load_mesh_headless(const Args& args, float sample_rate, unsigned xiflags)
+    {
+        using namespace eeng;
+        auto mesh = std::make_shared<RenderableMesh>();
+        mesh->setAnimationSampleRate(sample_rate);
+        if (args.compress)
+        {
+            AnimationCompression compression;
+            compression.enabled = true;
+            mesh->setAnimationCompression(compression);
+        }
+        mesh->load(args.mesh_file, xi_load_meshes | xi_load_animations | xi_headless | xiflags, DefaultAiFlags);
+        for (const auto& clip_file : args.clip_files)
+            mesh->load(clip_file, xi_load_animations | xi_headless, DefaultAiFlags);
+        return mesh;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        print_usage();
+        return 0;
+    }
+
+    for (const auto& benchmark : benchmarks)
+    {
+        if (std::strcmp(argv[1], benchmark.name))
+            continue;
+
+        try
+        {
+            return benchmark.run(bench::parse_args(argc, argv, 2));
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Benchmark failed: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    print_usage();
+    return 1;
+}
@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <entt/entt.hpp>
 #include "glmcommon.hpp"
 #include "imgui.h"
@@ -26,6 +27,7 @@ void Game::update(
     float deltaTime,
     InputManagerPtr input)
 {
+    updateMeshLoads();
     updateCamera(input);
     updatePlayer(deltaTime, input);
 
@@ -33,6 +35,8 @@ void Game::update(
     updateCameraTarget();
     updateNPCs();
     updateCharacterFSMs(deltaTime, time);
+    updateAnimations(time);
+    updateCrowd(time);
     updateWorldTransforms(time);
     updatePlayerRayIntersections();
     handlePicking(input, time);
@@ -47,6 +51,7 @@ void Game::render(
 
 	updateViewProjectionMatrices(windowWidth, windowHeight);
 
+    preSkinCharacters();
     beginRenderingPass();
 	renderEntities();
     renderMesh(time);
@@ -155,7 +160,8 @@ void Game::RenderSystem(eeng::ForwardRendererPtr& forwardRenderer, Tfm& tfm, Mes
         tfm.scale);
 
 
-	forwardRenderer->renderMesh(entityMesh.mesh, objWorldMatrix);
+	if (isMeshReady(entityMesh.mesh))
+		forwardRenderer->renderMesh(entityMesh.mesh, entityMesh.pose, objWorldMatrix);
 }
 void Game::NPCControllerSystem(NPCController& npcc, Tfm& tfm, Velocity& v)
 {
@@ -203,13 +209,13 @@ void Game::FSM(MeshComponent& mesh, const Velocity& v, float dt)
     switch (currentState)
     {
     case IDLE:
-		mesh.mesh->animate(1, dt * characterAnimSpeed);
+		mesh.mesh->animate(mesh.pose, 1, dt * characterAnimSpeed);
 		break;
 	case WALKING:
-        mesh.mesh->animate(2, dt * characterAnimSpeed);
+        mesh.mesh->animate(mesh.pose, 2, dt * characterAnimSpeed);
         break;
     case RUNNING:
-        mesh.mesh->animate(3, dt * characterAnimSpeed);
+        mesh.mesh->animate(mesh.pose, 3, dt * characterAnimSpeed);
         break;
     default:
         
@@ -230,23 +236,60 @@ void Game::FSMWithBlend(MeshComponent& mesh, Velocity& v, AnimState& anim, float
     else
         newState = RUNNING;
 
-    if (newState != anim.currentState)
+    anim.currentState = newState;
+
+    // Blend space over the speeds of the idle, walk and run clips, built on first use
+    const float walkSpeed = 6.0f, runSpeed = 14.0f;
+    if (!anim.locomotion.nbrNodes())
     {
-        anim.previousState = anim.currentState;
-        anim.currentState = newState;
-        anim.blendTimer = 0.0f;
+        const int idle = anim.locomotion.addClip(1);
+        const int walk = anim.locomotion.addClip(2);
+        const int run = anim.locomotion.addClip(3);
+        anim.locomotionSpace = anim.locomotion.addBlendSpace1D({ idle, walk, run }, { 0.0f, walkSpeed, runSpeed });
     }
 
-    anim.blendTimer += deltaTime;
-    float blendFactor = glm::clamp(anim.blendTimer / 0.5f, 0.0f, 1.0f);
-    if (useDebugBlend) blendFactor = debugBlendFactor;
+    // Ease towards the current speed over about half a second
+    anim.blendSpeed = glm::mix(anim.blendSpeed, speed, glm::clamp(deltaTime / 0.5f, 0.0f, 1.0f));
+    const float blendParameter = useDebugBlend ? debugBlendFactor * runSpeed : anim.blendSpeed;
+
+    anim.locomotion.setParameter(anim.locomotionSpace, blendParameter);
+    anim.locomotion.evaluate(*mesh.mesh, mesh.pose, blendPosePool, time);
+}
+void Game::MotionMatching(MeshComponent& mesh, const Velocity& v, const Tfm& tfm, AnimState& anim, float deltaTime)
+{
+    anim.matchTime += deltaTime * characterAnimSpeed;
+    anim.fadeTime += deltaTime * characterAnimSpeed;
+    anim.fadeFactor = glm::min(1.0f, anim.fadeFactor + deltaTime / motionFadeDuration);
+
+    anim.searchTimer -= deltaTime;
+    if (anim.searchTimer <= 0.0f || anim.matchClip == EENG_NULL_INDEX)
+    {
+        anim.searchTimer = motionSearchInterval;
+
+        // Desired velocity in model space. The character faces model +Z.
+        const glm::vec3 velocity = glm::vec3(glm::inverse(glm_aux::R(tfm.rotation.y, glm_aux::vec3_010)) * glm::vec4(v.velocity, 0.0f)) / tfm.scale.x;
+        const size_t frame = motionDatabase.findFrame(anim.matchClip, anim.matchTime);
+        const auto query = motionDatabase.makeQuery(frame, velocity, { 0.0f, 0.0f, 1.0f });
+        const auto match = motionDatabase.search(query, motionSearchBudgetMs, frame);
+        anim.matchCost = match.cost;
+
+        // Fade to the match unless it is close to what is playing
+        const bool same = (match.clip == anim.matchClip &&
+            std::abs(match.time - std::fmod(anim.matchTime, mesh.mesh->getAnimationDuration(match.clip))) < 0.2f);
+        if (!same)
+        {
+            anim.fadeClip = anim.matchClip;
+            anim.fadeTime = anim.matchTime;
+            anim.fadeFactor = (anim.fadeClip == EENG_NULL_INDEX ? 1.0f : 0.0f);
+            anim.matchClip = match.clip;
+            anim.matchTime = match.time;
+        }
+    }
 
-    mesh.mesh->animateBlend(
-        anim.previousState + 1,
-        anim.currentState + 1,
-        time,
-        time,
-        blendFactor);
+    if (anim.fadeFactor < 1.0f)
+        mesh.mesh->animateBlend(mesh.pose, anim.fadeClip, anim.matchClip, anim.fadeTime, anim.matchTime, anim.fadeFactor);
+    else
+        mesh.mesh->animate(mesh.pose, anim.matchClip, anim.matchTime);
 }
 
 //Entities
@@ -265,7 +308,7 @@ void Game::initNPCEntity()
        { 0, 0, 0 },
        { 0.01f, 0.01f, 0.01f } });
     entity_registry->emplace<Velocity>(entNPC, Velocity{ glm::vec3(0.0f) });
-    entity_registry->emplace<MeshComponent>(entNPC, MeshComponent{ foxMesh });
+    entity_registry->emplace<MeshComponent>(entNPC, MeshComponent{ foxMesh }); // Pose is created when the fox is loaded
 
     NPCController npc = {};
     npc.waypoints = {
@@ -284,7 +327,7 @@ void Game::initFoxEntity()
         { 5.0f, 0.0f, 5.0f },
         { 0, 0, 0 },
         { 0.01f, 0.01f, 0.01f } });
-    entity_registry->emplace<MeshComponent>(entFox, MeshComponent{ foxMesh });
+    entity_registry->emplace<MeshComponent>(entFox, MeshComponent{ foxMesh }); // Pose is created when the fox is loaded
     entity_registry->emplace<Velocity>(entFox, Velocity{ {1,1,1} });
 }
 void Game::initPlayerEntity() 
@@ -295,25 +338,32 @@ void Game::initPlayerEntity()
        { 0, 0, 0 },
        { 0.01f, 0.01f, 0.01f } });
     entity_registry->emplace<Velocity>(entPlayer, Velocity{ glm::vec3(0.0f) });
-    entity_registry->emplace<MeshComponent>(entPlayer, MeshComponent{ characterMesh });
+    entity_registry->emplace<MeshComponent>(entPlayer, MeshComponent{ characterMesh, characterMesh->createPose() });
     entity_registry->emplace<PlayerController>(entPlayer);
     entity_registry->emplace<AnimState>(entPlayer);
 }
 void Game::initMeshes()
 {
+    // Meshes load in parallel on loader threads, and are drawn once uploaded (see updateMeshLoads)
+    meshLoader.setResourceCache(&resourceCache);
     grassMesh = std::make_shared<eeng::RenderableMesh>();
-    grassMesh->load("assets/grass/grass_trees_merged2.fbx", false);
+    grassLoad = meshLoader.load(grassMesh, "assets/grass/grass_trees_merged2.fbx");
 
     horseMesh = std::make_shared<eeng::RenderableMesh>();
-    horseMesh->load("assets/Animals/Horse.fbx", false);
+    horseMesh->setClipLibrary(&clipLibrary);
+    horseLoad = meshLoader.load(horseMesh, "assets/Animals/Horse.fbx");
 
     characterMesh = std::make_shared<eeng::RenderableMesh>();
+    characterMesh->setClipLibrary(&clipLibrary);
 
     foxMesh = std::make_shared<eeng::RenderableMesh>();
-    foxMesh->load("assets/Animals/Fox.fbx", false);
+    foxLoad = meshLoader.load(foxMesh, "assets/Animals/Fox.fbx");
 
     marcoMesh = std::make_shared<eeng::RenderableMesh>();
-    marcoMesh->load("assets/Animals/Horse.fbx", false);
+    marcoMesh->setClipLibrary(&clipLibrary);
+    marcoLoad = meshLoader.load(marcoMesh, "assets/Animals/Horse.fbx");
+    // Same file as the horse, so the cache gives it the horse mesh
+    marcoMesh = marcoLoad->mesh;
 
     // Things that were tehre from the start, animations, annie etc
 #if 0
@@ -334,12 +384,15 @@ void Game::initMeshes()
 #endif
 #if 1
     // Amy 5.0.1 PACK FBX
-    characterMesh->load("assets/Amy/Ch46_nonPBR.fbx");
-    characterMesh->load("assets/Amy/idle.fbx", true);
-    characterMesh->load("assets/Amy/walking.fbx", true);
-    characterMesh->load("assets/Amy/running.fbx", true);
-    // Remove root motion
-    characterMesh->removeTranslationKeys("mixamorig:Hips");
+    characterLoad = meshLoader.load(characterMesh, "assets/Amy/Ch46_nonPBR.fbx",
+        { "assets/Amy/idle.fbx", "assets/Amy/walking.fbx", "assets/Amy/running.fbx" },
+        [this](eeng::RenderableMesh& mesh)
+        {
+            // Motion matching needs the root motion of idle, walk and run
+            motionDatabase.build(mesh, { 1, 2, 3 });
+            // Remove root motion
+            mesh.removeTranslationKeys("mixamorig:Hips");
+        });
 #endif
 #if 0
     // Eve 5.0.1 PACK FBX
@@ -352,6 +405,88 @@ void Game::initMeshes()
     // Remove root motion
     characterMesh->removeTranslationKeys("mixamorig:Hips");
 #endif
+    // Loads of a cached file share a handle, so report each once
+    for (const auto& load : { grassLoad, horseLoad, foxLoad, marcoLoad, characterLoad })
+        if (std::find(meshLoads.begin(), meshLoads.end(), load) == meshLoads.end())
+            meshLoads.push_back(load);
+
+    // The character is set up for the crowd and pre-skinning right away, so wait for it
+    meshLoader.wait(characterLoad);
+    if (characterLoad->failed())
+        throw std::runtime_error("Failed to load character: " + characterLoad->error);
+    eeng::Log("Motion database: %zu frames, %zu bytes", motionDatabase.nbrFrames(), motionDatabase.byteSize());
+
+    // Per-instance poses
+    characterPose1 = characterMesh->createPose();
+    characterPose2 = characterMesh->createPose();
+    characterPose3 = characterMesh->createPose();
+
+    // Only model AABB's are drawn, so skip per-bone and per-mesh AABB's
+    for (auto* pose : { &characterPose1, &characterPose2, &characterPose3 })
+        pose->part_aabbs = false;
+
+    // Baked palettes for the crowd
+    characterBaked = eeng::bake_animations(*characterMesh);
+    characterBakedId = forwardRenderer->uploadBakedAnimation(characterBaked);
+    eeng::Log("Baked %zu frames of character animation, %zu bytes",
+        characterBaked.nbrFrames(), characterBaked.byteSize());
+
+    for (auto& id : characterSkinnedIds)
+        id = forwardRenderer->createSkinnedInstance(characterMesh);
+}
+void Game::updateMeshLoads()
+{
+    meshLoader.update();
+
+    for (auto it = meshLoads.begin(); it != meshLoads.end(); )
+    {
+        const auto& load = **it;
+        if (!load.done())
+        {
+            ++it;
+            continue;
+        }
+
+        // Load times, cold (imported) or warm (cooked file)
+        if (load.failed())
+            eeng::Log("Failed to load %s: %s", load.file.c_str(), load.error.c_str());
+        else
+        {
+            eeng::Log("Loaded %s in %.1f ms (%s), ready after %.1f ms",
+                load.file.c_str(), load.load_ms, load.cooked ? "cooked" : "imported", load.ready_ms);
+            onMeshLoaded(load.mesh);
+        }
+        it = meshLoads.erase(it);
+    }
+}
+void Game::onMeshLoaded(const std::shared_ptr<eeng::RenderableMesh>& mesh)
+{
+    // Poses need the skeleton of their mesh
+    auto view = entity_registry->view<MeshComponent>();
+    for (auto entity : view)
+    {
+        auto& component = view.get<MeshComponent>(entity);
+        if (component.mesh == mesh)
+            component.pose = mesh->createPose();
+    }
+
+    if (mesh == horseMesh)
+    {
+        horsePose = horseMesh->createPose();
+        horsePose.part_aabbs = false;
+    }
+    if (!meshLoader.nbrLoading())
+    {
+        eeng::Log("Clip library: %zu clips, %zu bytes", clipLibrary.nbrClips(), clipLibrary.byteSize());
+        eeng::Log("Resource cache: %zu meshes, %zu textures", resourceCache.nbrMeshes(), resourceCache.nbrTextures());
+    }
+}
+bool Game::isMeshReady(const std::shared_ptr<eeng::RenderableMesh>& mesh) const
+{
+    for (const auto& load : { grassLoad, horseLoad, foxLoad, marcoLoad, characterLoad })
+        if (load && load->mesh == mesh)
+            return load->ready();
+    return false;
 }
 void Game::initWorldTransforms() 
 {
@@ -369,6 +504,7 @@ void Game::initRenderers()
 {
     forwardRenderer = std::make_shared<eeng::ForwardRenderer>();
     forwardRenderer->init("shaders/phong_vert.glsl", "shaders/phong_frag.glsl");
+    forwardRenderer->initPreSkinning("shaders/preskin_vert.glsl");
 
     shapeRenderer = std::make_shared<ShapeRendering::ShapeRenderer>();
     shapeRenderer->init();
@@ -413,12 +549,78 @@ void Game::updateCharacterFSMs(float deltaTime, float time)
         auto& mesh = characters.get<MeshComponent>(entity);
         auto& anim = characters.get<AnimState>(entity);
 
-        if (useBlendingFSM)
+        const auto* tfm = entity_registry->try_get<Tfm>(entity);
+        if (useMotionMatching && motionDatabase.nbrFrames() && tfm)
+            MotionMatching(mesh, vel, *tfm, anim, deltaTime);
+        else if (useBlendingFSM)
             FSMWithBlend(mesh, vel, anim, deltaTime, time);
         else
             FSM(mesh, vel, time);
     }
 }
+void Game::updateAnimations(float time)
+{
+    // Select animation detail from projected sizes of the previous frame
+    const float fovy = glm::radians(60.0f);
+    horseLod.screen_size = eeng::projected_screen_size(horse_aabb, camera.pos, fovy);
+    characterLod1.screen_size = eeng::projected_screen_size(character_aabb1, camera.pos, fovy);
+    characterLod2.screen_size = eeng::projected_screen_size(character_aabb2, camera.pos, fovy);
+    characterLod3.screen_size = eeng::projected_screen_size(character_aabb3, camera.pos, fovy);
+
+    // Evaluate all instance poses ahead of rendering
+    eeng::AnimationJob jobs[] = {
+        { horseMesh.get(), &horsePose, 3, -1, time },
+        { characterMesh.get(), &characterPose1, characterAnimIndex, -1, time * characterAnimSpeed },
+        { characterMesh.get(), &characterPose2, 1, -1, time * characterAnimSpeed },
+        { characterMesh.get(), &characterPose3, 2, -1, time * characterAnimSpeed } };
+    eeng::AnimationLod* lods[] = { &horseLod, &characterLod1, &characterLod2, &characterLod3 };
+    for (size_t i = 0; i < std::size(jobs); i++)
+    {
+        jobs[i].lod = lods[i];
+        jobs[i].lod_policy = &animationLodPolicy;
+    }
+    const size_t firstJob = (isMeshReady(horseMesh) ? 0 : 1);
+    eeng::animate_batch(animationThreadPool, std::span(jobs).subspan(firstJob), 1);
+}
+void Game::updateCrowd(float time)
+{
+    crowdPoseCache.beginFrame();
+    crowdInstancePoses.clear();
+    bakedCrowdInstances.clear();
+    if (!showCrowd || !characterMesh) return;
+
+    // Baked crowd: only a transform and a frame per instance
+    if (useBakedCrowd)
+    {
+        const int columns = (int)std::ceil(std::sqrt((float)bakedCrowdSize));
+        for (int i = 0; i < bakedCrowdSize; i++)
+        {
+            const glm::vec3 pos = { -2.0f * columns + 4.0f * (i % columns), 0.0f, -12.0f - 4.0f * (i / columns) };
+            const float crowdTime = (time + (i % 7) * 0.13f) * characterAnimSpeed;
+            bakedCrowdInstances.push_back({
+                glm_aux::TRS(pos, 0.0f, { 0, 1, 0 }, { 0.03f, 0.03f, 0.03f }),
+                characterBaked.frameAt(2, crowdTime) });
+        }
+        return;
+    }
+
+    // Instances walk in four groups, each group in step, so at most
+    // four poses are evaluated per frame when the cache is on
+    crowdPoseCache.setTimeQuantum(crowdTimeQuantumMs / 1000.0f);
+    if (crowdPoses.size() != crowdSize)
+        crowdPoses.assign(crowdSize, characterMesh->createPose());
+    for (int i = 0; i < crowdSize; i++)
+    {
+        const float crowdTime = (time + (i % 4) * 0.25f) * characterAnimSpeed;
+        if (useCrowdPoseCache)
+            crowdInstancePoses.push_back(&crowdPoseCache.animate(*characterMesh, 2, crowdTime));
+        else
+        {
+            characterMesh->animate(crowdPoses[i], 2, crowdTime);
+            crowdInstancePoses.push_back(&crowdPoses[i]);
+        }
+    }
+}
 void Game::updateWorldTransforms(float time) 
 {
     pointlight.pos = glm::vec3(
@@ -475,6 +677,22 @@ void Game::renderAnimationUI()
     ImGui::Checkbox("Use manual blend factor", &useDebugBlend);
     ImGui::SliderFloat("Manual Blend Factor", &debugBlendFactor, 0.0f, 1.0f);
     ImGui::Checkbox("Use Blending FSM", &useBlendingFSM);
+    ImGui::Checkbox("Use Motion Matching", &useMotionMatching);
+    ImGui::SliderFloat("Motion search budget (ms)", &motionSearchBudgetMs, 0.01f, 2.0f);
+    ImGui::SliderFloat("Motion search interval (s)", &motionSearchInterval, 0.02f, 0.5f);
+
+    ImGui::Checkbox("Show crowd", &showCrowd);
+    ImGui::SameLine();
+    ImGui::Checkbox("Share crowd poses", &useCrowdPoseCache);
+    ImGui::SliderFloat("Crowd time quantum (ms)", &crowdTimeQuantumMs, 1.0f, 100.0f);
+    ImGui::Checkbox("Baked crowd", &useBakedCrowd);
+    ImGui::SameLine();
+    ImGui::SliderInt("Baked crowd size", &bakedCrowdSize, 1, 4096);
+    ImGui::Checkbox("Pre-skin characters", &usePreSkinning);
+    ImGui::Text("Crowd poses evaluated %zu, cache hits %llu, misses %llu",
+        useCrowdPoseCache ? crowdPoseCache.nbrPoses() : crowdInstancePoses.size(),
+        (unsigned long long)crowdPoseCache.frameCounters().hits,
+        (unsigned long long)crowdPoseCache.frameCounters().misses);
 
     // Show current animation state
     auto characters = entity_registry->view<AnimState>();
@@ -483,6 +701,10 @@ void Game::renderAnimationUI()
         auto& anim = characters.get<AnimState>(entity);
 
         ImGui::Text("Current FSM State: %s", stateNames[anim.currentState]);
+        ImGui::Text("Blend speed %.2f, clips sampled %zu", anim.blendSpeed, anim.locomotion.nbrSampledClips());
+        if (useMotionMatching)
+            ImGui::Text("Motion match: clip %d at %.2f s, cost %.2f, %zu frames",
+                anim.matchClip, anim.matchTime, anim.matchCost, motionDatabase.nbrFrames());
         break;
     }
 
@@ -610,29 +832,51 @@ void Game::renderEntities() {
 void Game::renderMesh(float time) 
 {
     // Grass
-    forwardRenderer->renderMesh(grassMesh, grassWorldMatrix);
-    grass_aabb = grassMesh->m_model_aabb.post_transform(grassWorldMatrix);
+    if (isMeshReady(grassMesh))
+    {
+        forwardRenderer->renderMesh(grassMesh, grassWorldMatrix);
+        grass_aabb = grassMesh->m_pose.model_aabb.post_transform(grassWorldMatrix);
+    }
 
     // Horse
-    horseMesh->animate(3, time);
-    forwardRenderer->renderMesh(horseMesh, horseWorldMatrix);
-    horse_aabb = horseMesh->m_model_aabb.post_transform(horseWorldMatrix);
-
-    // Character, instance 1
-    characterMesh->animate(characterAnimIndex, time * characterAnimSpeed);
-    forwardRenderer->renderMesh(characterMesh, characterWorldMatrix1);
-    character_aabb1 = characterMesh->m_model_aabb.post_transform(characterWorldMatrix1);
+    if (isMeshReady(horseMesh))
+    {
+        forwardRenderer->renderMesh(horseMesh, horsePose, horseWorldMatrix);
+        horse_aabb = horsePose.model_aabb.post_transform(horseWorldMatrix);
+    }
 
-    // Character, instance 2
-    characterMesh->animate(1, time * characterAnimSpeed);
-    forwardRenderer->renderMesh(characterMesh, characterWorldMatrix2);
-    character_aabb2 = characterMesh->m_model_aabb.post_transform(characterWorldMatrix2);
+    // Character instances, from pre-skinned vertices if enabled
+    const eeng::AnimationPose* characterPoses[] = { &characterPose1, &characterPose2, &characterPose3 };
+    const glm::mat4* characterWorldMatrices[] = { &characterWorldMatrix1, &characterWorldMatrix2, &characterWorldMatrix3 };
+    for (int i = 0; i < 3; i++)
+    {
+        if (usePreSkinning)
+            forwardRenderer->renderSkinnedInstance(characterSkinnedIds[i], *characterWorldMatrices[i]);
+        else
+            forwardRenderer->renderMesh(characterMesh, *characterPoses[i], *characterWorldMatrices[i]);
+    }
+    character_aabb1 = characterPose1.model_aabb.post_transform(characterWorldMatrix1);
+    character_aabb2 = characterPose2.model_aabb.post_transform(characterWorldMatrix2);
+    character_aabb3 = characterPose3.model_aabb.post_transform(characterWorldMatrix3);
 
-    // Character, instance 3
-    characterMesh->animate(2, time * characterAnimSpeed);
-    forwardRenderer->renderMesh(characterMesh, characterWorldMatrix3);
-    character_aabb3 = characterMesh->m_model_aabb.post_transform(characterWorldMatrix3);
+    // Crowd, in a grid behind the scene
+    for (int i = 0; i < crowdInstancePoses.size(); i++)
+    {
+        const glm::vec3 pos = { -6.0f + 4.0f * (i % 4), 0.0f, -12.0f - 4.0f * (i / 4) };
+        const glm::mat4 crowdWorldMatrix = glm_aux::TRS(pos, 0.0f, { 0, 1, 0 }, { 0.03f, 0.03f, 0.03f });
+        forwardRenderer->renderMesh(characterMesh, *crowdInstancePoses[i], crowdWorldMatrix);
+    }
+    forwardRenderer->renderMeshBaked(characterMesh, characterBakedId, bakedCrowdInstances);
+}
+void Game::preSkinCharacters()
+{
+    if (!usePreSkinning)
+        return;
 
+    // Once per frame, however many passes draw the characters
+    forwardRenderer->preSkin(characterSkinnedIds[0], characterPose1);
+    forwardRenderer->preSkin(characterSkinnedIds[1], characterPose2);
+    forwardRenderer->preSkin(characterSkinnedIds[2], characterPose3);
 }
 void Game::beginRenderingPass() {
     forwardRenderer->beginPass(
@@ -650,11 +894,10 @@ void Game::renderDebugBoneGizmos() {
     if (!showBoneGizmos || !characterMesh) return;
 
     float axisLen = 25.0f;
-    for (int i = 0; i < characterMesh->boneMatrices.size(); ++i) {
+    for (int i = 0; i < characterPose3.bone_matrices.size(); ++i) {
         glm::mat4 global =
             characterWorldMatrix3 *
-            characterMesh->boneMatrices[i] *
-            glm::inverse(characterMesh->m_bones[i].inversebind_tfm);
+            characterPose3.global_tfms[characterMesh->m_bones[i].node_index].toMat4();
 
         glm::vec3 pos = glm::vec3(global[3]);
         glm::vec3 right = glm::vec3(global[0]); // X
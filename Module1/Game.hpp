@@ -5,6 +5,13 @@
 #include <entt/fwd.hpp>
 #include "GameBase.h"
 #include "RenderableMesh.hpp"
+#include "AnimationBatch.hpp"
+#include "AnimationBlendTree.hpp"
+#include "PoseCache.hpp"
+#include "ClipLibrary.hpp"
+#include "MotionDatabase.hpp"
+#include "MeshLoader.hpp"
+#include "ResourceCache.hpp"
 #include "ForwardRenderer.hpp"
 #include "ShapeRenderer.hpp"
 
@@ -96,8 +103,46 @@ private:
         glm_aux::Ray viewRay;
     } player;
 
+    // Shares meshes and textures loaded more than once. Declared before the meshes, which refer to it.
+    eeng::ResourceCache resourceCache;
+
     // Game meshes
     std::shared_ptr<eeng::RenderableMesh> grassMesh, horseMesh, characterMesh, foxMesh, marcoMesh;
+    // Clips shared by meshes with the same skeleton, such as horseMesh and marcoMesh
+    eeng::ClipLibrary clipLibrary;
+
+    // Game mesh instance poses
+    eeng::AnimationPose horsePose, characterPose1, characterPose2, characterPose3;
+
+    // Workers for evaluating poses
+    eeng::ThreadPool animationThreadPool;
+
+    // Intermediate poses for blend trees evaluated on the main thread
+    eeng::LocalPosePool blendPosePool;
+
+    // Crowd of characters that share poses through a cache
+    eeng::PoseCache crowdPoseCache;
+    std::vector<eeng::AnimationPose> crowdPoses;                // Own poses, used when the cache is off
+    std::vector<const eeng::AnimationPose*> crowdInstancePoses; // Pose per instance this frame
+    bool showCrowd = true;
+    bool useCrowdPoseCache = true;
+    float crowdTimeQuantumMs = 1000.0f / 30.0f;
+    const int crowdSize = 16;
+
+    // Crowd drawn instanced from baked palettes, without evaluating poses
+    eeng::BakedAnimation characterBaked;
+    int characterBakedId = -1;
+    std::vector<eeng::BakedInstance> bakedCrowdInstances;
+    bool useBakedCrowd = false;
+    int bakedCrowdSize = 256;
+
+    // Character instances skinned once per frame and drawn as static geometry
+    int characterSkinnedIds[3] = { -1, -1, -1 };
+    bool usePreSkinning = false;
+
+    // Animation level-of-detail per instance, from projected size
+    eeng::AnimationLodPolicy animationLodPolicy;
+    eeng::AnimationLod horseLod, characterLod1, characterLod2, characterLod3;
 
     // Game entity transformations
     glm::mat4 characterWorldMatrix1, characterWorldMatrix2, characterWorldMatrix3;
@@ -138,6 +183,7 @@ private:
     struct MeshComponent 
     {
         std::shared_ptr<eeng::RenderableMesh> mesh;
+        eeng::AnimationPose pose;
     };
     struct NPCController 
     {
@@ -155,13 +201,35 @@ private:
 
     struct AnimState {
         int currentState = 0;
-        int previousState = 0;
-        float blendTimer = 0.0f;
+        float blendSpeed = 0.0f;                    // Speed eased towards the current speed
+        eeng::BlendTree locomotion;                 // Idle, walk and run by speed
+        int locomotionSpace = EENG_NULL_INDEX;
+
+        // Motion matching: clip and time playing, and the one faded out from
+        int matchClip = EENG_NULL_INDEX;
+        float matchTime = 0.0f;
+        int fadeClip = EENG_NULL_INDEX;
+        float fadeTime = 0.0f;
+        float fadeFactor = 1.0f;                    // 1 when the fade is done
+        float searchTimer = 0.0f;                   // Seconds to next search
+        float matchCost = 0.0f;
     };
 
     bool useBlendingFSM = true;
+
+    // Motion matching over the locomotion clips, instead of the FSM's
+    eeng::MotionDatabase motionDatabase;
+    bool useMotionMatching = false;
+    float motionSearchInterval = 0.1f;              // Seconds between searches
+    float motionSearchBudgetMs = 0.5f;              // Time per search
+    float motionFadeDuration = 0.2f;                // Seconds to fade to a new match
     float debugBlendFactor = 1.0f;
     bool useDebugBlend = false;
+
+    // Loads meshes in the background. Declared after what load callbacks use, so it stops first.
+    eeng::MeshLoader meshLoader;
+    eeng::MeshLoadHandle grassLoad, horseLoad, foxLoad, marcoLoad, characterLoad;
+    std::vector<eeng::MeshLoadHandle> meshLoads;    // Loads not yet reported
     bool showBoneGizmos = false;
 
 
@@ -171,6 +239,7 @@ private:
     void RenderSystem(eeng::ForwardRendererPtr& forwardRenderer, Tfm& tfm, MeshComponent& entityMesh);
     void FSM(MeshComponent& mesh, const Velocity& vel, float dt);
 	void FSMWithBlend(MeshComponent& mesh, Velocity& v, AnimState& anim, float deltaTime, float time);
+    void MotionMatching(MeshComponent& mesh, const Velocity& v, const Tfm& tfm, AnimState& anim, float deltaTime);
 
     //Refactoring things
 
@@ -181,6 +250,9 @@ private:
     void initFoxEntity();
 
     void initMeshes();
+    void updateMeshLoads();
+    void onMeshLoaded(const std::shared_ptr<eeng::RenderableMesh>& mesh);
+    bool isMeshReady(const std::shared_ptr<eeng::RenderableMesh>& mesh) const;
 
     void initWorldTransforms();
 	void initRenderers();
@@ -190,6 +262,8 @@ private:
     void updateCameraTarget();
     void updateNPCs();
     void updateCharacterFSMs(float deltaTime, float time);
+    void updateAnimations(float time);
+    void updateCrowd(float time);
     void updateWorldTransforms(float time);
     void updatePlayerRayIntersections();
     void handlePicking(InputManagerPtr input, float time);
@@ -202,6 +276,7 @@ private:
 
     void renderEntities();
 	void renderMesh(float time);
+	void preSkinCharacters();
 	void beginRenderingPass();
 	void endRenderingPass();
 	void renderDebugBoneGizmos();
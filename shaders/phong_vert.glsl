@@ -1,19 +1,33 @@
 #version 410 core
-const int MaxBones = 128;
+const int MaxBones = 170; // 3 vec4 per bone (was 4 with mat4)
 
+/* Bone influences per vertex (1, 2 or 4), defined per variant by the renderer.
+   Weights are sorted by size and normalized at load. */
+#ifndef SKIN_INFLUENCES
+#define SKIN_INFLUENCES 4
+#endif
+
+/* Vertices are packed (see RenderableMesh::PackedVertex) and decoded by the
+   attribute formats: half float texcoords, 10:10:10:2 normals and tangents,
+   8-bit bone indices and weights. The sign of tangent w orients the binormal. */
 layout (location = 0) in vec3 attr_Position;
 layout (location = 1) in vec2 attr_Texcoord;
 layout (location = 2) in vec3 attr_Normal;
-layout (location = 3) in vec3 attr_Tangent;
-layout (location = 4) in vec3 attr_Binormal;
+layout (location = 3) in vec4 attr_Tangent;
 layout (location = 5) in ivec4 BoneIDs;
 layout (location = 6) in vec4 BoneWeights;
 
 uniform mat4 ProjViewMatrix;
 uniform mat4 WorldMatrix;
-uniform mat4 BoneMatrices[MaxBones];
+uniform mat3x4 BoneMatrices[MaxBones]; // Affine bone transforms as rows, transform with vec4 * mat3x4
 uniform int u_is_skinned;
 
+// Baked palettes, drawn instanced
+uniform samplerBuffer BakedPalettes;    // Palettes of all baked frames, 3 texels (rows) per bone
+uniform samplerBuffer InstanceData;     // 4 texels per instance: 3 world matrix rows, then (frame, 0, 0, 0)
+uniform int NbrBakedBones;
+uniform int u_is_baked;
+
 out vec3 wpos;
 out vec2 texcoord;
 out vec3 normal;
@@ -21,27 +35,63 @@ out vec3 tangent;
 out vec3 binormal;
 out vec3 color;
 
+int bakedFrame = 0;
+
+mat3x4 boneRows(int bone)
+{
+   if (u_is_baked == 0)
+       return BoneMatrices[bone];
+
+   int ofs = 3 * (bakedFrame * NbrBakedBones + bone);
+   return mat3x4(texelFetch(BakedPalettes, ofs),
+                 texelFetch(BakedPalettes, ofs + 1),
+                 texelFetch(BakedPalettes, ofs + 2));
+}
+
 void main()
 {
+   /* Instance transform and frame of baked instances */
+   mat4 InstanceMatrix = mat4(1.0);
+   if (u_is_baked > 0)
+   {
+       int ofs = 4 * gl_InstanceID;
+       InstanceMatrix = transpose(mat4(texelFetch(InstanceData, ofs),
+                                       texelFetch(InstanceData, ofs + 1),
+                                       texelFetch(InstanceData, ofs + 2),
+                                       vec4(0, 0, 0, 1)));
+       bakedFrame = int(texelFetch(InstanceData, ofs + 3).x);
+   }
+   mat4 World = InstanceMatrix * WorldMatrix;
+
    mat4 BoneMatrix = mat4(1.0);
    if (u_is_skinned > 0)
    {
-       BoneMatrix *=    BoneMatrices[BoneIDs.x] * BoneWeights.x + 
-                        BoneMatrices[BoneIDs.y] * BoneWeights.y + 
-                        BoneMatrices[BoneIDs.z] * BoneWeights.z + 
-                        BoneMatrices[BoneIDs.w] * BoneWeights.w;
+#if SKIN_INFLUENCES == 1
+       mat3x4 BoneRows =    boneRows(BoneIDs.x);
+#elif SKIN_INFLUENCES == 2
+       mat3x4 BoneRows =    boneRows(BoneIDs.x) * BoneWeights.x + 
+                            boneRows(BoneIDs.y) * BoneWeights.y;
+#else
+       mat3x4 BoneRows =    boneRows(BoneIDs.x) * BoneWeights.x + 
+                            boneRows(BoneIDs.y) * BoneWeights.y + 
+                            boneRows(BoneIDs.z) * BoneWeights.z + 
+                            boneRows(BoneIDs.w) * BoneWeights.w;
        /* Fallback when bone weights are zero */
        if (BoneWeights.x+BoneWeights.y+BoneWeights.z+BoneWeights.w < 0.01)
        {
-           BoneMatrix = BoneMatrices[0];
+           BoneRows = boneRows(0);
        }
+#endif
+       /* Expand rows to a 4x4 affine matrix, with (0, 0, 0, 1) as last row */
+       BoneMatrix = transpose(mat4(BoneRows));
    }
 
-   wpos = (WorldMatrix * BoneMatrix * vec4(attr_Position, 1)).xyz;
+   wpos = (World * BoneMatrix * vec4(attr_Position, 1)).xyz;
    texcoord = attr_Texcoord;
-   normal = normalize( (WorldMatrix * BoneMatrix * vec4(attr_Normal, 0)).xyz );
-   tangent = normalize( (WorldMatrix * BoneMatrix * vec4(attr_Tangent, 0)).xyz );
-   binormal = normalize( (WorldMatrix * BoneMatrix * vec4(attr_Binormal, 0)).xyz );
+   normal = normalize( (World * BoneMatrix * vec4(attr_Normal, 0)).xyz );
+   tangent = normalize( (World * BoneMatrix * vec4(attr_Tangent.xyz, 0)).xyz );
+   /* A 2-bit w of -1 may decode as -1/3, so only its sign is used */
+   binormal = normalize(cross(normal, tangent)) * (attr_Tangent.w < 0.0 ? -1.0 : 1.0);
 
-   gl_Position = ProjViewMatrix * WorldMatrix * BoneMatrix * vec4(attr_Position, 1);
+   gl_Position = ProjViewMatrix * World * BoneMatrix * vec4(attr_Position, 1);
 }
\ No newline at end of file
@@ -0,0 +1,42 @@
+#version 410 core
+const int MaxBones = 170; // 3 vec4 per bone, as in phong_vert.glsl
+
+/* Skins vertices to buffers with transform feedback, see ForwardRenderer::preSkin.
+   Output is relative the model, in floats, with the binormal sign kept in tangent w. */
+
+layout (location = 0) in vec3 attr_Position;
+layout (location = 2) in vec3 attr_Normal;
+layout (location = 3) in vec4 attr_Tangent;
+layout (location = 5) in ivec4 BoneIDs;
+layout (location = 6) in vec4 BoneWeights;
+
+uniform mat3x4 BoneMatrices[MaxBones]; // Affine bone transforms as rows
+uniform mat4 MeshMatrix;               // Node transform of non-skinned submeshes
+uniform int u_is_skinned;
+
+out vec3 skinned_Position;
+out vec3 skinned_Normal;
+out vec4 skinned_Tangent;
+
+void main()
+{
+   mat4 M = MeshMatrix;
+   if (u_is_skinned > 0)
+   {
+       mat3x4 BoneRows =    BoneMatrices[BoneIDs.x] * BoneWeights.x + 
+                            BoneMatrices[BoneIDs.y] * BoneWeights.y + 
+                            BoneMatrices[BoneIDs.z] * BoneWeights.z + 
+                            BoneMatrices[BoneIDs.w] * BoneWeights.w;
+       /* Fallback when bone weights are zero */
+       if (BoneWeights.x+BoneWeights.y+BoneWeights.z+BoneWeights.w < 0.01)
+       {
+           BoneRows = BoneMatrices[0];
+       }
+       M = transpose(mat4(BoneRows));
+   }
+
+   /* Directions are normalized when drawn */
+   skinned_Position = (M * vec4(attr_Position, 1)).xyz;
+   skinned_Normal = (M * vec4(attr_Normal, 0)).xyz;
+   skinned_Tangent = vec4((M * vec4(attr_Tangent.xyz, 0)).xyz, attr_Tangent.w < 0.0 ? -1.0 : 1.0);
+}
@@ -135,7 +135,7 @@ namespace eeng
             return aabb;
         }
 
-        operator bool()
+        operator bool() const
         {
             return max.x > min.x && max.y > min.y && max.z > min.z;
         }
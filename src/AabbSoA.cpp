@@ -0,0 +1,150 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include "AabbSoA.hpp"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EENG_AABB_SSE
+#include <emmintrin.h>
+#endif
+
+namespace eeng
+{
+    void AabbSoA::clear()
+    {
+        cx.clear(); cy.clear(); cz.clear();
+        ex.clear(); ey.clear(); ez.clear();
+        tfm_index.clear();
+        out_index.clear();
+        count = 0;
+    }
+
+    void AabbSoA::add(const AABB& aabb, uint32_t tfm, uint32_t out)
+    {
+        if (!aabb)
+            return;
+
+        // Drop padding of previous calls to pad()
+        cx.resize(count); cy.resize(count); cz.resize(count);
+        ex.resize(count); ey.resize(count); ez.resize(count);
+        tfm_index.resize(count);
+        out_index.resize(count);
+
+        const glm::vec3 center = 0.5f * (aabb.min + aabb.max);
+        const glm::vec3 extent = 0.5f * (aabb.max - aabb.min);
+        cx.push_back(center.x); cy.push_back(center.y); cz.push_back(center.z);
+        ex.push_back(extent.x); ey.push_back(extent.y); ez.push_back(extent.z);
+        tfm_index.push_back(tfm);
+        out_index.push_back(out);
+        count++;
+    }
+
+    void AabbSoA::pad()
+    {
+        if (!count)
+            return;
+
+        const size_t padded = (count + AabbBatchWidth - 1) / AabbBatchWidth * AabbBatchWidth;
+        cx.resize(padded, cx[count - 1]); cy.resize(padded, cy[count - 1]); cz.resize(padded, cz[count - 1]);
+        ex.resize(padded, ex[count - 1]); ey.resize(padded, ey[count - 1]); ez.resize(padded, ez[count - 1]);
+        tfm_index.resize(padded, tfm_index[count - 1]);
+        out_index.resize(padded, out_index[count - 1]);
+    }
+
+    void transform_aabbs(
+        const AabbSoA& boxes,
+        const Affine* tfms,
+        AABB* out,
+        AABB& merged)
+    {
+        if (!boxes.count)
+            return;
+        const size_t size = boxes.tfm_index.size();
+
+#ifdef EENG_AABB_SSE
+        const __m128 sign_mask = _mm_set1_ps(-0.0f);
+        __m128 vmin[3], vmax[3];
+        for (int r = 0; r < 3; r++)
+        {
+            vmin[r] = _mm_set1_ps(merged.min[r]);
+            vmax[r] = _mm_set1_ps(merged.max[r]);
+        }
+
+        for (size_t i = 0; i < size; i += AabbBatchWidth)
+        {
+            const uint32_t* t = &boxes.tfm_index[i];
+            const __m128 cx = _mm_loadu_ps(&boxes.cx[i]), cy = _mm_loadu_ps(&boxes.cy[i]), cz = _mm_loadu_ps(&boxes.cz[i]);
+            const __m128 ex = _mm_loadu_ps(&boxes.ex[i]), ey = _mm_loadu_ps(&boxes.ey[i]), ez = _mm_loadu_ps(&boxes.ez[i]);
+
+            __m128 lo[3], hi[3];
+            for (int r = 0; r < 3; r++)
+            {
+                // Row r of the four transforms, one column per register
+                __m128 m0 = _mm_loadu_ps(&tfms[t[0]].rows[r].x);
+                __m128 m1 = _mm_loadu_ps(&tfms[t[1]].rows[r].x);
+                __m128 m2 = _mm_loadu_ps(&tfms[t[2]].rows[r].x);
+                __m128 m3 = _mm_loadu_ps(&tfms[t[3]].rows[r].x);
+                _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+
+                const __m128 c = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(m0, cx), _mm_mul_ps(m1, cy)),
+                    _mm_add_ps(_mm_mul_ps(m2, cz), m3));
+                const __m128 e = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, m0), ex), _mm_mul_ps(_mm_andnot_ps(sign_mask, m1), ey)),
+                    _mm_mul_ps(_mm_andnot_ps(sign_mask, m2), ez));
+                lo[r] = _mm_sub_ps(c, e);
+                hi[r] = _mm_add_ps(c, e);
+                vmin[r] = _mm_min_ps(vmin[r], lo[r]);
+                vmax[r] = _mm_max_ps(vmax[r], hi[r]);
+            }
+
+            if (out)
+            {
+                alignas(16) float lo_f[3][4], hi_f[3][4];
+                for (int r = 0; r < 3; r++)
+                {
+                    _mm_store_ps(lo_f[r], lo[r]);
+                    _mm_store_ps(hi_f[r], hi[r]);
+                }
+                for (size_t k = 0; k < AabbBatchWidth; k++)
+                {
+                    AABB& aabb = out[boxes.out_index[i + k]];
+                    aabb.min = { lo_f[0][k], lo_f[1][k], lo_f[2][k] };
+                    aabb.max = { hi_f[0][k], hi_f[1][k], hi_f[2][k] };
+                }
+            }
+        }
+
+        // Reduce lanes
+        for (int r = 0; r < 3; r++)
+        {
+            alignas(16) float min_f[4], max_f[4];
+            _mm_store_ps(min_f, vmin[r]);
+            _mm_store_ps(max_f, vmax[r]);
+            merged.min[r] = std::fmin(std::fmin(min_f[0], min_f[1]), std::fmin(min_f[2], min_f[3]));
+            merged.max[r] = std::fmax(std::fmax(max_f[0], max_f[1]), std::fmax(max_f[2], max_f[3]));
+        }
+#else
+        for (size_t i = 0; i < size; i++)
+        {
+            const Affine& M = tfms[boxes.tfm_index[i]];
+            const glm::vec4 c(boxes.cx[i], boxes.cy[i], boxes.cz[i], 1.0f);
+            const glm::vec3 e(boxes.ex[i], boxes.ey[i], boxes.ez[i]);
+
+            AABB aabb;
+            for (int r = 0; r < 3; r++)
+            {
+                const float center = glm::dot(M.rows[r], c);
+                const float extent = glm::dot(glm::abs(glm::vec3(M.rows[r])), e);
+                aabb.min[r] = center - extent;
+                aabb.max[r] = center + extent;
+            }
+            merged.grow(aabb);
+            if (out)
+                out[boxes.out_index[i]] = aabb;
+        }
+#endif
+    }
+
+} // namespace eeng
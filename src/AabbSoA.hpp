@@ -0,0 +1,54 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef AabbSoA_hpp
+#define AabbSoA_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "AABB.h"
+#include "Affine.hpp"
+
+namespace eeng
+{
+    /// Number of boxes transformed at once by transform_aabbs()
+    constexpr size_t AabbBatchWidth = 4;
+
+    /// @brief AABBs as centers and half extents, one array per component
+    /// Each box has a transform to apply and a slot to write the result to.
+    /// Arrays are padded to a multiple of AabbBatchWidth by repeating the
+    /// last box, so that transform_aabbs() needs no remainder loop.
+    struct AabbSoA
+    {
+        std::vector<float> cx, cy, cz;      //!< Centers
+        std::vector<float> ex, ey, ez;      //!< Half extents
+        std::vector<uint32_t> tfm_index;    //!< Transform per box
+        std::vector<uint32_t> out_index;    //!< Output slot per box
+        size_t count = 0;                   //!< Boxes, not counting padding
+
+        void clear();
+
+        /// @brief Add a box. Empty boxes are ignored.
+        void add(const AABB& aabb, uint32_t tfm, uint32_t out);
+
+        /// @brief Pad the arrays, call when all boxes are added
+        void pad();
+    };
+
+    /// @brief Transform boxes and grow an AABB to include them
+    /// Each box is transformed as center' = M * center and extent' = |R| * extent,
+    /// where R is the linear part of M. This gives the same box as
+    /// AABB::post_transform(), without branches.
+    /// @param boxes Boxes to transform
+    /// @param tfms Transforms, indexed by AabbSoA::tfm_index
+    /// @param out Transformed boxes, indexed by AabbSoA::out_index, or nullptr to only grow merged
+    /// @param merged AABB to grow
+    void transform_aabbs(
+        const AabbSoA& boxes,
+        const Affine* tfms,
+        AABB* out,
+        AABB& merged);
+
+} // namespace eeng
+
+#endif /* AabbSoA_hpp */
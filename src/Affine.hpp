@@ -0,0 +1,83 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef Affine_hpp
+#define Affine_hpp
+
+#include <glm/glm.hpp>
+
+namespace eeng
+{
+    /// @brief Affine transform stored as the top three rows of a 4x4 matrix, [R | t]
+    /// The implicit fourth row is (0, 0, 0, 1), which saves a quarter of the
+    /// storage and of the multiplications of a glm::mat4 product.
+    /// Rows are laid out as a GLSL mat3x4 (uploaded without transpose),
+    /// where a point is transformed as vec4(p, 1) * M.
+    struct Affine
+    {
+        glm::vec4 rows[3];
+
+        Affine()
+            : rows{ { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f } }
+        {
+        }
+
+        explicit Affine(const glm::mat4& M)
+            : rows{
+                { M[0][0], M[1][0], M[2][0], M[3][0] },
+                { M[0][1], M[1][1], M[2][1], M[3][1] },
+                { M[0][2], M[1][2], M[2][2], M[3][2] } }
+        {
+        }
+
+        glm::mat4 toMat4() const
+        {
+            return glm::mat4(
+                glm::vec4(rows[0].x, rows[1].x, rows[2].x, 0.0f),
+                glm::vec4(rows[0].y, rows[1].y, rows[2].y, 0.0f),
+                glm::vec4(rows[0].z, rows[1].z, rows[2].z, 0.0f),
+                glm::vec4(rows[0].w, rows[1].w, rows[2].w, 1.0f));
+        }
+
+        /// @brief Translation part, t
+        glm::vec3 translation() const
+        {
+            return { rows[0].w, rows[1].w, rows[2].w };
+        }
+
+        /// @brief Linear (rotation and scale) part, R
+        glm::mat3 linear() const
+        {
+            return glm::mat3(
+                glm::vec3(rows[0].x, rows[1].x, rows[2].x),
+                glm::vec3(rows[0].y, rows[1].y, rows[2].y),
+                glm::vec3(rows[0].z, rows[1].z, rows[2].z));
+        }
+
+        glm::vec3 transformPoint(const glm::vec3& p) const
+        {
+            const glm::vec4 v(p, 1.0f);
+            return { glm::dot(rows[0], v), glm::dot(rows[1], v), glm::dot(rows[2], v) };
+        }
+
+        glm::vec3 transformVector(const glm::vec3& v) const
+        {
+            const glm::vec4 v0(v, 0.0f);
+            return { glm::dot(rows[0], v0), glm::dot(rows[1], v0), glm::dot(rows[2], v0) };
+        }
+    };
+
+    /// @brief Compose affine transforms, a * b
+    inline Affine operator*(const Affine& a, const Affine& b)
+    {
+        Affine c;
+        for (int i = 0; i < 3; i++)
+        {
+            c.rows[i] = a.rows[i].x * b.rows[0] + a.rows[i].y * b.rows[1] + a.rows[i].z * b.rows[2];
+            c.rows[i].w += a.rows[i].w;
+        }
+        return c;
+    }
+
+} // namespace eeng
+
+#endif /* Affine_hpp */
@@ -0,0 +1,76 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <cmath>
+#include <algorithm>
+#include "AnimationBake.hpp"
+
+namespace eeng
+{
+    uint32_t BakedAnimation::frameAt(
+        size_t clip,
+        float time,
+        AnmationTimeFormat animTimeFormat) const
+    {
+        EENG_ASSERT(clip < clips.size(), "{0} is not a baked clip", clip);
+        const auto& baked_clip = clips[clip];
+
+        // Normalized time, wrapped as RenderableMesh::animate() does for real time
+        float ntime = time;
+        if (animTimeFormat == AnmationTimeFormat::RealTime && baked_clip.duration > 0.0f)
+        {
+            ntime = std::fmod(time, baked_clip.duration) / baked_clip.duration;
+            if (ntime < 0.0f)
+                ntime += 1.0f;
+        }
+        ntime = glm::clamp(ntime, 0.0f, 1.0f);
+
+        const uint32_t frame = (uint32_t)std::lround(ntime * (baked_clip.nbr_frames - 1));
+        return baked_clip.first_frame + frame;
+    }
+
+    size_t BakedAnimation::byteSize() const
+    {
+        return sizeof(BakedAnimation) +
+            clips.capacity() * sizeof(BakedClip) +
+            palettes.capacity() * sizeof(Affine);
+    }
+
+    BakedAnimation bake_animations(
+        const RenderableMesh& mesh,
+        float frame_rate)
+    {
+        EENG_ASSERT(frame_rate > 0.0f, "Invalid bake frame rate {0}", frame_rate);
+
+        BakedAnimation baked;
+        baked.frame_rate = frame_rate;
+        baked.nbr_bones = mesh.m_bones.size();
+
+        // Frames per clip, with the first and last keys included
+        uint32_t nbr_frames = 0;
+        for (unsigned i = 0; i < mesh.getNbrAnimations(); i++)
+        {
+            BakedClip clip;
+            clip.duration = mesh.getAnimationDuration(i);
+            clip.first_frame = nbr_frames;
+            clip.nbr_frames = std::max(2u, (uint32_t)std::ceil(clip.duration * frame_rate) + 1);
+            nbr_frames += clip.nbr_frames;
+            baked.clips.push_back(clip);
+        }
+        baked.palettes.resize(size_t(nbr_frames) * baked.nbr_bones);
+
+        AnimationPose pose = mesh.createPose();
+        for (unsigned i = 0; i < baked.clips.size(); i++)
+        {
+            const auto& clip = baked.clips[i];
+            for (uint32_t frame = 0; frame < clip.nbr_frames; frame++)
+            {
+                const float ntime = float(frame) / (clip.nbr_frames - 1);
+                mesh.animate(pose, i, ntime, AnmationTimeFormat::NormalizedTime);
+                std::copy(pose.bone_matrices.begin(), pose.bone_matrices.end(),
+                    baked.palettes.begin() + size_t(clip.first_frame + frame) * baked.nbr_bones);
+            }
+        }
+        return baked;
+    }
+
+} // namespace eeng
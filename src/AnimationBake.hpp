@@ -0,0 +1,64 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef AnimationBake_hpp
+#define AnimationBake_hpp
+
+#include <cstdint>
+#include <vector>
+
+#include "Affine.hpp"
+#include "RenderableMesh.hpp"
+
+namespace eeng
+{
+    /// Default rate, in frames per second, that clips are baked at
+    const float DefaultBakeFrameRate = 30.0f;
+
+    /// @brief Frames of a clip in a BakedAnimation
+    struct BakedClip
+    {
+        uint32_t first_frame = 0;   //!< First frame in the palette table
+        uint32_t nbr_frames = 0;    //!< Frames from the first to the last key, inclusive
+        float duration = 0.0f;      //!< Clip duration, in seconds
+    };
+
+    /// @brief Skinning palettes of all clips of a mesh, sampled at a fixed rate
+    /// Palettes are packed frame by frame into one table, so a (clip, frame)
+    /// pair maps to one offset. Used to draw instances without evaluating poses.
+    struct BakedAnimation
+    {
+        float frame_rate = DefaultBakeFrameRate;
+        size_t nbr_bones = 0;
+        std::vector<BakedClip> clips;
+        std::vector<Affine> palettes;   //!< Frame-major, nbr_bones transforms per frame
+
+        /// @brief Total number of frames in the table
+        size_t nbrFrames() const { return nbr_bones ? palettes.size() / nbr_bones : 0; }
+
+        /// @brief Frame in the table closest to a clip time
+        /// @param clip Clip index
+        /// @param time Animation time, in seconds or normalized time (see animTimeFormat).
+        /// @param animTimeFormat Interpretation of time, as in RenderableMesh::animate().
+        uint32_t frameAt(
+            size_t clip,
+            float time,
+            AnmationTimeFormat animTimeFormat = AnmationTimeFormat::RealTime) const;
+
+        /// @brief Palette of a frame in the table
+        const Affine* palette(uint32_t frame) const { return palettes.data() + frame * nbr_bones; }
+
+        /// @brief Heap and member bytes held by the table
+        size_t byteSize() const;
+    };
+
+    /// @brief Sample the palettes of all clips of a mesh
+    /// Works without a GL context, so it can run headless or as part of cooking assets.
+    /// @param mesh Mesh with clips to bake
+    /// @param frame_rate Frames per second of clip time
+    BakedAnimation bake_animations(
+        const RenderableMesh& mesh,
+        float frame_rate = DefaultBakeFrameRate);
+
+} // namespace eeng
+
+#endif /* AnimationBake_hpp */
@@ -0,0 +1,54 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include "AnimationBatch.hpp"
+
+namespace eeng
+{
+    namespace
+    {
+        void evaluate_job(const AnimationJob& job)
+        {
+            if (job.anim_index1 >= 0 && job.anim_index0 >= 0)
+                job.mesh->animateBlend(*job.pose,
+                    job.anim_index0,
+                    job.anim_index1,
+                    job.time0,
+                    job.time1,
+                    job.frac,
+                    job.time_format0,
+                    job.time_format1);
+            else
+                job.mesh->animate(*job.pose, job.anim_index0, job.time0, job.time_format0);
+        }
+    }
+
+    void animate_job(const AnimationJob& job)
+    {
+        EENG_ASSERT(job.mesh && job.pose, "Invalid animation job");
+
+        if (!job.lod)
+        {
+            evaluate_job(job);
+            return;
+        }
+
+        EENG_ASSERT(job.lod_policy, "Animation job with LOD state but no policy");
+        const bool evaluate = lod_begin_frame(*job.lod, *job.lod_policy, *job.pose);
+        if (evaluate)
+            evaluate_job(job);
+        lod_end_frame(*job.lod, *job.lod_policy, *job.pose, evaluate);
+    }
+
+    void animate_batch(
+        ThreadPool& pool,
+        std::span<const AnimationJob> jobs,
+        size_t grain_size)
+    {
+        pool.parallelFor(jobs.size(), grain_size, [&](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; i++)
+                    animate_job(jobs[i]);
+            });
+    }
+
+} // namespace eeng
@@ -0,0 +1,49 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef AnimationBatch_hpp
+#define AnimationBatch_hpp
+
+#include <span>
+#include "RenderableMesh.hpp"
+#include "AnimationLod.hpp"
+#include "ThreadPool.hpp"
+
+namespace eeng
+{
+    /// @brief Evaluation of a pose for one instance
+    /// Evaluates a single clip, or a blend of two clips if anim_index1 is a valid clip.
+    struct AnimationJob
+    {
+        const RenderableMesh* mesh = nullptr;
+        AnimationPose* pose = nullptr;          //!< Output. Must be created by mesh->createPose().
+        int anim_index0 = -1;                   //!< Clip index. Use -1 for bind pose.
+        int anim_index1 = -1;                   //!< Clip to blend with. Use -1 for no blending.
+        float time0 = 0.0f;
+        float time1 = 0.0f;
+        float frac = 0.0f;                      //!< Blend fraction, where 0 gives clip 0 and 1 gives clip 1
+        AnmationTimeFormat time_format0 = AnmationTimeFormat::RealTime;
+        AnmationTimeFormat time_format1 = AnmationTimeFormat::RealTime;
+        AnimationLod* lod = nullptr;                    //!< LOD state of the instance, or nullptr for full detail
+        const AnimationLodPolicy* lod_policy = nullptr; //!< Required if lod is set
+    };
+
+    /// @brief Run a single animation job on the calling thread
+    /// With LOD, the pose may be interpolated rather than evaluated, and
+    /// nodes with a small reach may keep their previous transforms.
+    void animate_job(const AnimationJob& job);
+
+    /// @brief Run animation jobs in parallel
+    /// Returns when all poses, including their bone matrices, are ready.
+    /// Meshes must not be modified (loaded, or animated via their own pose) during the call,
+    /// and a pose must not appear in more than one job.
+    /// @param pool Pool to run jobs on
+    /// @param jobs Jobs to run
+    /// @param grain_size Jobs per work chunk
+    void animate_batch(
+        ThreadPool& pool,
+        std::span<const AnimationJob> jobs,
+        size_t grain_size = 8);
+
+} // namespace eeng
+
+#endif /* AnimationBatch_hpp */
@@ -0,0 +1,395 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <cmath>
+#include "AnimationBlendTree.hpp"
+
+namespace eeng
+{
+    BoneMask make_bone_mask(
+        const RenderableMesh& mesh,
+        const std::string& root_node_name,
+        float weight,
+        float outside_weight)
+    {
+        BoneMask mask;
+        mask.node_weights.assign(mesh.m_nodetree.size(), outside_weight);
+
+        const auto it = mesh.m_nodehash.find(root_node_name);
+        EENG_ASSERT(it != mesh.m_nodehash.end(), "No node named {0}", root_node_name);
+
+        // Nodes are stored in pre-order, so a branch is a contiguous range
+        const size_t node_index = it->second;
+        const auto [payload, nbr_children, branch_size, parent_ofs] = mesh.m_nodetree.get_node_info_at(node_index);
+        for (size_t i = node_index; i < node_index + branch_size; i++)
+            mask.node_weights[i] = weight;
+        return mask;
+    }
+
+    LocalPose& LocalPosePool::acquire(size_t nbr_nodes)
+    {
+        if (m_nbr_used == m_poses.size())
+            m_poses.emplace_back();
+
+        LocalPose& local = m_poses[m_nbr_used++];
+        local.resize(nbr_nodes);
+        return local;
+    }
+
+    void LocalPosePool::release()
+    {
+        EENG_ASSERT(m_nbr_used > 0, "Local pose released to a pool with no poses in use");
+        m_nbr_used--;
+    }
+
+    int BlendTree::addNode(Node&& node)
+    {
+        for (int child : node.children)
+            EENG_ASSERT(child >= 0 && child < (int)m_nodes.size(), "{0} is not a valid blend tree node", child);
+
+        m_nodes.push_back(std::move(node));
+        m_root = (int)m_nodes.size() - 1;
+        return m_root;
+    }
+
+    int BlendTree::addClip(
+        int anim_index,
+        float speed,
+        AnmationTimeFormat time_format)
+    {
+        Node node;
+        node.type = NodeType::Clip;
+        node.anim_index = anim_index;
+        node.speed = speed;
+        node.time_format = time_format;
+        return addNode(std::move(node));
+    }
+
+    int BlendTree::addBlend(const std::vector<int>& children)
+    {
+        Node node;
+        node.type = NodeType::Blend;
+        node.children = children;
+        node.weights.assign(children.size(), 0.0f);
+        node.masks.assign(children.size(), nullptr);
+        return addNode(std::move(node));
+    }
+
+    int BlendTree::addBlendSpace1D(
+        const std::vector<int>& clips,
+        const std::vector<float>& positions)
+    {
+        EENG_ASSERT(!clips.empty() && clips.size() == positions.size(), "Blend space needs one position per clip");
+
+        Node node;
+        node.type = NodeType::BlendSpace1D;
+        node.children = clips;
+        node.weights.assign(clips.size(), 0.0f);
+        node.masks.assign(clips.size(), nullptr);
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            EENG_ASSERT(i == 0 || positions[i] > positions[i - 1], "Blend space positions must be increasing");
+            node.positions.push_back({ positions[i], 0.0f });
+        }
+
+        const int node_index = addNode(std::move(node));
+        for (int clip : clips)
+            EENG_ASSERT(m_nodes[clip].type == NodeType::Clip, "Blend space node {0} is not a clip", clip);
+        setParameter(node_index, positions.front());
+        return node_index;
+    }
+
+    int BlendTree::addBlendSpace2D(
+        const std::vector<int>& clips,
+        const std::vector<glm::vec2>& positions)
+    {
+        EENG_ASSERT(!clips.empty() && clips.size() == positions.size(), "Blend space needs one position per clip");
+
+        Node node;
+        node.type = NodeType::BlendSpace2D;
+        node.children = clips;
+        node.weights.assign(clips.size(), 0.0f);
+        node.masks.assign(clips.size(), nullptr);
+        node.positions = positions;
+
+        const int node_index = addNode(std::move(node));
+        for (int clip : clips)
+            EENG_ASSERT(m_nodes[clip].type == NodeType::Clip, "Blend space node {0} is not a clip", clip);
+        setParameter(node_index, positions.front());
+        return node_index;
+    }
+
+    int BlendTree::addAdditive(
+        int base,
+        int additive,
+        int reference,
+        const BoneMask* mask)
+    {
+        Node node;
+        node.type = NodeType::Additive;
+        node.children = { base, additive, reference };
+        node.weights = { 1.0f };
+        node.masks = { mask };
+        return addNode(std::move(node));
+    }
+
+    void BlendTree::setRoot(int node)
+    {
+        EENG_ASSERT(node >= 0 && node < (int)m_nodes.size(), "{0} is not a valid blend tree node", node);
+        m_root = node;
+    }
+
+    void BlendTree::setWeight(int node, size_t child, float weight)
+    {
+        auto& blend = m_nodes[node];
+        EENG_ASSERT(blend.type == NodeType::Blend, "Node {0} is not a blend", node);
+        blend.weights[child] = std::max(weight, 0.0f);
+    }
+
+    void BlendTree::setMask(int node, size_t child, const BoneMask* mask)
+    {
+        auto& blend = m_nodes[node];
+        EENG_ASSERT(blend.type != NodeType::Clip, "Node {0} is a clip", node);
+        blend.masks[child] = mask;
+    }
+
+    void BlendTree::setParameter(int node_index, float value)
+    {
+        auto& node = m_nodes[node_index];
+        if (node.type == NodeType::Additive)
+        {
+            node.weights[0] = glm::clamp(value, 0.0f, 1.0f);
+            return;
+        }
+        EENG_ASSERT(node.type == NodeType::BlendSpace1D, "Node {0} is not a 1D blend space", node_index);
+
+        // Weigh the two clips around the parameter
+        const auto& positions = node.positions;
+        std::fill(node.weights.begin(), node.weights.end(), 0.0f);
+        if (value <= positions.front().x)
+        {
+            node.weights.front() = 1.0f;
+            return;
+        }
+        for (size_t i = 1; i < positions.size(); i++)
+        {
+            if (value <= positions[i].x)
+            {
+                const float frac = (value - positions[i - 1].x) / (positions[i].x - positions[i - 1].x);
+                node.weights[i - 1] = 1.0f - frac;
+                node.weights[i] = frac;
+                return;
+            }
+        }
+        node.weights.back() = 1.0f;
+    }
+
+    void BlendTree::setParameter(int node_index, const glm::vec2& value)
+    {
+        auto& node = m_nodes[node_index];
+        EENG_ASSERT(node.type == NodeType::BlendSpace2D, "Node {0} is not a 2D blend space", node_index);
+
+        // Inverse squared distance, where a parameter on a clip gives only that clip
+        float weight_sum = 0.0f;
+        for (size_t i = 0; i < node.positions.size(); i++)
+        {
+            const glm::vec2 d = node.positions[i] - value;
+            const float dist2 = glm::dot(d, d);
+            if (dist2 < 1e-8f)
+            {
+                std::fill(node.weights.begin(), node.weights.end(), 0.0f);
+                node.weights[i] = 1.0f;
+                return;
+            }
+            node.weights[i] = 1.0f / dist2;
+            weight_sum += node.weights[i];
+        }
+        for (auto& weight : node.weights)
+            weight /= weight_sum;
+    }
+
+    void BlendTree::evaluate(
+        const RenderableMesh& mesh,
+        AnimationPose& pose,
+        LocalPosePool& pool,
+        float time)
+    {
+        EENG_ASSERT(m_root != EENG_NULL_INDEX, "Blend tree is empty");
+
+        m_nbr_sampled = 0;
+        LocalPose& local = pool.acquire(mesh.m_nodetree.size());
+        evaluateNode(m_root, mesh, pose, pool, time, -1.0f, local);
+        mesh.applyLocalPose(pose, local);
+        pool.release();
+    }
+
+    void BlendTree::evaluateNode(
+        int node_index,
+        const RenderableMesh& mesh,
+        const AnimationPose& pose,
+        LocalPosePool& pool,
+        float time,
+        float phase,
+        LocalPose& out)
+    {
+        auto& node = m_nodes[node_index];
+        switch (node.type)
+        {
+        case NodeType::Clip:
+            // Clips in blend spaces play at the phase of the blend space
+            if (phase >= 0.0f)
+                mesh.sampleLocalPose(out, node.anim_index, phase, AnmationTimeFormat::NormalizedTime, node.cursors, pose.lod_min_reach);
+            else
+                mesh.sampleLocalPose(out, node.anim_index, time * node.speed, node.time_format, node.cursors, pose.lod_min_reach);
+            m_nbr_sampled++;
+            break;
+        case NodeType::Blend:
+            evaluateBlend(node, mesh, pose, pool, time, phase, out);
+            break;
+        case NodeType::BlendSpace1D:
+        case NodeType::BlendSpace2D:
+            evaluateBlend(node, mesh, pose, pool, time, advancePhase(node, mesh, time), out);
+            break;
+        case NodeType::Additive:
+            evaluateAdditive(node, mesh, pose, pool, time, phase, out);
+            break;
+        }
+    }
+
+    void BlendTree::evaluateBlend(
+        Node& node,
+        const RenderableMesh& mesh,
+        const AnimationPose& pose,
+        LocalPosePool& pool,
+        float time,
+        float phase,
+        LocalPose& out)
+    {
+        const size_t nbr_nodes = mesh.m_nodetree.size();
+        std::fill(out.positions.begin(), out.positions.end(), glm::vec3(0.0f));
+        std::fill(out.rotations.begin(), out.rotations.end(), glm::quat(0.0f, 0.0f, 0.0f, 0.0f));
+        std::fill(out.scales.begin(), out.scales.end(), glm::vec3(0.0f));
+        std::fill(out.weights.begin(), out.weights.end(), 0.0f);
+
+        // Accumulate children with a weight, without evaluating the others
+        for (size_t c = 0; c < node.children.size(); c++)
+        {
+            const float weight = node.weights[c];
+            if (weight < BlendWeightEpsilon)
+                continue;
+
+            LocalPose& child = pool.acquire(nbr_nodes);
+            evaluateNode(node.children[c], mesh, pose, pool, time, phase, child);
+
+            const BoneMask* mask = node.masks[c];
+            for (size_t i = 0; i < nbr_nodes; i++)
+            {
+                const float w = (mask ? weight * mask->node_weights[i] : weight);
+                if (w <= 0.0f)
+                    continue;
+
+                // Rotations are accumulated in the same hemisphere, then normalized (nlerp)
+                const glm::quat& rot = child.rotations[i];
+                const float sign = (glm::dot(out.rotations[i], rot) < 0.0f ? -1.0f : 1.0f);
+                out.positions[i] += w * child.positions[i];
+                out.rotations[i] = out.rotations[i] + (sign * w) * rot;
+                out.scales[i] += w * child.scales[i];
+                out.weights[i] += w;
+            }
+            pool.release();
+        }
+
+        // Normalize per node, where nodes without weight fall back to bind pose
+        const LocalPose& bind = mesh.getBindLocalPose();
+        for (size_t i = 0; i < nbr_nodes; i++)
+        {
+            const float weight_sum = out.weights[i];
+            if (weight_sum > 0.0f)
+            {
+                out.positions[i] /= weight_sum;
+                out.rotations[i] = glm::normalize(out.rotations[i]);
+                out.scales[i] /= weight_sum;
+            }
+            else
+            {
+                out.positions[i] = bind.positions[i];
+                out.rotations[i] = bind.rotations[i];
+                out.scales[i] = bind.scales[i];
+            }
+        }
+    }
+
+    void BlendTree::evaluateAdditive(
+        Node& node,
+        const RenderableMesh& mesh,
+        const AnimationPose& pose,
+        LocalPosePool& pool,
+        float time,
+        float phase,
+        LocalPose& out)
+    {
+        evaluateNode(node.children[0], mesh, pose, pool, time, phase, out);
+
+        const float weight = node.weights[0];
+        if (weight < BlendWeightEpsilon)
+            return;
+
+        const size_t nbr_nodes = mesh.m_nodetree.size();
+        LocalPose& additive = pool.acquire(nbr_nodes);
+        LocalPose& reference = pool.acquire(nbr_nodes);
+        evaluateNode(node.children[1], mesh, pose, pool, time, phase, additive);
+        evaluateNode(node.children[2], mesh, pose, pool, time, phase, reference);
+
+        const BoneMask* mask = node.masks[0];
+        const glm::quat identity(1.0f, 0.0f, 0.0f, 0.0f);
+        for (size_t i = 0; i < nbr_nodes; i++)
+        {
+            const float w = (mask ? weight * mask->node_weights[i] : weight);
+            if (w <= 0.0f)
+                continue;
+
+            // Difference to the reference, in the local space of the node
+            const glm::vec3 delta_pos = additive.positions[i] - reference.positions[i];
+            const glm::quat delta_rot = glm::inverse(reference.rotations[i]) * additive.rotations[i];
+            const glm::vec3 delta_scale = additive.scales[i] / reference.scales[i];
+
+            out.positions[i] += w * delta_pos;
+            out.rotations[i] = glm::normalize(out.rotations[i] * glm::slerp(identity, delta_rot, w));
+            out.scales[i] *= glm::mix(glm::vec3(1.0f), delta_scale, w);
+        }
+        pool.release();
+        pool.release();
+    }
+
+    float BlendTree::advancePhase(
+        Node& node,
+        const RenderableMesh& mesh,
+        float time)
+    {
+        // Clips are synced by playing them at the weighted average duration,
+        // and the phase is advanced rather than derived from time so that
+        // it stays continuous as weights change.
+        float duration = 0.0f, weight_sum = 0.0f;
+        for (size_t c = 0; c < node.children.size(); c++)
+        {
+            const auto& clip = m_nodes[node.children[c]];
+            if (node.weights[c] < BlendWeightEpsilon || clip.anim_index < 0 || clip.speed <= 0.0f)
+                continue;
+            duration += node.weights[c] * mesh.getAnimationDuration(clip.anim_index) / clip.speed;
+            weight_sum += node.weights[c];
+        }
+
+        if (duration > 0.0f)
+        {
+            duration /= weight_sum;
+            if (node.phase_time < 0.0f)
+                node.phase = std::fmod(time / duration, 1.0f);
+            else
+                node.phase = std::fmod(node.phase + (time - node.phase_time) / duration, 1.0f);
+            if (node.phase < 0.0f)
+                node.phase += 1.0f;
+        }
+        node.phase_time = time;
+        return node.phase;
+    }
+
+} // namespace eeng
@@ -0,0 +1,217 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef AnimationBlendTree_hpp
+#define AnimationBlendTree_hpp
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "RenderableMesh.hpp"
+
+namespace eeng
+{
+    /// Blend weights below this are treated as zero, and the clips below them are not sampled
+    constexpr float BlendWeightEpsilon = 1e-3f;
+
+    /// @brief Per-node weights that limit a blend or an additive layer to part of a skeleton
+    struct BoneMask
+    {
+        std::vector<float> node_weights;
+    };
+
+    /// @brief Create a mask for the branch below a node, e.g. the upper body from the spine
+    /// @param mesh Mesh the mask is used with
+    /// @param root_node_name Name of the first node of the branch
+    /// @param weight Weight of nodes in the branch
+    /// @param outside_weight Weight of all other nodes
+    BoneMask make_bone_mask(
+        const RenderableMesh& mesh,
+        const std::string& root_node_name,
+        float weight = 1.0f,
+        float outside_weight = 0.0f);
+
+    /// @brief Reusable local poses for intermediate results of blending
+    /// Poses are handed out and returned in stack order. Once the pool has
+    /// grown to the deepest blend evaluated, no more memory is allocated.
+    /// A pool must not be shared between threads.
+    class LocalPosePool
+    {
+    public:
+        /// @brief Take a pose, sized for a number of nodes
+        LocalPose& acquire(size_t nbr_nodes);
+
+        /// @brief Return the most recently acquired pose
+        void release();
+
+        /// @brief Number of poses allocated by the pool
+        size_t nbrAllocated() const { return m_poses.size(); }
+
+    private:
+        std::deque<LocalPose> m_poses;  // Deque, so acquired references stay valid as the pool grows
+        size_t m_nbr_used = 0;
+    };
+
+    /// @brief Graph of clips and blend operations evaluated into a pose
+    /// Nodes are added bottom-up, and the node added last is the root unless
+    /// setRoot() is called. Supports N-way weighted blends, 1D and 2D blend
+    /// spaces, additive layers, and per-bone masks. Parameters such as weights
+    /// are per instance, so each animated instance owns its own tree.
+    class BlendTree
+    {
+    public:
+        /// @brief Add a clip
+        /// @param anim_index Clip index. Use -1 for bind pose.
+        /// @param speed Playback speed, multiplied with the time passed to evaluate().
+        /// @param time_format Interpretation of time when mapping to keyframes.
+        /// @return Node index
+        int addClip(
+            int anim_index,
+            float speed = 1.0f,
+            AnmationTimeFormat time_format = AnmationTimeFormat::RealTime);
+
+        /// @brief Add a weighted blend of any number of nodes
+        /// Weights are normalized per node, and are all 0 until set with setWeight().
+        /// @param children Nodes to blend
+        /// @return Node index
+        int addBlend(const std::vector<int>& children);
+
+        /// @brief Add a blend of clips placed along a line, e.g. by speed
+        /// Clips are played in sync, at the weighted average of their durations.
+        /// @param clips Clip nodes
+        /// @param positions Position per clip, in increasing order
+        /// @return Node index
+        int addBlendSpace1D(
+            const std::vector<int>& clips,
+            const std::vector<float>& positions);
+
+        /// @brief Add a blend of clips placed in a plane, e.g. by forward and sideways speed
+        /// Clips are weighted by inverse squared distance and played in sync.
+        /// @param clips Clip nodes
+        /// @param positions Position per clip
+        /// @return Node index
+        int addBlendSpace2D(
+            const std::vector<int>& clips,
+            const std::vector<glm::vec2>& positions);
+
+        /// @brief Add an additive layer on top of a base
+        /// The difference between the additive and reference nodes, typically a
+        /// clip and its first frame, is applied to the base, scaled by the weight.
+        /// @param base Base node
+        /// @param additive Node that holds the additive motion
+        /// @param reference Node that the additive motion is relative to
+        /// @param mask Nodes affected by the layer, or nullptr for all. Must outlive the tree.
+        /// @return Node index
+        int addAdditive(
+            int base,
+            int additive,
+            int reference,
+            const BoneMask* mask = nullptr);
+
+        /// @brief Set the node that is evaluated into the pose
+        void setRoot(int node);
+
+        /// @brief Set the weight of a child of a blend
+        void setWeight(int node, size_t child, float weight);
+
+        /// @brief Set the mask of a child of a blend
+        /// @param mask Mask, or nullptr for all nodes. Must outlive the tree.
+        void setMask(int node, size_t child, const BoneMask* mask);
+
+        /// @brief Set the parameter of a 1D blend space, or the weight of an additive layer
+        void setParameter(int node, float value);
+
+        /// @brief Set the parameter of a 2D blend space
+        void setParameter(int node, const glm::vec2& value);
+
+        /// @brief Number of nodes in the tree
+        size_t nbrNodes() const { return m_nodes.size(); }
+
+        /// @brief Number of clips sampled by the last evaluate()
+        size_t nbrSampledClips() const { return m_nbr_sampled; }
+
+        /// @brief Evaluate the tree into a pose
+        /// @param mesh Mesh the clips belong to
+        /// @param pose Pose to write to. Must be created by mesh.createPose().
+        /// @param pool Pool for intermediate poses
+        /// @param time Animation time, in seconds
+        void evaluate(
+            const RenderableMesh& mesh,
+            AnimationPose& pose,
+            LocalPosePool& pool,
+            float time);
+
+    private:
+        enum class NodeType
+        {
+            Clip,
+            Blend,
+            BlendSpace1D,
+            BlendSpace2D,
+            Additive
+        };
+
+        struct Node
+        {
+            NodeType type = NodeType::Clip;
+
+            // Clip
+            int anim_index = EENG_NULL_INDEX;
+            float speed = 1.0f;
+            AnmationTimeFormat time_format = AnmationTimeFormat::RealTime;
+            AnimationPose::KeyCursors cursors;
+
+            // Blends, blend spaces and additive layers
+            std::vector<int> children;
+            std::vector<float> weights;             //!< Per child. Additive layers use weights[0].
+            std::vector<const BoneMask*> masks;     //!< Per child. Additive layers use masks[0].
+
+            // Blend spaces
+            std::vector<glm::vec2> positions;
+            float phase = 0.0f;                     //!< Normalized time shared by the clips
+            float phase_time = -1.0f;               //!< Time the phase was last advanced, < 0 if never
+        };
+
+        int addNode(Node&& node);
+
+        void evaluateNode(
+            int node_index,
+            const RenderableMesh& mesh,
+            const AnimationPose& pose,
+            LocalPosePool& pool,
+            float time,
+            float phase,
+            LocalPose& out);
+
+        void evaluateBlend(
+            Node& node,
+            const RenderableMesh& mesh,
+            const AnimationPose& pose,
+            LocalPosePool& pool,
+            float time,
+            float phase,
+            LocalPose& out);
+
+        void evaluateAdditive(
+            Node& node,
+            const RenderableMesh& mesh,
+            const AnimationPose& pose,
+            LocalPosePool& pool,
+            float time,
+            float phase,
+            LocalPose& out);
+
+        float advancePhase(
+            Node& node,
+            const RenderableMesh& mesh,
+            float time);
+
+        std::vector<Node> m_nodes;
+        int m_root = EENG_NULL_INDEX;
+        size_t m_nbr_sampled = 0;
+    };
+
+} // namespace eeng
+
+#endif /* AnimationBlendTree_hpp */
@@ -0,0 +1,289 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include "AnimationCompression.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include "config.h"
+
+namespace eeng
+{
+    namespace
+    {
+        // Largest magnitude of any but the largest component of a unit quaternion (1/sqrt(2))
+        constexpr float QuatComponentRange = 0.70710678f;
+        constexpr float QuatComponentSteps = 32767.0f;  // 15 bits
+        constexpr float Vec3ComponentSteps = 65535.0f;  // 16 bits
+
+        inline uint16_t quantize_unit(float v, float steps)
+        {
+            return (uint16_t)std::lround(glm::clamp(v, 0.0f, 1.0f) * steps);
+        }
+
+        inline float quat_angle(const glm::quat& a, const glm::quat& b)
+        {
+            return 2.0f * std::acos(std::min(1.0f, std::abs(glm::dot(a, b))));
+        }
+
+        /// Pick keys from a uniformly spaced track that are needed to reconstruct
+        /// all other keys within tolerance, by interpolating between picked keys.
+        /// Greedy: a segment is extended from the last picked key as long as all
+        /// keys it spans are within tolerance.
+        template<class T, class Interpolate, class Distance>
+        void reduce_keys(
+            const T* keys,
+            size_t nbr_keys,
+            float tolerance,
+            std::vector<uint16_t>& picked,
+            Interpolate&& interpolate,
+            Distance&& distance)
+        {
+            picked.clear();
+            picked.push_back(0);
+
+            // Constant tracks keep a single key
+            bool is_constant = true;
+            for (size_t i = 1; i < nbr_keys && is_constant; i++)
+                is_constant = distance(keys[0], keys[i]) <= tolerance;
+            if (is_constant)
+                return;
+
+            size_t first = 0;
+            for (size_t last = 2; last < nbr_keys; last++)
+            {
+                bool within_tolerance = true;
+                for (size_t i = first + 1; i < last && within_tolerance; i++)
+                {
+                    const float t = float(i - first) / float(last - first);
+                    within_tolerance = distance(interpolate(keys[first], keys[last], t), keys[i]) <= tolerance;
+                }
+                if (!within_tolerance)
+                {
+                    first = last - 1;
+                    picked.push_back((uint16_t)first);
+                }
+            }
+            picked.push_back((uint16_t)(nbr_keys - 1));
+        }
+
+        /// Locate the key at or before key_pos, starting at a cursor
+        inline size_t seek_key(
+            const uint16_t* frames,
+            size_t nbr_keys,
+            float key_pos,
+            uint16_t& cursor)
+        {
+            size_t k = std::min<size_t>(cursor, nbr_keys - 1);
+            while (k > 0 && frames[k] > key_pos) k--; // Time moved backwards, e.g. a looping clip
+            while (k + 1 < nbr_keys && frames[k + 1] <= key_pos) k++;
+            cursor = (uint16_t)k;
+            return k;
+        }
+
+        inline float key_frac(
+            const uint16_t* frames,
+            size_t nbr_keys,
+            size_t k,
+            float key_pos)
+        {
+            if (k + 1 >= nbr_keys) return 0.0f;
+            return glm::clamp((key_pos - frames[k]) / float(frames[k + 1] - frames[k]), 0.0f, 1.0f);
+        }
+    }
+
+    QuantizedQuat quantize_quat(const glm::quat& q)
+    {
+        const glm::quat qn = glm::normalize(q);
+
+        int largest = 0;
+        for (int i = 1; i < 4; i++)
+            if (std::abs(qn[i]) > std::abs(qn[largest])) largest = i;
+
+        // q and -q are the same rotation, so the largest component is made positive and dropped
+        const float sign = (qn[largest] < 0.0f ? -1.0f : 1.0f);
+        uint16_t c[3];
+        for (int i = 0, j = 0; i < 4; i++)
+        {
+            if (i == largest) continue;
+            c[j++] = quantize_unit((sign * qn[i] / QuatComponentRange) * 0.5f + 0.5f, QuatComponentSteps);
+        }
+
+        QuantizedQuat qq;
+        qq.data[0] = c[0] | (uint16_t)((largest & 1) << 15);
+        qq.data[1] = c[1] | (uint16_t)((largest >> 1) << 15);
+        qq.data[2] = c[2];
+        return qq;
+    }
+
+    glm::quat dequantize_quat(const QuantizedQuat& qq)
+    {
+        const int largest = (qq.data[0] >> 15) | ((qq.data[1] >> 15) << 1);
+
+        glm::quat q;
+        float sum_sq = 0.0f;
+        for (int i = 0, j = 0; i < 4; i++)
+        {
+            if (i == largest) continue;
+            const float v = ((qq.data[j++] & 0x7fff) / QuatComponentSteps * 2.0f - 1.0f) * QuatComponentRange;
+            q[i] = v;
+            sum_sq += v * v;
+        }
+        q[largest] = std::sqrt(std::max(0.0f, 1.0f - sum_sq));
+        return q;
+    }
+
+    QuantizedVec3 quantize_vec3(const glm::vec3& v, const glm::vec3& min, const glm::vec3& extent)
+    {
+        QuantizedVec3 qv;
+        for (int i = 0; i < 3; i++)
+            qv.data[i] = (extent[i] > 0.0f ? quantize_unit((v[i] - min[i]) / extent[i], Vec3ComponentSteps) : 0);
+        return qv;
+    }
+
+    glm::vec3 dequantize_vec3(const QuantizedVec3& qv, const glm::vec3& min, const glm::vec3& extent)
+    {
+        return min + extent * glm::vec3(qv.data[0], qv.data[1], qv.data[2]) / Vec3ComponentSteps;
+    }
+
+    void CompressedClip::init(size_t nbr_channels, size_t nbr_keys)
+    {
+        EENG_ASSERT(nbr_keys <= 65536, "Too many keys to compress ({0})", nbr_keys);
+        m_channels.clear();
+        m_channels.reserve(nbr_channels);
+        m_vec3_frames.clear();
+        m_vec3_keys.clear();
+        m_quat_frames.clear();
+        m_quat_keys.clear();
+    }
+
+    void CompressedClip::addChannel(
+        const glm::vec3* pos_keys,
+        const glm::quat* rot_keys,
+        const glm::vec3* scale_keys,
+        size_t nbr_keys,
+        const AnimationCompression& settings)
+    {
+        Channel channel;
+        addVec3Track(channel.pos, pos_keys, nbr_keys, settings.translation_tolerance);
+        addQuatTrack(channel.rot, rot_keys, nbr_keys, settings.rotation_tolerance);
+        addVec3Track(channel.scale, scale_keys, nbr_keys, settings.scale_tolerance);
+
+        m_channels.push_back(channel);
+    }
+
+    void CompressedClip::shrink()
+    {
+        m_channels.shrink_to_fit();
+        m_vec3_frames.shrink_to_fit();
+        m_vec3_keys.shrink_to_fit();
+        m_quat_frames.shrink_to_fit();
+        m_quat_keys.shrink_to_fit();
+    }
+
+    void CompressedClip::addVec3Track(
+        Vec3Track& track,
+        const glm::vec3* keys,
+        size_t nbr_keys,
+        float tolerance)
+    {
+        EENG_ASSERT(nbr_keys, "Empty track");
+
+        std::vector<uint16_t> picked;
+        reduce_keys(keys, nbr_keys, tolerance, picked,
+            [](const glm::vec3& a, const glm::vec3& b, float t) { return glm::mix(a, b, t); },
+            [](const glm::vec3& a, const glm::vec3& b) { return glm::length(a - b); });
+
+        glm::vec3 min = keys[picked[0]], max = keys[picked[0]];
+        for (auto k : picked)
+        {
+            min = glm::min(min, keys[k]);
+            max = glm::max(max, keys[k]);
+        }
+
+        track.min = min;
+        track.extent = max - min;
+        track.key_ofs = (uint32_t)m_vec3_keys.size();
+        track.nbr_keys = (uint32_t)picked.size();
+        for (auto k : picked)
+        {
+            m_vec3_frames.push_back(k);
+            m_vec3_keys.push_back(quantize_vec3(keys[k], track.min, track.extent));
+        }
+    }
+
+    void CompressedClip::addQuatTrack(
+        QuatTrack& track,
+        const glm::quat* keys,
+        size_t nbr_keys,
+        float tolerance)
+    {
+        EENG_ASSERT(nbr_keys, "Empty track");
+
+        std::vector<uint16_t> picked;
+        reduce_keys(keys, nbr_keys, tolerance, picked,
+            [](const glm::quat& a, const glm::quat& b, float t) { return glm::slerp(a, b, t); },
+            quat_angle);
+
+        track.key_ofs = (uint32_t)m_quat_keys.size();
+        track.nbr_keys = (uint32_t)picked.size();
+        for (auto k : picked)
+        {
+            m_quat_frames.push_back(k);
+            m_quat_keys.push_back(quantize_quat(keys[k]));
+        }
+    }
+
+    void CompressedClip::sample(
+        size_t channel_index,
+        float key_pos,
+        uint16_t* cursors,
+        glm::vec3& pos,
+        glm::quat& rot,
+        glm::vec3& scale) const
+    {
+        const auto& channel = m_channels[channel_index];
+        uint16_t* channel_cursors = cursors + channel_index * CursorsPerChannel;
+
+        auto sample_vec3 = [&](const Vec3Track& track, uint16_t& cursor)
+            {
+                const uint16_t* frames = m_vec3_frames.data() + track.key_ofs;
+                const QuantizedVec3* keys = m_vec3_keys.data() + track.key_ofs;
+                const size_t k = seek_key(frames, track.nbr_keys, key_pos, cursor);
+                const glm::vec3 v0 = dequantize_vec3(keys[k], track.min, track.extent);
+                if (k + 1 >= track.nbr_keys) return v0;
+                const glm::vec3 v1 = dequantize_vec3(keys[k + 1], track.min, track.extent);
+                return glm::mix(v0, v1, key_frac(frames, track.nbr_keys, k, key_pos));
+            };
+
+        pos = sample_vec3(channel.pos, channel_cursors[0]);
+        scale = sample_vec3(channel.scale, channel_cursors[2]);
+
+        const uint16_t* frames = m_quat_frames.data() + channel.rot.key_ofs;
+        const QuantizedQuat* keys = m_quat_keys.data() + channel.rot.key_ofs;
+        const size_t k = seek_key(frames, channel.rot.nbr_keys, key_pos, channel_cursors[1]);
+        rot = dequantize_quat(keys[k]);
+        if (k + 1 < channel.rot.nbr_keys)
+            rot = glm::slerp(rot, dequantize_quat(keys[k + 1]), key_frac(frames, channel.rot.nbr_keys, k, key_pos));
+    }
+
+    void CompressedClip::flattenTranslation(size_t channel_index)
+    {
+        EENG_ASSERT(channel_index < m_channels.size(), "{0} is not a valid channel", channel_index);
+
+        // Keys are relative the quantization range, so a zero range zeroes all keys
+        auto& track = m_channels[channel_index].pos;
+        track.min.x = track.min.z = 0.0f;
+        track.extent.x = track.extent.z = 0.0f;
+    }
+
+    size_t CompressedClip::byteSize() const
+    {
+        return sizeof(*this) +
+            m_channels.capacity() * sizeof(Channel) +
+            m_vec3_frames.capacity() * sizeof(uint16_t) +
+            m_vec3_keys.capacity() * sizeof(QuantizedVec3) +
+            m_quat_frames.capacity() * sizeof(uint16_t) +
+            m_quat_keys.capacity() * sizeof(QuantizedQuat);
+    }
+
+} // namespace eeng
@@ -0,0 +1,142 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef AnimationCompression_hpp
+#define AnimationCompression_hpp
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace eeng
+{
+    /// @brief Settings for compressed animation clips
+    /// Tolerances are the largest error allowed when keys are stripped.
+    /// Quantization adds a small error on top of this.
+    struct AnimationCompression
+    {
+        bool enabled = false;
+        float translation_tolerance = 0.01f;    //!< In model units
+        float rotation_tolerance = 0.001f;      //!< In radians
+        float scale_tolerance = 0.001f;
+    };
+
+    /// @brief Unit quaternion in 48 bits (smallest-three)
+    /// The three smallest components are stored with 15 bits each, and the
+    /// index of the largest component in the two remaining bits.
+    struct QuantizedQuat
+    {
+        uint16_t data[3];
+    };
+
+    /// @brief Vector in 48 bits, 16 bits per component over a given range
+    struct QuantizedVec3
+    {
+        uint16_t data[3];
+    };
+
+    QuantizedQuat quantize_quat(const glm::quat& q);
+
+    glm::quat dequantize_quat(const QuantizedQuat& qq);
+
+    QuantizedVec3 quantize_vec3(const glm::vec3& v, const glm::vec3& min, const glm::vec3& extent);
+
+    glm::vec3 dequantize_vec3(const QuantizedVec3& qv, const glm::vec3& min, const glm::vec3& extent);
+
+    /// @brief Compressed keyframes of an animation clip
+    /// Channels are indexed as in the uncompressed clip. Each channel has a translation,
+    /// rotation and scale track, and each track keeps the subset of the
+    /// clip's uniform keys that cannot be interpolated within tolerance.
+    /// Tracks are sampled using cursors to the last key visited, so
+    /// sampling a clip forward in time does not search for keys.
+    class CompressedClip
+    {
+        struct Vec3Track
+        {
+            glm::vec3 min{ 0.0f };      //!< Quantization range
+            glm::vec3 extent{ 0.0f };
+            uint32_t key_ofs = 0;       //!< First key in vec3_keys
+            uint32_t nbr_keys = 0;
+        };
+
+        struct QuatTrack
+        {
+            uint32_t key_ofs = 0;       //!< First key in quat_keys
+            uint32_t nbr_keys = 0;
+        };
+
+        struct Channel
+        {
+            Vec3Track pos;
+            QuatTrack rot;
+            Vec3Track scale;
+        };
+
+        std::vector<Channel> m_channels;
+        std::vector<uint16_t> m_vec3_frames;    // Key index of each key in m_vec3_keys
+        std::vector<QuantizedVec3> m_vec3_keys;
+        std::vector<uint16_t> m_quat_frames;    // Key index of each key in m_quat_keys
+        std::vector<QuantizedQuat> m_quat_keys;
+
+    public:
+        /// Number of cursors a pose needs to sample this clip
+        static constexpr size_t CursorsPerChannel = 3;
+
+        /// @brief Prepare for channels of a clip
+        /// @param nbr_channels Number of channels that will be added
+        /// @param nbr_keys Number of uniform keys per channel (at most 65536)
+        void init(size_t nbr_channels, size_t nbr_keys);
+
+        /// @brief Compress and add keys of the next channel
+        /// Keys are uniformly spaced and there are as many as passed to init().
+        void addChannel(
+            const glm::vec3* pos_keys,
+            const glm::quat* rot_keys,
+            const glm::vec3* scale_keys,
+            size_t nbr_keys,
+            const AnimationCompression& settings);
+
+        /// @brief Release unused capacity after all channels are added
+        void shrink();
+
+        /// @brief Sample a channel
+        /// @param channel_index Channel to sample
+        /// @param key_pos Fractional key index, key0 + frac
+        /// @param cursors Cursors of this clip, nbrCursors() in total
+        void sample(
+            size_t channel_index,
+            float key_pos,
+            uint16_t* cursors,
+            glm::vec3& pos,
+            glm::quat& rot,
+            glm::vec3& scale) const;
+
+        /// @brief Zero x and z of all translation keys of a channel
+        void flattenTranslation(size_t channel_index);
+
+        size_t nbrChannels() const { return m_channels.size(); }
+
+        size_t nbrCursors() const { return m_channels.size() * CursorsPerChannel; }
+
+        size_t nbrKeys() const { return m_vec3_keys.size() + m_quat_keys.size(); }
+
+        /// Heap and member bytes held by the clip
+        size_t byteSize() const;
+
+    private:
+        void addVec3Track(
+            Vec3Track& track,
+            const glm::vec3* keys,
+            size_t nbr_keys,
+            float tolerance);
+
+        void addQuatTrack(
+            QuatTrack& track,
+            const glm::quat* keys,
+            size_t nbr_keys,
+            float tolerance);
+    };
+
+} // namespace eeng
+
+#endif /* AnimationCompression_hpp */
@@ -0,0 +1,80 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include "AnimationLod.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include "config.h"
+
+namespace eeng
+{
+    size_t AnimationLodPolicy::selectLevel(float screen_size) const
+    {
+        EENG_ASSERT(levels.size(), "Empty LOD policy");
+        for (size_t i = 0; i < levels.size(); i++)
+            if (screen_size >= levels[i].min_screen_size)
+                return i;
+        return levels.size() - 1;
+    }
+
+    float projected_screen_size(
+        const AABB& world_aabb,
+        const glm::vec3& camera_pos,
+        float fov_y)
+    {
+        const glm::vec4 bs = world_aabb.getBoundingSphere();
+        const float dist = glm::length(glm::vec3(bs) - camera_pos);
+        if (dist <= bs.w)
+            return 1.0f;
+
+        // Diameter over the height of the view frustum at the sphere's distance
+        return bs.w / (dist * std::tan(fov_y * 0.5f));
+    }
+
+    bool lod_begin_frame(
+        AnimationLod& lod,
+        const AnimationLodPolicy& policy,
+        AnimationPose& pose)
+    {
+        const size_t level = policy.selectLevel(lod.screen_size);
+        const auto& lod_level = policy.levels[level];
+        pose.lod_min_reach = lod_level.min_node_reach;
+
+        // Evaluate on level changes, and every update_interval frames
+        const bool evaluate =
+            level != lod.level ||
+            lod.frame + 1 >= lod_level.update_interval;
+        lod.level = level;
+        lod.frame = (evaluate ? 0 : lod.frame + 1);
+        return evaluate;
+    }
+
+    void lod_end_frame(
+        AnimationLod& lod,
+        const AnimationLodPolicy& policy,
+        AnimationPose& pose,
+        bool evaluated)
+    {
+        const int update_interval = policy.levels[lod.level].update_interval;
+        if (update_interval <= 1)
+        {
+            // Full rate, the evaluated palette is used as is
+            lod.to_palette.clear();
+            return;
+        }
+
+        if (evaluated)
+        {
+            if (lod.to_palette.size() != pose.nbr_bones())
+                lod.to_palette = pose.bone_matrices;
+            std::swap(lod.from_palette, lod.to_palette);
+            lod.to_palette = pose.bone_matrices;
+        }
+
+        const float t = float(lod.frame) / update_interval;
+        for (size_t i = 0; i < pose.nbr_bones(); i++)
+            for (int r = 0; r < 3; r++)
+                pose.bone_matrices[i].rows[r] = glm::mix(lod.from_palette[i].rows[r], lod.to_palette[i].rows[r], t);
+    }
+
+} // namespace eeng
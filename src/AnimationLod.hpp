@@ -0,0 +1,76 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef AnimationLod_hpp
+#define AnimationLod_hpp
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "AABB.h"
+#include "AnimationPose.hpp"
+
+namespace eeng
+{
+    /// @brief Animation detail used for instances above a given projected size
+    struct AnimationLodLevel
+    {
+        float min_screen_size;      //!< Smallest projected size for this level, as a fraction of viewport height
+        int update_interval;        //!< Frames per pose evaluation. Palettes are interpolated in between.
+        float min_node_reach;       //!< Nodes with a reach below this fraction of model size are not evaluated
+    };
+
+    /// @brief Levels of animation detail, ordered from most to least detailed
+    /// Node reach is the bind-pose distance from a node to its farthest descendant,
+    /// so leaves and short chains, such as fingers and face bones, are dropped first.
+    struct AnimationLodPolicy
+    {
+        std::vector<AnimationLodLevel> levels{
+            { 0.25f, 1, 0.0f },
+            { 0.10f, 2, 0.02f },
+            { 0.04f, 4, 0.05f },
+            { 0.0f, 8, 0.1f } };
+
+        /// @brief Index of the level used for a projected size
+        size_t selectLevel(float screen_size) const;
+    };
+
+    /// @brief Animation LOD state of an instance
+    struct AnimationLod
+    {
+        float screen_size = 1.0f;           //!< Projected size, update per frame with projected_screen_size()
+        size_t level = 0;                   //!< Current level
+        int frame = 0;                      //!< Frames since the pose was evaluated
+        std::vector<Affine> from_palette;   //!< Palettes interpolated between evaluations
+        std::vector<Affine> to_palette;
+    };
+
+    /// @brief Projected size of a bounding volume, as a fraction of viewport height
+    /// @param world_aabb AABB in world space
+    /// @param camera_pos Camera position in world space
+    /// @param fov_y Vertical field of view, in radians
+    float projected_screen_size(
+        const AABB& world_aabb,
+        const glm::vec3& camera_pos,
+        float fov_y);
+
+    /// @brief Select level and decide if the pose should be evaluated this frame
+    /// Sets the node reach threshold of the pose for the level.
+    /// @return True if the pose should be evaluated before calling lod_end_frame()
+    bool lod_begin_frame(
+        AnimationLod& lod,
+        const AnimationLodPolicy& policy,
+        AnimationPose& pose);
+
+    /// @brief Write the palette to use this frame to the pose
+    /// At reduced update rates the palette lags one evaluation behind and
+    /// is interpolated between the two latest evaluations.
+    /// @param evaluated True if the pose was evaluated this frame
+    void lod_end_frame(
+        AnimationLod& lod,
+        const AnimationLodPolicy& policy,
+        AnimationPose& pose,
+        bool evaluated);
+
+} // namespace eeng
+
+#endif /* AnimationLod_hpp */
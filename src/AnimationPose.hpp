@@ -0,0 +1,77 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef AnimationPose_hpp
+#define AnimationPose_hpp
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "AABB.h"
+#include "Affine.hpp"
+
+namespace eeng
+{
+    /// @brief Per-instance animation state of a RenderableMesh
+    /// A pose holds everything an animate() call produces, which lets any
+    /// number of instances share one loaded (and unmodified) mesh.
+    /// Created and sized by RenderableMesh::createPose().
+    struct AnimationPose
+    {
+        std::vector<Affine> local_tfms;         //!< Per-node transforms relative parent
+        std::vector<Affine> global_tfms;        //!< Per-node transforms relative model
+        std::vector<Affine> bone_matrices;      //!< Skinning palette, global * inverse bind
+
+        // Bounding volumes
+        std::vector<AABB> bone_aabbs;           //!< Per-bone pose AABB's, used for visualization
+        std::vector<AABB> mesh_aabbs;           //!< Per-mesh pose AABB's, used for visualization
+        AABB model_aabb;                        //!< AABB for the entire model in this pose
+
+        /// Update bone_aabbs and mesh_aabbs when animated. If false, only
+        /// model_aabb is updated, and the per-part AABB's keep their values.
+        bool part_aabbs = true;
+
+        /// @brief Sampling state for a compressed clip
+        struct KeyCursors
+        {
+            int clip_index = -1;                //!< Clip the cursors refer to
+            std::vector<uint16_t> keys;         //!< Last key visited, per track
+        };
+        KeyCursors key_cursors[2];              //!< One per clip of a blend
+
+        /// Nodes with a reach (see AnimationLodPolicy) below this fraction of
+        /// the model size keep their previous local transform. Set by animation LOD.
+        float lod_min_reach = 0.0f;
+
+        /// @brief Number of nodes this pose is sized for
+        size_t nbr_nodes() const { return global_tfms.size(); }
+
+        /// @brief Number of bones this pose is sized for
+        size_t nbr_bones() const { return bone_matrices.size(); }
+    };
+
+    /// @brief Local node transforms as separate translations, rotations and scales
+    /// Used for blending, where poses are combined per TRS component before
+    /// they are composed into affine transforms with RenderableMesh::applyLocalPose().
+    struct LocalPose
+    {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::quat> rotations;
+        std::vector<glm::vec3> scales;
+        std::vector<float> weights;             //!< Accumulated blend weight per node, scratch for blending
+
+        void resize(size_t nbr_nodes)
+        {
+            positions.resize(nbr_nodes);
+            rotations.resize(nbr_nodes);
+            scales.resize(nbr_nodes);
+            weights.resize(nbr_nodes);
+        }
+
+        size_t nbr_nodes() const { return positions.size(); }
+    };
+
+} // namespace eeng
+
+#endif /* AnimationPose_hpp */
@@ -0,0 +1,97 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <filesystem>
+#include "ClipLibrary.hpp"
+#include "hash_combine.h"
+
+namespace eeng
+{
+    bool ClipLibrary::Key::operator==(const Key& other) const
+    {
+        return file == other.file &&
+            skeleton_signature == other.skeleton_signature &&
+            sample_rate == other.sample_rate &&
+            compressed == other.compressed &&
+            tolerances[0] == other.tolerances[0] &&
+            tolerances[1] == other.tolerances[1] &&
+            tolerances[2] == other.tolerances[2];
+    }
+
+    size_t ClipLibrary::KeyHash::operator()(const Key& key) const
+    {
+        return hash_combine(key.file, key.skeleton_signature, key.sample_rate, key.compressed);
+    }
+
+    ClipLibrary::Key ClipLibrary::makeKey(
+        const std::string& file,
+        size_t skeleton_signature,
+        float sample_rate,
+        const AnimationCompression& compression)
+    {
+        // Tolerances only matter for compressed clips
+        Key key{
+            std::filesystem::path(file).lexically_normal().generic_string(),
+            skeleton_signature,
+            sample_rate,
+            compression.enabled,
+            { 0.0f, 0.0f, 0.0f } };
+        if (compression.enabled)
+        {
+            key.tolerances[0] = compression.translation_tolerance;
+            key.tolerances[1] = compression.rotation_tolerance;
+            key.tolerances[2] = compression.scale_tolerance;
+        }
+        return key;
+    }
+
+    const ClipLibrary::ClipList* ClipLibrary::find(
+        const std::string& file,
+        size_t skeleton_signature,
+        float sample_rate,
+        const AnimationCompression& compression) const
+    {
+        const auto key = makeKey(file, skeleton_signature, sample_rate, compression);
+        std::lock_guard lock(m_mutex);
+        const auto it = m_files.find(key);
+        return it != m_files.end() ? &it->second : nullptr;
+    }
+
+    void ClipLibrary::insert(
+        const std::string& file,
+        size_t skeleton_signature,
+        float sample_rate,
+        const AnimationCompression& compression,
+        ClipList clips)
+    {
+        // The first clips inserted are kept, since meshes may be reading them
+        auto key = makeKey(file, skeleton_signature, sample_rate, compression);
+        std::lock_guard lock(m_mutex);
+        m_files.try_emplace(std::move(key), std::move(clips));
+    }
+
+    size_t ClipLibrary::nbrClips() const
+    {
+        std::lock_guard lock(m_mutex);
+        size_t count = 0;
+        for (const auto& [key, clips] : m_files)
+            count += clips.size();
+        return count;
+    }
+
+    void ClipLibrary::clear()
+    {
+        std::lock_guard lock(m_mutex);
+        m_files.clear();
+    }
+
+    size_t ClipLibrary::byteSize() const
+    {
+        std::lock_guard lock(m_mutex);
+        size_t bytes = sizeof(ClipLibrary);
+        for (const auto& [key, clips] : m_files)
+            for (const auto& clip : clips)
+                bytes += clip->byteSize();
+        return bytes;
+    }
+
+} // namespace eeng
@@ -0,0 +1,87 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef ClipLibrary_hpp
+#define ClipLibrary_hpp
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "RenderableMesh.hpp"
+
+namespace eeng
+{
+    /// @brief Animation clips shared by meshes with the same skeleton
+    /// Clips are stored once per file, skeleton signature (see
+    /// RenderableMesh::getSkeletonSignature()) and load settings (sample
+    /// rate and compression). A mesh that loads a file already in the
+    /// library reuses its keys, without importing the file, and only adds a
+    /// table that maps its nodes to the channels of each clip.
+    /// Since keys are shared, RenderableMesh::removeTranslationKeys() affects
+    /// all meshes that share a clip.
+    /// Meshes may load on different threads (see MeshLoader), so clips of a
+    /// file may be imported twice if loaded at the same time. The clips
+    /// inserted first are kept.
+    class ClipLibrary
+    {
+    public:
+        using ClipData = RenderableMesh::ClipData;
+        using ClipList = std::vector<std::shared_ptr<ClipData>>;
+
+        /// @brief Clips of a file, or nullptr if not in the library
+        const ClipList* find(
+            const std::string& file,
+            size_t skeleton_signature,
+            float sample_rate,
+            const AnimationCompression& compression) const;
+
+        /// @brief Add the clips of a file
+        void insert(
+            const std::string& file,
+            size_t skeleton_signature,
+            float sample_rate,
+            const AnimationCompression& compression,
+            ClipList clips);
+
+        /// @brief Number of clips in the library
+        size_t nbrClips() const;
+
+        /// @brief Bytes held by the clips in the library
+        size_t byteSize() const;
+
+        /// @brief Remove all clips. Clips used by meshes are kept alive by them.
+        /// Must not be called while meshes are loading.
+        void clear();
+
+    private:
+        struct Key
+        {
+            std::string file;
+            size_t skeleton_signature;
+            float sample_rate;
+            bool compressed;
+            float tolerances[3];
+
+            bool operator==(const Key& other) const;
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const;
+        };
+
+        static Key makeKey(
+            const std::string& file,
+            size_t skeleton_signature,
+            float sample_rate,
+            const AnimationCompression& compression);
+
+        std::unordered_map<Key, ClipList, KeyHash> m_files;
+        mutable std::mutex m_mutex;
+    };
+
+} // namespace eeng
+
+#endif /* ClipLibrary_hpp */
@@ -0,0 +1,307 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include "ClipStreamer.hpp"
+
+namespace eeng
+{
+    namespace
+    {
+        // Cooked clip file:
+        //      header      magic, version, name, duration in ticks, ticks per second, channel names
+        //      fallback    keys section, may have zero samples
+        //      full        keys section
+        // Keys section: sample rate, samples per channel, then the floats of a KeyPool,
+        // with channels stored one after another.
+        constexpr char ClipFileMagic[4] = { 'E', 'E', 'C', 'L' };
+        constexpr uint32_t ClipFileVersion = 1;
+
+        template<class T>
+        void write_value(std::ofstream& out, const T& value)
+        {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void write_string(std::ofstream& out, const std::string& str)
+        {
+            write_value(out, (uint32_t)str.size());
+            out.write(str.data(), str.size());
+        }
+
+        template<class T>
+        T read_value(std::ifstream& in)
+        {
+            T value{};
+            in.read(reinterpret_cast<char*>(&value), sizeof(T));
+            return value;
+        }
+
+        std::string read_string(std::ifstream& in)
+        {
+            std::string str(read_value<uint32_t>(in), '\0');
+            in.read(str.data(), str.size());
+            return str;
+        }
+
+        void write_keys(
+            std::ofstream& out,
+            float sample_rate,
+            size_t nbr_samples,
+            const std::vector<float>& data)
+        {
+            write_value(out, sample_rate);
+            write_value(out, (uint32_t)nbr_samples);
+            out.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(float));
+        }
+    }
+
+    ClipStreamer::ClipStreamer(size_t budget_bytes)
+        : m_budget(budget_bytes)
+    {
+        m_loader = std::thread(&ClipStreamer::loaderLoop, this);
+    }
+
+    ClipStreamer::~ClipStreamer()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_loader.join();
+    }
+
+    void ClipStreamer::cook(const ClipData& clip, const std::string& file, float fallback_rate)
+    {
+        EENG_ASSERT(!clip.is_compressed, "Compressed clip '{0}' cannot be cooked", clip.name);
+        EENG_ASSERT(clip.hasKeys(), "Clip '{0}' has no keys to cook", clip.name);
+
+        std::ofstream out(file, std::ios::binary);
+        if (!out)
+            throw std::runtime_error("Cannot open " + file + " for writing");
+
+        out.write(ClipFileMagic, sizeof(ClipFileMagic));
+        write_value(out, ClipFileVersion);
+        write_string(out, clip.name);
+        write_value(out, clip.duration_ticks);
+        write_value(out, clip.tps);
+        write_value(out, (uint32_t)clip.channel_names.size());
+        for (const auto& channel_name : clip.channel_names)
+            write_string(out, channel_name);
+
+        // Fallback keys, only if at a lower rate than the clip
+        const float duration_sec = clip.duration_ticks / clip.tps;
+        const size_t nbr_fallback = (fallback_rate > 0.0f ?
+            std::max<size_t>(2, (size_t)std::ceil(duration_sec * fallback_rate) + 1) :
+            0);
+        if (nbr_fallback && nbr_fallback < clip.nbr_samples)
+        {
+            // Channels one after another, as for full-rate keys
+            KeyPool keys;
+            keys.resize(clip.channels.size() * nbr_fallback);
+            for (size_t s = 0; s < nbr_fallback; s++)
+            {
+                const auto sample = clip.sampleAt(s / float(nbr_fallback - 1));
+                for (size_t c = 0; c < clip.channels.size(); c++)
+                {
+                    const size_t k0 = clip.channels[c].key_ofs + sample.key0;
+                    const size_t k1 = clip.channels[c].key_ofs + sample.key1;
+                    const size_t k = c * nbr_fallback + s;
+                    keys.positions()[k] = glm::mix(clip.keys.positions()[k0], clip.keys.positions()[k1], sample.frac);
+                    keys.rotations()[k] = glm::slerp(clip.keys.rotations()[k0], clip.keys.rotations()[k1], sample.frac);
+                    keys.scales()[k] = glm::mix(clip.keys.scales()[k0], clip.keys.scales()[k1], sample.frac);
+                }
+            }
+            write_keys(out, (duration_sec > 0.0f ? (nbr_fallback - 1) / duration_sec : fallback_rate), nbr_fallback, keys.data);
+        }
+        else
+            write_keys(out, 0.0f, 0, {});
+
+        write_keys(out, clip.sample_rate, clip.nbr_samples, clip.keys.data);
+        if (!out)
+            throw std::runtime_error("Failed to write " + file);
+    }
+
+    std::shared_ptr<ClipStreamer::ClipData> ClipStreamer::read(const std::string& file, bool full)
+    {
+        std::ifstream in(file, std::ios::binary);
+        if (!in)
+            throw std::runtime_error("Cannot open " + file);
+
+        char magic[sizeof(ClipFileMagic)];
+        in.read(magic, sizeof(magic));
+        if (!in || std::memcmp(magic, ClipFileMagic, sizeof(magic)) || read_value<uint32_t>(in) != ClipFileVersion)
+            throw std::runtime_error(file + " is not a cooked clip file of version " + std::to_string(ClipFileVersion));
+
+        auto clip = std::make_shared<ClipData>();
+        clip->name = read_string(in);
+        clip->duration_ticks = read_value<float>(in);
+        clip->tps = read_value<float>(in);
+        clip->channel_names.resize(read_value<uint32_t>(in));
+        for (auto& channel_name : clip->channel_names)
+            channel_name = read_string(in);
+
+        // Skip fallback keys when reading full-rate keys
+        const size_t nbr_channels = clip->channel_names.size();
+        for (int section = 0; section < (full ? 2 : 1); section++)
+        {
+            clip->sample_rate = read_value<float>(in);
+            clip->nbr_samples = read_value<uint32_t>(in);
+            const size_t nbr_keys = nbr_channels * clip->nbr_samples;
+            if (full && !section)
+                in.seekg(nbr_keys * 10 * sizeof(float), std::ios::cur);
+            else
+            {
+                clip->keys.resize(nbr_keys);
+                in.read(reinterpret_cast<char*>(clip->keys.data.data()), clip->keys.data.size() * sizeof(float));
+            }
+        }
+        if (!in)
+            throw std::runtime_error(file + " is truncated");
+
+        // Channels are stored one after another
+        if (clip->nbr_samples)
+        {
+            clip->channels.resize(nbr_channels);
+            for (size_t c = 0; c < nbr_channels; c++)
+                clip->channels[c] = { uint32_t(c * clip->nbr_samples), (uint32_t)clip->nbr_samples };
+        }
+        else
+            clip->keys = {};
+        return clip;
+    }
+
+    const StreamedClip* ClipStreamer::registerClip(const std::string& file)
+    {
+        const auto key = std::filesystem::path(file).lexically_normal().generic_string();
+        if (auto it = m_clip_indices.find(key); it != m_clip_indices.end())
+            return &m_clips[it->second];
+
+        auto fallback = read(file, false);
+        auto& clip = m_clips.emplace_back();
+        clip.file = file;
+        clip.fallback = std::move(fallback);
+        clip.current = clip.fallback.get();
+        m_clip_indices[key] = m_clips.size() - 1;
+        return &clip;
+    }
+
+    void ClipStreamer::update()
+    {
+        m_frame++;
+
+        // Install completed loads
+        std::vector<LoadResult> loaded;
+        {
+            std::lock_guard lock(m_mutex);
+            loaded.swap(m_loaded);
+        }
+        for (auto& result : loaded)
+        {
+            auto& clip = m_clips[result.clip_index];
+            clip.loading = false;
+            if (!result.clip)
+            {
+                clip.error = result.error;
+                continue;
+            }
+            clip.resident = std::move(result.clip);
+            clip.current = clip.resident.get();
+            m_resident_bytes += clip.resident->byteSize();
+        }
+
+        // Start loads of clips played since the last update
+        std::vector<std::pair<size_t, std::string>> loads;
+        for (size_t i = 0; i < m_clips.size(); i++)
+        {
+            auto& clip = m_clips[i];
+            if (!clip.requested.exchange(false, std::memory_order_relaxed))
+                continue;
+            clip.last_used = m_frame;
+            if (!clip.resident && !clip.loading && clip.error.empty())
+            {
+                clip.loading = true;
+                loads.emplace_back(i, clip.file);
+            }
+        }
+        if (loads.size())
+        {
+            {
+                std::lock_guard lock(m_mutex);
+                m_pending.insert(m_pending.end(), loads.begin(), loads.end());
+            }
+            m_cv.notify_one();
+        }
+
+        // Evict least recently played clips
+        while (m_resident_bytes > m_budget)
+        {
+            StreamedClip* lru = nullptr;
+            for (auto& clip : m_clips)
+                if (clip.resident && clip.last_used < m_frame && (!lru || clip.last_used < lru->last_used))
+                    lru = &clip;
+            if (!lru)
+                break;
+
+            m_resident_bytes -= lru->resident->byteSize();
+            lru->current = lru->fallback.get();
+            lru->resident.reset();
+        }
+    }
+
+    void ClipStreamer::flush()
+    {
+        {
+            std::unique_lock lock(m_mutex);
+            m_done_cv.wait(lock, [&] { return m_pending.empty() && !m_nbr_in_flight; });
+        }
+        update();
+    }
+
+    size_t ClipStreamer::nbrResident() const
+    {
+        return std::count_if(m_clips.begin(), m_clips.end(), [](const StreamedClip& clip) { return clip.resident != nullptr; });
+    }
+
+    size_t ClipStreamer::nbrLoading() const
+    {
+        return std::count_if(m_clips.begin(), m_clips.end(), [](const StreamedClip& clip) { return clip.loading; });
+    }
+
+    void ClipStreamer::loaderLoop()
+    {
+        std::unique_lock lock(m_mutex);
+        for (;;)
+        {
+            m_cv.wait(lock, [&] { return m_stop || m_pending.size(); });
+            if (m_stop)
+                return;
+
+            auto [clip_index, file] = std::move(m_pending.front());
+            m_pending.pop_front();
+            m_nbr_in_flight++;
+            lock.unlock();
+
+            LoadResult result{ clip_index };
+            try
+            {
+                result.clip = read(file, true);
+            }
+            catch (const std::exception& e)
+            {
+                result.error = e.what();
+            }
+
+            lock.lock();
+            m_loaded.push_back(std::move(result));
+            m_nbr_in_flight--;
+            m_done_cv.notify_all();
+        }
+    }
+
+} // namespace eeng
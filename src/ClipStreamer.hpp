@@ -0,0 +1,131 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef ClipStreamer_hpp
+#define ClipStreamer_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "RenderableMesh.hpp"
+
+namespace eeng
+{
+    /// @brief A clip in a ClipStreamer, as played by meshes
+    /// Keys are read through current, which is only changed by ClipStreamer::update().
+    struct StreamedClip
+    {
+        using ClipData = RenderableMesh::ClipData;
+
+        std::string file;
+        std::shared_ptr<ClipData> fallback;     //!< Clip info and low-rate keys, if cooked with any
+        std::shared_ptr<ClipData> resident;     //!< Full-rate keys, or nullptr if not loaded
+        const ClipData* current = nullptr;      //!< resident if loaded, otherwise fallback
+        mutable std::atomic<bool> requested{ false };   //!< Set when played, cleared by update()
+        bool loading = false;
+        std::string error;                      //!< Set if loading failed, the clip is then not retried
+        uint64_t last_used = 0;                 //!< Last update() the clip was played before
+    };
+
+    /// @brief Loads animation clips from cooked clip files on demand
+    /// A registered clip only keeps its info and optional low-rate fallback
+    /// keys in memory. Full-rate keys are loaded on a background thread the
+    /// first time the clip is played, and played from the next update()
+    /// after the load completes. Until then the fallback keys are played, or
+    /// the bind pose if the clip was cooked without them.
+    /// Clips not played for the longest time are evicted when resident keys
+    /// exceed the memory budget. Clips played since the last update() are
+    /// never evicted, so the budget may be exceeded for a while.
+    class ClipStreamer
+    {
+    public:
+        using ClipData = RenderableMesh::ClipData;
+        using KeyPool = RenderableMesh::KeyPool;
+
+        /// @brief Start the loader thread
+        /// @param budget_bytes Largest size of resident full-rate keys
+        explicit ClipStreamer(size_t budget_bytes = 64u << 20);
+
+        /// @brief Stop the loader thread. Meshes that play streamed clips must be destroyed first.
+        ~ClipStreamer();
+
+        ClipStreamer(const ClipStreamer&) = delete;
+        ClipStreamer& operator=(const ClipStreamer&) = delete;
+
+        /// @brief Write a clip to a cooked clip file
+        /// Clips must not be compressed. Clip-specific edits such as
+        /// RenderableMesh::removeTranslationKeys() should be made before cooking.
+        /// @param clip Clip to cook
+        /// @param file File to write
+        /// @param fallback_rate Rate of the fallback keys in samples per second, or 0 for none
+        static void cook(const ClipData& clip, const std::string& file, float fallback_rate);
+
+        /// @brief Read a cooked clip file
+        /// @param file File to read
+        /// @param full True for full-rate keys, false for fallback keys
+        /// @return Clip with keys, or only clip info if the file has no fallback keys
+        static std::shared_ptr<ClipData> read(const std::string& file, bool full);
+
+        /// @brief Add a cooked clip, or find it if already added
+        /// Reads clip info and fallback keys, and throws std::runtime_error if the file is invalid.
+        /// @return Clip that lives as long as the streamer
+        const StreamedClip* registerClip(const std::string& file);
+
+        /// @brief Install loaded clips, start loads of played clips and evict unused clips
+        /// Call once per frame, when no poses are evaluated from streamed clips.
+        void update();
+
+        /// @brief Block until all started loads are complete, then update()
+        void flush();
+
+        void setBudget(size_t budget_bytes) { m_budget = budget_bytes; }
+
+        size_t getBudget() const { return m_budget; }
+
+        /// @brief Bytes held by resident full-rate keys
+        size_t residentBytes() const { return m_resident_bytes; }
+
+        size_t nbrClips() const { return m_clips.size(); }
+
+        size_t nbrResident() const;
+
+        /// @brief Number of loads started and not yet installed by update()
+        size_t nbrLoading() const;
+
+    private:
+        void loaderLoop();
+
+        /// Clip index and loaded keys, or an error message if loading failed
+        struct LoadResult
+        {
+            size_t clip_index;
+            std::shared_ptr<ClipData> clip;
+            std::string error;
+        };
+
+        std::deque<StreamedClip> m_clips;       // Deque, so clips stay in place
+        std::unordered_map<std::string, size_t> m_clip_indices;
+        size_t m_budget;
+        size_t m_resident_bytes = 0;
+        uint64_t m_frame = 0;
+
+        std::thread m_loader;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;           // Signals new loads or stop
+        std::condition_variable m_done_cv;      // Signals completed loads
+        std::deque<std::pair<size_t, std::string>> m_pending;
+        std::vector<LoadResult> m_loaded;
+        size_t m_nbr_in_flight = 0;             // Loads taken by the loader thread
+        bool m_stop = false;
+    };
+
+} // namespace eeng
+
+#endif /* ClipStreamer_hpp */
@@ -0,0 +1,251 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include "CpuSkinning.hpp"
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#define EENG_SKINNING_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EENG_SKINNING_SSE
+#include <emmintrin.h>
+#endif
+
+namespace eeng
+{
+    namespace
+    {
+        /// Vertices with a lower total weight use bone 0, as in the vertex shader
+        constexpr float MinTotalWeight = 0.01f;
+
+#ifndef EENG_SKINNING_SSE
+        /// Weighted sum of the palette transforms of a vertex
+        inline Affine blend_palette(const Affine* palette, const SkinInfluences& influences, size_t v)
+        {
+            const uint32_t* idx = influences.indices + v * influences.stride;
+            const float* w = influences.weights + v * influences.stride;
+            if (w[0] + w[1] + w[2] + w[3] < MinTotalWeight)
+                return palette[0];
+
+            Affine M;
+            for (int r = 0; r < 3; r++)
+                M.rows[r] =
+                    palette[idx[0]].rows[r] * w[0] +
+                    palette[idx[1]].rows[r] * w[1] +
+                    palette[idx[2]].rows[r] * w[2] +
+                    palette[idx[3]].rows[r] * w[3];
+            return M;
+        }
+#endif
+
+#ifdef EENG_SKINNING_SSE
+        /// Load 3 floats without reading past them
+        inline __m128 load3(const float* p)
+        {
+            return _mm_movelh_ps(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p))), _mm_load_ss(p + 2));
+        }
+
+        /// Rows r0, r1, r2 dotted with v, in the first three lanes
+        inline glm::vec3 transform_rows(__m128 r0, __m128 r1, __m128 r2, __m128 v)
+        {
+            __m128 a = _mm_mul_ps(r0, v), b = _mm_mul_ps(r1, v), c = _mm_mul_ps(r2, v), d = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(a, b, c, d);
+            alignas(16) float t[4];
+            _mm_store_ps(t, _mm_add_ps(_mm_add_ps(a, b), _mm_add_ps(c, d)));
+            return { t[0], t[1], t[2] };
+        }
+
+        /// One vertex, with the palette rows blended four elements at a time
+        inline void skin_vertex_sse(
+            const Affine* palette,
+            const SkinInfluences& influences,
+            const glm::vec3* positions,
+            const glm::vec3* normals,
+            size_t v,
+            glm::vec3* out_positions,
+            glm::vec3* out_normals)
+        {
+            const uint32_t* idx = influences.indices + v * influences.stride;
+            const float* w = influences.weights + v * influences.stride;
+
+            __m128 r0, r1, r2;
+            if (w[0] + w[1] + w[2] + w[3] < MinTotalWeight)
+            {
+                const float* m = &palette[0].rows[0].x;
+                r0 = _mm_loadu_ps(m);
+                r1 = _mm_loadu_ps(m + 4);
+                r2 = _mm_loadu_ps(m + 8);
+            }
+            else
+            {
+                r0 = r1 = r2 = _mm_setzero_ps();
+                for (int k = 0; k < 4; k++)
+                {
+                    const __m128 wk = _mm_set1_ps(w[k]);
+                    const float* m = &palette[idx[k]].rows[0].x;
+                    r0 = _mm_add_ps(r0, _mm_mul_ps(_mm_loadu_ps(m), wk));
+                    r1 = _mm_add_ps(r1, _mm_mul_ps(_mm_loadu_ps(m + 4), wk));
+                    r2 = _mm_add_ps(r2, _mm_mul_ps(_mm_loadu_ps(m + 8), wk));
+                }
+            }
+
+            const __m128 p = _mm_add_ps(load3(&positions[v].x), _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f));
+            out_positions[v] = transform_rows(r0, r1, r2, p);
+            if (normals)
+                out_normals[v] = glm::normalize(transform_rows(r0, r1, r2, load3(&normals[v].x)));
+        }
+#endif
+
+#ifdef EENG_SKINNING_AVX2
+        inline __m256 madd(__m256 a, __m256 b, __m256 c)
+        {
+#ifdef __FMA__
+            return _mm256_fmadd_ps(a, b, c);
+#else
+            return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+        }
+
+        /// Eight vertices, one per lane, with influences, palette rows and attributes gathered
+        inline void skin8_avx2(
+            const Affine* palette,
+            const SkinInfluences& influences,
+            const glm::vec3* positions,
+            const glm::vec3* normals,
+            size_t v0,
+            glm::vec3* out_positions,
+            glm::vec3* out_normals)
+        {
+            const __m256i vtx = _mm256_add_epi32(_mm256_set1_epi32((int)v0), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+            const __m256i skin_ofs = _mm256_mullo_epi32(vtx, _mm256_set1_epi32((int)influences.stride));
+
+            __m256i bone[4];
+            __m256 w[4];
+            for (int k = 0; k < 4; k++)
+            {
+                const __m256i ofs = _mm256_add_epi32(skin_ofs, _mm256_set1_epi32(k));
+                bone[k] = _mm256_i32gather_epi32(reinterpret_cast<const int*>(influences.indices), ofs, 4);
+                w[k] = _mm256_i32gather_ps(influences.weights, ofs, 4);
+            }
+
+            // Lanes without weights use bone 0
+            const __m256 sum = _mm256_add_ps(_mm256_add_ps(w[0], w[1]), _mm256_add_ps(w[2], w[3]));
+            const __m256 fallback = _mm256_cmp_ps(sum, _mm256_set1_ps(MinTotalWeight), _CMP_LT_OQ);
+            w[0] = _mm256_blendv_ps(w[0], _mm256_set1_ps(1.0f), fallback);
+            for (int k = 1; k < 4; k++)
+                w[k] = _mm256_andnot_ps(fallback, w[k]);
+            bone[0] = _mm256_andnot_si256(_mm256_castps_si256(fallback), bone[0]);
+
+            // Blend the 12 palette elements, skipping influences unused by all lanes
+            const float* pal = &palette[0].rows[0].x;
+            __m256 m[12];
+            for (int e = 0; e < 12; e++)
+                m[e] = _mm256_setzero_ps();
+            for (int k = 0; k < 4; k++)
+            {
+                if (!_mm256_movemask_ps(_mm256_cmp_ps(w[k], _mm256_setzero_ps(), _CMP_NEQ_OQ)))
+                    continue;
+                const __m256i ofs = _mm256_mullo_epi32(bone[k], _mm256_set1_epi32(12));
+                for (int e = 0; e < 12; e++)
+                    m[e] = madd(_mm256_i32gather_ps(pal, _mm256_add_epi32(ofs, _mm256_set1_epi32(e)), 4), w[k], m[e]);
+            }
+
+            const __m256i attr_ofs = _mm256_mullo_epi32(vtx, _mm256_set1_epi32(3));
+            alignas(32) float x[8], y[8], z[8];
+            {
+                const float* pos = &positions[0].x;
+                const __m256 px = _mm256_i32gather_ps(pos, attr_ofs, 4);
+                const __m256 py = _mm256_i32gather_ps(pos, _mm256_add_epi32(attr_ofs, _mm256_set1_epi32(1)), 4);
+                const __m256 pz = _mm256_i32gather_ps(pos, _mm256_add_epi32(attr_ofs, _mm256_set1_epi32(2)), 4);
+                _mm256_store_ps(x, madd(m[0], px, madd(m[1], py, madd(m[2], pz, m[3]))));
+                _mm256_store_ps(y, madd(m[4], px, madd(m[5], py, madd(m[6], pz, m[7]))));
+                _mm256_store_ps(z, madd(m[8], px, madd(m[9], py, madd(m[10], pz, m[11]))));
+                for (int i = 0; i < 8; i++)
+                    out_positions[v0 + i] = { x[i], y[i], z[i] };
+            }
+            if (normals)
+            {
+                const float* nrm = &normals[0].x;
+                const __m256 nx = _mm256_i32gather_ps(nrm, attr_ofs, 4);
+                const __m256 ny = _mm256_i32gather_ps(nrm, _mm256_add_epi32(attr_ofs, _mm256_set1_epi32(1)), 4);
+                const __m256 nz = _mm256_i32gather_ps(nrm, _mm256_add_epi32(attr_ofs, _mm256_set1_epi32(2)), 4);
+                const __m256 tx = madd(m[0], nx, madd(m[1], ny, _mm256_mul_ps(m[2], nz)));
+                const __m256 ty = madd(m[4], nx, madd(m[5], ny, _mm256_mul_ps(m[6], nz)));
+                const __m256 tz = madd(m[8], nx, madd(m[9], ny, _mm256_mul_ps(m[10], nz)));
+                const __m256 inv_len = _mm256_div_ps(_mm256_set1_ps(1.0f),
+                    _mm256_sqrt_ps(madd(tx, tx, madd(ty, ty, _mm256_mul_ps(tz, tz)))));
+                _mm256_store_ps(x, _mm256_mul_ps(tx, inv_len));
+                _mm256_store_ps(y, _mm256_mul_ps(ty, inv_len));
+                _mm256_store_ps(z, _mm256_mul_ps(tz, inv_len));
+                for (int i = 0; i < 8; i++)
+                    out_normals[v0 + i] = { x[i], y[i], z[i] };
+            }
+        }
+#endif
+    }
+
+    const char* cpu_skinning_isa()
+    {
+#if defined(EENG_SKINNING_AVX2)
+        return "AVX2";
+#elif defined(EENG_SKINNING_SSE)
+        return "SSE";
+#else
+        return "scalar";
+#endif
+    }
+
+    size_t cpu_skinning_width()
+    {
+#ifdef EENG_SKINNING_AVX2
+        return 8;
+#else
+        return 1;
+#endif
+    }
+
+    void skin_vertices(
+        const Affine* palette,
+        const SkinInfluences& influences,
+        const glm::vec3* positions,
+        const glm::vec3* normals,
+        size_t count,
+        glm::vec3* out_positions,
+        glm::vec3* out_normals)
+    {
+        size_t v = 0;
+#ifdef EENG_SKINNING_AVX2
+        for (; v + 8 <= count; v += 8)
+            skin8_avx2(palette, influences, positions, normals, v, out_positions, out_normals);
+#endif
+        for (; v < count; v++)
+        {
+#ifdef EENG_SKINNING_SSE
+            skin_vertex_sse(palette, influences, positions, normals, v, out_positions, out_normals);
+#else
+            const Affine M = blend_palette(palette, influences, v);
+            out_positions[v] = M.transformPoint(positions[v]);
+            if (normals)
+                out_normals[v] = glm::normalize(M.transformVector(normals[v]));
+#endif
+        }
+    }
+
+    void transform_vertices(
+        const Affine& M,
+        const glm::vec3* positions,
+        const glm::vec3* normals,
+        size_t count,
+        glm::vec3* out_positions,
+        glm::vec3* out_normals)
+    {
+        for (size_t v = 0; v < count; v++)
+            out_positions[v] = M.transformPoint(positions[v]);
+        if (normals)
+            for (size_t v = 0; v < count; v++)
+                out_normals[v] = glm::normalize(M.transformVector(normals[v]));
+    }
+
+} // namespace eeng
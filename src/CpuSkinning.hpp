@@ -0,0 +1,60 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef CpuSkinning_hpp
+#define CpuSkinning_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Affine.hpp"
+
+namespace eeng
+{
+    /// @brief Bone indices and weights of a range of vertices, four influences each
+    /// Influences of vertex i start at indices[i * stride] and weights[i * stride],
+    /// so interleaved layouts such as RenderableMesh::SkinData can be read in place.
+    struct SkinInfluences
+    {
+        const uint32_t* indices = nullptr;
+        const float* weights = nullptr;
+        size_t stride = 4;      //!< Distance between vertices, in 32-bit elements
+    };
+
+    /// @brief Name of the instruction set used by skin_vertices(): "AVX2", "SSE" or "scalar"
+    const char* cpu_skinning_isa();
+
+    /// @brief Number of vertices skinned at once by skin_vertices()
+    size_t cpu_skinning_width();
+
+    /// @brief Skin vertices with a palette, as the vertex shader does
+    /// Vertices with a total weight below 0.01 are transformed by bone 0.
+    /// Normals are transformed by the blended linear part and normalized.
+    /// @param palette Skinning palette, see AnimationPose::bone_matrices
+    /// @param influences Bone indices and weights per vertex
+    /// @param positions Bind positions
+    /// @param normals Bind normals, or nullptr to skip normals
+    /// @param count Number of vertices
+    /// @param out_positions Skinned positions
+    /// @param out_normals Skinned normals. Not written if normals is nullptr.
+    void skin_vertices(
+        const Affine* palette,
+        const SkinInfluences& influences,
+        const glm::vec3* positions,
+        const glm::vec3* normals,
+        size_t count,
+        glm::vec3* out_positions,
+        glm::vec3* out_normals);
+
+    /// @brief Transform vertices of a rigid (non-skinned) mesh by one transform
+    /// Parameters are as for skin_vertices().
+    void transform_vertices(
+        const Affine& M,
+        const glm::vec3* positions,
+        const glm::vec3* normals,
+        size_t count,
+        glm::vec3* out_positions,
+        glm::vec3* out_normals);
+
+} // namespace eeng
+
+#endif /* CpuSkinning_hpp */
@@ -13,6 +13,7 @@
 
 #include "InputManager.hpp"
 #include "Log.hpp"
+#include "PoseCache.hpp"
 
 #include "imgui.h"
 #include "imgui_impl_sdl2.h"
@@ -359,6 +360,16 @@ namespace eeng {
             // }
         }
 
+        if (ImGui::CollapsingHeader("Animation", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            // Shared poses, summed over all pose caches
+            const auto counters = pose_cache_totals();
+            ImGui::Text("Pose cache: %llu hits, %llu misses (%.1f%% hit rate)",
+                (unsigned long long)counters.hits,
+                (unsigned long long)counters.misses,
+                100.0f * counters.hitRate());
+        }
+
         if (ImGui::CollapsingHeader("Controllers", ImGuiTreeNodeFlags_DefaultOpen))
         {
             ImGui::Text("Controllers connected: %i", input->GetConnectedControllerCount());
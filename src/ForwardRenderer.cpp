@@ -1,6 +1,7 @@
 // Created by Carl Johan Gribel.
 // Licensed under the MIT License. See LICENSE file for details.
 
+#include <cstddef>
 #include <fstream>
 #include <string>
 #include <sstream>
@@ -23,6 +24,13 @@ namespace
         buffer << file.rdbuf();
         return buffer.str();
     }
+
+    /// Source with a define inserted after the #version line
+    std::string with_define(const std::string &source, const std::string &define)
+    {
+        const size_t line_end = (source.rfind("#version", 0) == 0 ? source.find('\n') + 1 : 0);
+        return source.substr(0, line_end) + "#define " + define + "\n" + source.substr(line_end);
+    }
 }
 
 namespace eeng
@@ -33,9 +41,27 @@ namespace eeng
 
     ForwardRenderer::~ForwardRenderer()
     {
-        EENG_ASSERT(phongShader, "Destrying uninitialized shader program");
-        if (phongShader)
-            glDeleteProgram(phongShader);
+        EENG_ASSERT(phongShaders[Skin4], "Destrying uninitialized shader program");
+        for (auto shader : phongShaders)
+            if (shader)
+                glDeleteProgram(shader);
+
+        for (auto &baked : bakedPalettes)
+        {
+            glDeleteTextures(1, &baked.texture);
+            glDeleteBuffers(1, &baked.buffer);
+        }
+        for (auto &instance : skinnedInstances)
+        {
+            glDeleteVertexArrays(1, &instance.vao);
+            glDeleteBuffers((GLsizei)numelem(instance.buffers), instance.buffers);
+        }
+        if (preSkinShader)
+            glDeleteProgram(preSkinShader);
+        if (instanceTexture)
+            glDeleteTextures(1, &instanceTexture);
+        if (instanceBuffer)
+            glDeleteBuffers(1, &instanceBuffer);
     }
 
     void ForwardRenderer::init(const std::string &vertShaderPath,
@@ -46,15 +72,22 @@ namespace eeng
                  fragShaderPath.c_str());
         auto vertSource = file_to_string(vertShaderPath);
         auto fragSource = file_to_string(fragShaderPath);
-        phongShader = createShaderProgram(vertSource.c_str(), fragSource.c_str());
-
-        // Bind shader samplers to texture units
-        glUseProgram(phongShader);
-        for (auto &textureDesc : texturesDescs)
+        for (int variant = 0; variant < SkinVariantCount; variant++)
         {
-            glUniform1i(glGetUniformLocation(phongShader, textureDesc.samplerName), textureDesc.textureUnit);
+            const auto variantSource = with_define(vertSource, "SKIN_INFLUENCES " + std::to_string(SkinVariantInfluences[variant]));
+            phongShader = phongShaders[variant] = createShaderProgram(variantSource.c_str(), fragSource.c_str());
+
+            // Bind shader samplers to texture units
+            glUseProgram(phongShader);
+            for (auto &textureDesc : texturesDescs)
+            {
+                glUniform1i(glGetUniformLocation(phongShader, textureDesc.samplerName), textureDesc.textureUnit);
+            }
+            glUniform1i(glGetUniformLocation(phongShader, "BakedPalettes"), BakedPaletteTextureUnit);
+            glUniform1i(glGetUniformLocation(phongShader, "InstanceData"), InstanceDataTextureUnit);
         }
         glUseProgram(0);
+        phongShader = 0;
         CheckAndThrowGLErrors();
 
         // placeholder_texture = create_checker_texture();
@@ -66,7 +99,7 @@ namespace eeng
                                     const glm::vec3 &lightColor,
                                     const glm::vec3 &eyePos)
     {
-        EENG_ASSERT(phongShader, "Renderer not initialized");
+        EENG_ASSERT(phongShaders[Skin4], "Renderer not initialized");
 
         // GL state
 
@@ -102,16 +135,17 @@ namespace eeng
         //     glEnable(GL_CULL_FACE);
         // }
 
-        glUseProgram(phongShader);
-
-        // Bind matrices
+        // Bind matrices, light & eye position for all skinning variants
         const auto ProjViewMatrix = ProjMatrix * ViewMatrix;
-        glUniformMatrix4fv(glGetUniformLocation(phongShader, "ProjViewMatrix"), 1, 0, glm::value_ptr(ProjViewMatrix));
+        for (int variant = SkinVariantCount - 1; variant >= 0; variant--)
+        {
+            useSkinVariant((SkinVariant)variant);
+            glUniformMatrix4fv(glGetUniformLocation(phongShader, "ProjViewMatrix"), 1, 0, glm::value_ptr(ProjViewMatrix));
 
-        // Bind light & eye position
-        glUniform3fv(glGetUniformLocation(phongShader, "lightpos"), 1, glm::value_ptr(lightPos));
-        glUniform3fv(glGetUniformLocation(phongShader, "lightColor"), 1, glm::value_ptr(lightColor));
-        glUniform3fv(glGetUniformLocation(phongShader, "eyepos"), 1, glm::value_ptr(eyePos));
+            glUniform3fv(glGetUniformLocation(phongShader, "lightpos"), 1, glm::value_ptr(lightPos));
+            glUniform3fv(glGetUniformLocation(phongShader, "lightColor"), 1, glm::value_ptr(lightColor));
+            glUniform3fv(glGetUniformLocation(phongShader, "eyepos"), 1, glm::value_ptr(eyePos));
+        }
 
         // Bind cube map texture
         GLuint cubemapTextureHandle = 0; // <- PLACEHOLDER
@@ -131,6 +165,7 @@ namespace eeng
     int ForwardRenderer::endPass()
     {
         glUseProgram(0);
+        phongShader = 0;
         glBindVertexArray(0);
 
         // Possibly restore GL state
@@ -141,12 +176,18 @@ namespace eeng
     void ForwardRenderer::renderMesh(const std::shared_ptr<RenderableMesh> mesh,
                                      const glm::mat4 &WorldMatrix)
     {
-        // Bind bone matrices
-        if (mesh->boneMatrices.size())
-            glUniformMatrix4fv(glGetUniformLocation(phongShader, "BoneMatrices"),
-                               (GLsizei)mesh->boneMatrices.size(),
-                               0,
-                               glm::value_ptr(mesh->boneMatrices[0]));
+        renderMesh(mesh, mesh->m_pose, WorldMatrix);
+    }
+
+    void ForwardRenderer::renderMesh(const std::shared_ptr<RenderableMesh> mesh,
+                                     const AnimationPose &pose,
+                                     const glm::mat4 &WorldMatrix)
+    {
+        EENG_ASSERT(pose.nbr_nodes() == mesh->m_nodetree.size(), "Pose does not match mesh");
+        EENG_ASSERT(pose.nbr_bones() <= MaxBones, "Too many bones ({0}), max is {1}", pose.nbr_bones(), MaxBones);
+
+        // Bone matrices are bound, as 3x4 affine rows, to each skinning variant the mesh uses
+        bool bonesBound[SkinVariantCount]{ false };
 
         glBindVertexArray(mesh->m_VAO);
 
@@ -155,66 +196,366 @@ namespace eeng
             const auto &submesh = mesh->m_meshes[i];
             const auto &mtl = mesh->m_materials[submesh.mtl_index];
 
-            if (submesh.node_index != EENG_NULL_INDEX && !submesh.is_skinned)
-            {
-                // Append hierarchical transform to non-skinned meshes that are linked to nodes
-                const auto WorldMeshMatrix = WorldMatrix * mesh->m_nodetree.get_payload_at(submesh.node_index).global_tfm;
-                glUniformMatrix4fv(glGetUniformLocation(phongShader, "WorldMatrix"), 1, 0, glm::value_ptr(WorldMeshMatrix));
-            }
-            else
-                glUniformMatrix4fv(glGetUniformLocation(phongShader, "WorldMatrix"), 1, 0, glm::value_ptr(WorldMatrix));
+            // Append hierarchical transform to non-skinned meshes that are linked to nodes
+            const auto WorldMeshMatrix = (submesh.node_index != EENG_NULL_INDEX && !submesh.is_skinned)
+                                             ? WorldMatrix * pose.global_tfms[submesh.node_index].toMat4()
+                                             : WorldMatrix;
 
             // (Could do view frustum culling (VFC) here using the projection matrix)
             // (Mesh traversal)
             // if (submesh.is_skinned)
-            //     submesh.aabb = meshres.src_mesh->m_model_aabb;
+            //     submesh.aabb = pose.model_aabb;
             // else
-            //     submesh.aabb = meshres.src_mesh->m_mesh_aabbs_pose[i];
+            //     submesh.aabb = pose.mesh_aabbs[i];
             // (VFC)
             // v4f bs = aabb.post_transform(tfm).get_boundingsphere();
 
-            // Color components
-            glUniform3fv(glGetUniformLocation(phongShader, "Ka"), 1, glm::value_ptr(mtl.Ka));
-            glUniform3fv(glGetUniformLocation(phongShader, "Kd"), 1, glm::value_ptr(mtl.Kd));
-            glUniform3fv(glGetUniformLocation(phongShader, "Ks"), 1, glm::value_ptr(mtl.Ks));
-            glUniform1f(glGetUniformLocation(phongShader, "shininess"), mtl.shininess);
-
-            // Bind textures and texture flags
-            for (auto &textureDesc : texturesDescs)
+            // One draw per range of triangles with the same skinning variant
+            for (int variant = 0; variant < SkinVariantCount; variant++)
             {
-                // if (texture.textureTypeIndex == TextureTypeIndex::Cubemap) continue;
-                const int textureIndex = mtl.textureIndices[textureDesc.textureTypeIndex];
-                const bool hasTexture = (textureIndex != NoTexture);
-                if (hasTexture)
+                const auto &range = submesh.skin_ranges[variant];
+                if (!range.nbr_indices)
+                    continue;
+
+                useSkinVariant((SkinVariant)variant);
+                if (!bonesBound[variant])
                 {
-                    glActiveTexture(GL_TEXTURE0 + textureDesc.textureUnit);
-                    glBindTexture(GL_TEXTURE_2D, mesh->m_textures[textureIndex].getHandle());
+                    if (pose.bone_matrices.size())
+                        glUniformMatrix3x4fv(glGetUniformLocation(phongShader, "BoneMatrices"),
+                                             (GLsizei)pose.bone_matrices.size(),
+                                             0,
+                                             glm::value_ptr(pose.bone_matrices[0].rows[0]));
+                    glUniform1i(glGetUniformLocation(phongShader, "u_is_baked"), 0);
+                    bonesBound[variant] = true;
                 }
-                glUniform1i(glGetUniformLocation(phongShader, textureDesc.flagName), hasTexture);
+                glUniformMatrix4fv(glGetUniformLocation(phongShader, "WorldMatrix"), 1, 0, glm::value_ptr(WorldMeshMatrix));
+
+                bindMaterial(*mesh, mtl);
+
+                // Skinned flag
+                glUniform1i(glGetUniformLocation(phongShader, "u_is_skinned"), (int)submesh.is_skinned);
+
+                // Render
+                glDrawElementsBaseVertex(GL_TRIANGLES,
+                                         range.nbr_indices,
+                                         mesh->m_index_type,
+                                         (GLvoid *)mesh->indexOffset(range.base_index),
+                                         submesh.base_vertex);
+                drawcallCounter++;
+
+                unbindTextures();
+                CheckAndThrowGLErrors();
             }
+        }
+
+        glBindVertexArray(0);
+        useSkinVariant(Skin4);
+    }
+
+    int ForwardRenderer::uploadBakedAnimation(const BakedAnimation &baked)
+    {
+        EENG_ASSERT(baked.palettes.size(), "No baked palettes to upload");
+
+        // Three RGBA32F texels, the affine rows, per bone and frame
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        EENG_ASSERT(baked.palettes.size() * 3 <= (size_t)maxTexels,
+                    "Baked palettes too large for a buffer texture ({0} texels, max is {1})", baked.palettes.size() * 3, maxTexels);
+
+        BakedPaletteTexture bakedTexture;
+        bakedTexture.nbr_bones = (int)baked.nbr_bones;
+        glGenBuffers(1, &bakedTexture.buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, bakedTexture.buffer);
+        glBufferData(GL_TEXTURE_BUFFER, baked.palettes.size() * sizeof(Affine), baked.palettes.data(), GL_STATIC_DRAW);
+        glGenTextures(1, &bakedTexture.texture);
+        glBindTexture(GL_TEXTURE_BUFFER, bakedTexture.texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, bakedTexture.buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        CheckAndThrowGLErrors();
+
+        bakedPalettes.push_back(bakedTexture);
+        return (int)bakedPalettes.size() - 1;
+    }
+
+    void ForwardRenderer::renderMeshBaked(const std::shared_ptr<RenderableMesh> mesh,
+                                          int bakedId,
+                                          std::span<const BakedInstance> instances)
+    {
+        EENG_ASSERT(bakedId >= 0 && bakedId < (int)bakedPalettes.size(), "{0} is not an uploaded baked animation", bakedId);
+        const auto &bakedTexture = bakedPalettes[bakedId];
+        EENG_ASSERT(bakedTexture.nbr_bones == (int)mesh->m_bones.size(), "Baked palettes do not match mesh");
+        if (instances.empty())
+            return;
+
+        // Stream instance data, as three world matrix rows and the frame
+        instanceData.resize(instances.size() * 4);
+        for (size_t i = 0; i < instances.size(); i++)
+        {
+            const Affine world(instances[i].WorldMatrix);
+            instanceData[4 * i + 0] = world.rows[0];
+            instanceData[4 * i + 1] = world.rows[1];
+            instanceData[4 * i + 2] = world.rows[2];
+            instanceData[4 * i + 3] = glm::vec4((float)instances[i].frame, 0.0f, 0.0f, 0.0f);
+        }
+        if (!instanceBuffer)
+        {
+            glGenBuffers(1, &instanceBuffer);
+            glGenTextures(1, &instanceTexture);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, instanceBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, instanceData.size() * sizeof(glm::vec4), instanceData.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        glActiveTexture(GL_TEXTURE0 + BakedPaletteTextureUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, bakedTexture.texture);
+        glActiveTexture(GL_TEXTURE0 + InstanceDataTextureUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instanceBuffer);
+        useSkinVariant(Skin4);
+        glUniform1i(glGetUniformLocation(phongShader, "NbrBakedBones"), bakedTexture.nbr_bones);
+        glUniform1i(glGetUniformLocation(phongShader, "u_is_baked"), 1);
+
+        glBindVertexArray(mesh->m_VAO);
+
+        for (uint i = 0; i < mesh->m_meshes.size(); i++)
+        {
+            const auto &submesh = mesh->m_meshes[i];
+            const auto &mtl = mesh->m_materials[submesh.mtl_index];
+
+            // Instance transforms are applied in the shader, so only the bind transform of linked nodes is set here
+            glm::mat4 MeshMatrix(1.0f);
+            if (submesh.node_index != EENG_NULL_INDEX && !submesh.is_skinned)
+                MeshMatrix = mesh->m_pose.global_tfms[submesh.node_index].toMat4();
+            glUniformMatrix4fv(glGetUniformLocation(phongShader, "WorldMatrix"), 1, 0, glm::value_ptr(MeshMatrix));
 
-            // Skinned flag
+            bindMaterial(*mesh, mtl);
             glUniform1i(glGetUniformLocation(phongShader, "u_is_skinned"), (int)submesh.is_skinned);
 
-            // Render
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES,
+                                              submesh.nbr_indices,
+                                              mesh->m_index_type,
+                                              (GLvoid *)mesh->indexOffset(submesh.base_index),
+                                              (GLsizei)instances.size(),
+                                              submesh.base_vertex);
+            drawcallCounter++;
+
+            unbindTextures();
+            CheckAndThrowGLErrors();
+        }
+
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0 + BakedPaletteTextureUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glActiveTexture(GL_TEXTURE0 + InstanceDataTextureUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glUniform1i(glGetUniformLocation(phongShader, "u_is_baked"), 0);
+    }
+
+    void ForwardRenderer::initPreSkinning(const std::string &vertShaderPath)
+    {
+        Log("Compiling shader %s", vertShaderPath.c_str());
+        const auto vertSource = file_to_string(vertShaderPath);
+        const char *varyings[] = {"skinned_Position", "skinned_Normal", "skinned_Tangent"};
+        preSkinShader = createFeedbackShaderProgram(vertSource.c_str(), varyings, (GLsizei)numelem(varyings));
+        CheckAndThrowGLErrors();
+    }
+
+    int ForwardRenderer::createSkinnedInstance(const std::shared_ptr<RenderableMesh> mesh)
+    {
+        EENG_ASSERT(mesh && mesh->m_VAO, "Mesh has no GL buffers");
+        EENG_ASSERT(preSkinShader, "Pre-skinning not initialized");
+
+        SkinnedInstance instance;
+        instance.mesh = mesh;
+        for (const auto &submesh : mesh->m_meshes)
+            instance.nbr_vertices = std::max(instance.nbr_vertices, submesh.base_vertex + submesh.nbr_vertices);
+
+        const GLuint locations[] = {0, 2, 3};
+        glGenVertexArrays(1, &instance.vao);
+        glBindVertexArray(instance.vao);
+        glGenBuffers((GLsizei)numelem(instance.buffers), instance.buffers);
+        for (int i = 0; i < numelem(instance.buffers); i++)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, instance.buffers[i]);
+            glBufferData(GL_ARRAY_BUFFER, instance.nbr_vertices * SkinnedComponents[i] * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+            glEnableVertexAttribArray(locations[i]);
+            glVertexAttribPointer(locations[i], SkinnedComponents[i], GL_FLOAT, GL_FALSE, 0, 0);
+        }
+
+        // Texture coordinates and indices are shared with the mesh
+        using PackedVertex = RenderableMesh::PackedVertex;
+        glBindBuffer(GL_ARRAY_BUFFER, mesh->m_Buffers[RenderableMesh::VertexBuffer]);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (GLvoid *)offsetof(PackedVertex, texcoord));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->m_Buffers[RenderableMesh::IndexBuffer]);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // Buffers start out as the decoded bind pose attributes
+        glUseProgram(preSkinShader);
+        glUniformMatrix4fv(glGetUniformLocation(preSkinShader, "MeshMatrix"), 1, 0, glm::value_ptr(glm::mat4(1.0f)));
+        glUniform1i(glGetUniformLocation(preSkinShader, "u_is_skinned"), 0);
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(mesh->m_VAO);
+        feedbackVertices(instance, 0, instance.nbr_vertices);
+        glBindVertexArray(0);
+        glDisable(GL_RASTERIZER_DISCARD);
+        glUseProgram(phongShader);
+        CheckAndThrowGLErrors();
+
+        skinnedInstances.push_back(instance);
+        return (int)skinnedInstances.size() - 1;
+    }
+
+    void ForwardRenderer::preSkin(int instanceId,
+                                  const AnimationPose &pose)
+    {
+        EENG_ASSERT(preSkinShader, "Pre-skinning not initialized");
+        EENG_ASSERT(instanceId >= 0 && instanceId < (int)skinnedInstances.size(), "{0} is not a skinned instance", instanceId);
+        const auto &instance = skinnedInstances[instanceId];
+        const auto &mesh = *instance.mesh;
+        EENG_ASSERT(pose.nbr_nodes() == mesh.m_nodetree.size(), "Pose does not match mesh");
+        EENG_ASSERT(pose.nbr_bones() <= MaxBones, "Too many bones ({0}), max is {1}", pose.nbr_bones(), MaxBones);
+
+        glUseProgram(preSkinShader);
+        if (pose.bone_matrices.size())
+            glUniformMatrix3x4fv(glGetUniformLocation(preSkinShader, "BoneMatrices"),
+                                 (GLsizei)pose.bone_matrices.size(),
+                                 0,
+                                 glm::value_ptr(pose.bone_matrices[0].rows[0]));
+
+        // Vertices are processed as points, without rasterization
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(mesh.m_VAO);
+        for (const auto &submesh : mesh.m_meshes)
+        {
+            // Non-skinned meshes linked to nodes are placed by the pose
+            const glm::mat4 MeshMatrix = (submesh.node_index != EENG_NULL_INDEX && !submesh.is_skinned)
+                                             ? pose.global_tfms[submesh.node_index].toMat4()
+                                             : glm::mat4(1.0f);
+            glUniformMatrix4fv(glGetUniformLocation(preSkinShader, "MeshMatrix"), 1, 0, glm::value_ptr(MeshMatrix));
+            glUniform1i(glGetUniformLocation(preSkinShader, "u_is_skinned"), (int)submesh.is_skinned);
+
+            feedbackVertices(instance, submesh.base_vertex, submesh.nbr_vertices);
+        }
+        glBindVertexArray(0);
+        glDisable(GL_RASTERIZER_DISCARD);
+
+        // Restore the program of the pass, if any
+        glUseProgram(phongShader);
+        CheckAndThrowGLErrors();
+    }
+
+    void ForwardRenderer::preSkin(int instanceId,
+                                  std::span<const glm::vec3> positions,
+                                  std::span<const glm::vec3> normals)
+    {
+        EENG_ASSERT(instanceId >= 0 && instanceId < (int)skinnedInstances.size(), "{0} is not a skinned instance", instanceId);
+        const auto &instance = skinnedInstances[instanceId];
+        EENG_ASSERT(positions.size() >= instance.nbr_vertices && normals.size() >= instance.nbr_vertices,
+                    "Expected {0} skinned vertices", instance.nbr_vertices);
+
+        const GLsizeiptr size = instance.nbr_vertices * sizeof(glm::vec3);
+        static_assert(SkinnedComponents[0] == 3 && SkinnedComponents[1] == 3);
+        glBindBuffer(GL_ARRAY_BUFFER, instance.buffers[0]);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, positions.data());
+        glBindBuffer(GL_ARRAY_BUFFER, instance.buffers[1]);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, normals.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        CheckAndThrowGLErrors();
+    }
+
+    void ForwardRenderer::renderSkinnedInstance(int instanceId,
+                                                const glm::mat4 &WorldMatrix)
+    {
+        EENG_ASSERT(instanceId >= 0 && instanceId < (int)skinnedInstances.size(), "{0} is not a skinned instance", instanceId);
+        const auto &instance = skinnedInstances[instanceId];
+        auto &mesh = *instance.mesh;
+
+        // Vertices are already placed relative the model, so all submeshes are drawn as static
+        useSkinVariant(Skin1);
+        glUniform1i(glGetUniformLocation(phongShader, "u_is_baked"), 0);
+        glUniform1i(glGetUniformLocation(phongShader, "u_is_skinned"), 0);
+        glUniformMatrix4fv(glGetUniformLocation(phongShader, "WorldMatrix"), 1, 0, glm::value_ptr(WorldMatrix));
+
+        glBindVertexArray(instance.vao);
+        for (const auto &submesh : mesh.m_meshes)
+        {
+            bindMaterial(mesh, mesh.m_materials[submesh.mtl_index]);
+
             glDrawElementsBaseVertex(GL_TRIANGLES,
                                      submesh.nbr_indices,
-                                     GL_UNSIGNED_INT,
-                                     (GLvoid *)(sizeof(uint) * submesh.base_index),
+                                     mesh.m_index_type,
+                                     (GLvoid *)mesh.indexOffset(submesh.base_index),
                                      submesh.base_vertex);
             drawcallCounter++;
 
-            // Unbind textures
-            for (auto &texture : texturesDescs)
+            unbindTextures();
+            CheckAndThrowGLErrors();
+        }
+        glBindVertexArray(0);
+    }
+
+    void ForwardRenderer::feedbackVertices(const SkinnedInstance &instance,
+                                           unsigned baseVertex,
+                                           unsigned nbrVertices)
+    {
+        for (int i = 0; i < numelem(instance.buffers); i++)
+        {
+            const GLsizeiptr vertexSize = SkinnedComponents[i] * sizeof(float);
+            glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER,
+                              i,
+                              instance.buffers[i],
+                              baseVertex * vertexSize,
+                              nbrVertices * vertexSize);
+        }
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, baseVertex, nbrVertices);
+        glEndTransformFeedback();
+        for (int i = 0; i < numelem(instance.buffers); i++)
+            glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, i, 0);
+    }
+
+    void ForwardRenderer::bindMaterial(RenderableMesh &mesh,
+                                       const PhongMaterial &mtl)
+    {
+        // Color components
+        glUniform3fv(glGetUniformLocation(phongShader, "Ka"), 1, glm::value_ptr(mtl.Ka));
+        glUniform3fv(glGetUniformLocation(phongShader, "Kd"), 1, glm::value_ptr(mtl.Kd));
+        glUniform3fv(glGetUniformLocation(phongShader, "Ks"), 1, glm::value_ptr(mtl.Ks));
+        glUniform1f(glGetUniformLocation(phongShader, "shininess"), mtl.shininess);
+
+        // Bind textures and texture flags
+        for (auto &textureDesc : texturesDescs)
+        {
+            // if (texture.textureTypeIndex == TextureTypeIndex::Cubemap) continue;
+            const int textureIndex = mtl.textureIndices[textureDesc.textureTypeIndex];
+            const bool hasTexture = (textureIndex != NoTexture);
+            if (hasTexture)
             {
-                glActiveTexture(GL_TEXTURE0 + texture.textureUnit);
-                glBindTexture(GL_TEXTURE_2D, 0);
+                glActiveTexture(GL_TEXTURE0 + textureDesc.textureUnit);
+                glBindTexture(GL_TEXTURE_2D, mesh.m_textures[textureIndex].getHandle());
             }
-
-            CheckAndThrowGLErrors();
+            glUniform1i(glGetUniformLocation(phongShader, textureDesc.flagName), hasTexture);
         }
+    }
 
-        glBindVertexArray(0);
+    void ForwardRenderer::useSkinVariant(SkinVariant variant)
+    {
+        if (phongShader == phongShaders[variant])
+            return;
+        phongShader = phongShaders[variant];
+        glUseProgram(phongShader);
+    }
+
+    void ForwardRenderer::unbindTextures()
+    {
+        for (auto &texture : texturesDescs)
+        {
+            glActiveTexture(GL_TEXTURE0 + texture.textureUnit);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
     }
 
 } // namespace eeng
\ No newline at end of file
@@ -4,18 +4,60 @@
 #ifndef ForwardRenderer_hpp
 #define ForwardRenderer_hpp
 
+#include <span>
 #include <glm/glm.hpp>
 #include "glcommon.h"
 #include "RenderableMesh.hpp"
+#include "AnimationBake.hpp"
 
 namespace eeng
 {
+    /// Size of the skinning palette in the phong shader (phong_vert.glsl)
+    const int MaxBones = 170;
+
+    /// @brief Instance drawn with a baked palette, see ForwardRenderer::renderMeshBaked()
+    struct BakedInstance
+    {
+        glm::mat4 WorldMatrix;
+        uint32_t frame;             //!< Frame in the baked table, see BakedAnimation::frameAt()
+    };
+
     class ForwardRenderer
     {
-        GLuint phongShader = 0;
+        GLuint phongShaders[SkinVariantCount]{ 0 };  // Phong shader per skinning variant
+        GLuint phongShader = 0;                      // Program in use, one of phongShaders
         GLuint placeholder_texture = 0;
         int drawcallCounter;
 
+        /// Baked palettes in a buffer texture
+        struct BakedPaletteTexture
+        {
+            GLuint buffer = 0;
+            GLuint texture = 0;
+            int nbr_bones = 0;
+        };
+        std::vector<BakedPaletteTexture> bakedPalettes;
+
+        // Per-instance data of baked draws, streamed per call
+        GLuint instanceBuffer = 0;
+        GLuint instanceTexture = 0;
+        std::vector<glm::vec4> instanceData;
+
+        /// Skinned vertices of a mesh instance, drawn as static geometry
+        struct SkinnedInstance
+        {
+            std::shared_ptr<RenderableMesh> mesh;
+            GLuint vao = 0;
+            GLuint buffers[3]{ 0 };     // Positions, normals and tangents with binormal sign
+            unsigned nbr_vertices = 0;
+        };
+        static constexpr GLint SkinnedComponents[3] = { 3, 3, 4 };  // Floats per vertex of each buffer
+        std::vector<SkinnedInstance> skinnedInstances;
+        GLuint preSkinShader = 0;
+
+        const GLuint BakedPaletteTextureUnit = 5;
+        const GLuint InstanceDataTextureUnit = 6;
+
         struct TextureDesc
         {
             PhongMaterial::TextureTypeIndex textureTypeIndex;
@@ -68,11 +110,83 @@ namespace eeng
         /// @return Number of drawcalls made during pass
         int endPass();
 
-        /// @brief Render an instance of a mesh
+        /// @brief Render an instance of a mesh in the pose held by the mesh
         /// @param mesh Mesh to render
         /// @param WorldMatrix Instance world transform
         void renderMesh(const std::shared_ptr<RenderableMesh> mesh,
                         const glm::mat4 &WorldMatrix);
+
+        /// @brief Render an instance of a mesh in a given pose
+        /// @param mesh Mesh to render
+        /// @param pose Instance pose, evaluated from mesh
+        /// @param WorldMatrix Instance world transform
+        void renderMesh(const std::shared_ptr<RenderableMesh> mesh,
+                        const AnimationPose &pose,
+                        const glm::mat4 &WorldMatrix);
+
+        /// @brief Upload baked palettes for use with renderMeshBaked()
+        /// @param baked Palettes baked from a mesh
+        /// @return Identifier of the uploaded palettes, released with the renderer
+        int uploadBakedAnimation(const BakedAnimation &baked);
+
+        /// @brief Render instances of a mesh skinned by baked palettes, with one instanced draw call per submesh
+        /// No poses are evaluated, so the CPU cost per instance is only the instance data.
+        /// Non-skinned submeshes linked to nodes are placed by the bind pose.
+        /// @param mesh Mesh to render, the one the palettes were baked from
+        /// @param bakedId Palettes returned by uploadBakedAnimation()
+        /// @param instances World transform and baked frame per instance
+        void renderMeshBaked(const std::shared_ptr<RenderableMesh> mesh,
+                             int bakedId,
+                             std::span<const BakedInstance> instances);
+
+        /// @brief Initialize pre-skinning with transform feedback
+        /// @param vertShaderPath Pre-skinning shader (preskin_vert.glsl)
+        void initPreSkinning(const std::string &vertShaderPath);
+
+        /// @brief Create buffers for the skinned vertices of a mesh instance
+        /// Skinned vertices can be drawn by any number of passes or views
+        /// per frame, with skinning done once by preSkin().
+        /// @param mesh Mesh of the instance
+        /// @return Identifier of the instance, released with the renderer
+        int createSkinnedInstance(const std::shared_ptr<RenderableMesh> mesh);
+
+        /// @brief Skin the vertices of an instance with transform feedback
+        /// Call once per frame, before the instance is drawn by renderSkinnedInstance().
+        /// Requires initPreSkinning().
+        /// @param instanceId Instance returned by createSkinnedInstance()
+        /// @param pose Instance pose, evaluated from the mesh
+        void preSkin(int instanceId,
+                     const AnimationPose &pose);
+
+        /// @brief Upload vertices skinned on the CPU by RenderableMesh::skin()
+        /// Tangents keep their bind pose.
+        /// @param instanceId Instance returned by createSkinnedInstance()
+        /// @param positions Skinned positions of all vertices of the mesh
+        /// @param normals Skinned normals of all vertices of the mesh
+        void preSkin(int instanceId,
+                     std::span<const glm::vec3> positions,
+                     std::span<const glm::vec3> normals);
+
+        /// @brief Render an instance from its skinned vertices, as static geometry
+        /// @param instanceId Instance returned by createSkinnedInstance()
+        /// @param WorldMatrix Instance world transform
+        void renderSkinnedInstance(int instanceId,
+                                   const glm::mat4 &WorldMatrix);
+
+    private:
+        void bindMaterial(RenderableMesh &mesh,
+                          const PhongMaterial &mtl);
+
+        void unbindTextures();
+
+        /// Switch to the phong shader of a skinning variant
+        void useSkinVariant(SkinVariant variant);
+
+        /// Write a range of vertices of a mesh to the buffers of an instance, with the pre-skinning
+        /// shader and its uniforms in use and the mesh vertex array bound
+        void feedbackVertices(const SkinnedInstance &instance,
+                              unsigned baseVertex,
+                              unsigned nbrVertices);
     };
 
 using ForwardRendererPtr = std::shared_ptr<ForwardRenderer>;
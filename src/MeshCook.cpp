@@ -0,0 +1,129 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <stdexcept>
+#include "MeshCook.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace eeng
+{
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    bool MappedFile::open(const std::string& file)
+    {
+        close();
+#ifdef _WIN32
+        HANDLE handle = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(handle, &size) || !size.QuadPart)
+        {
+            CloseHandle(handle);
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!data)
+        {
+            if (mapping)
+                CloseHandle(mapping);
+            CloseHandle(handle);
+            return false;
+        }
+        m_file = handle;
+        m_mapping = mapping;
+        m_data = static_cast<const unsigned char*>(data);
+        m_size = (size_t)size.QuadPart;
+#else
+        const int fd = ::open(file.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) || !st.st_size)
+        {
+            ::close(fd);
+            return false;
+        }
+        // The mapping stays valid after the descriptor is closed
+        void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+            return false;
+        m_data = static_cast<const unsigned char*>(data);
+        m_size = (size_t)st.st_size;
+#endif
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if (!m_data)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+        m_mapping = m_file = nullptr;
+#else
+        munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    CookWriter::CookWriter(const std::string& file)
+        : m_out(file, std::ios::binary), m_file(file)
+    {
+        if (!m_out)
+            throw std::runtime_error("Cannot open " + file + " for writing");
+    }
+
+    void CookWriter::string(const std::string& str)
+    {
+        value((uint32_t)str.size());
+        m_out.write(str.data(), str.size());
+    }
+
+    void CookWriter::align()
+    {
+        static const char zeros[CookBlobAlignment]{};
+        const size_t ofs = (size_t)m_out.tellp();
+        m_out.write(zeros, (CookBlobAlignment - ofs % CookBlobAlignment) % CookBlobAlignment);
+    }
+
+    void CookWriter::finish()
+    {
+        m_out.flush();
+        if (!m_out)
+            throw std::runtime_error("Failed to write " + m_file);
+    }
+
+    std::string CookReader::string()
+    {
+        const size_t size = value<uint32_t>();
+        return std::string(reinterpret_cast<const char*>(take(size)), size);
+    }
+
+    const unsigned char* CookReader::take(size_t bytes)
+    {
+        if (m_ofs + bytes > m_size)
+            throw std::runtime_error(m_file + " is truncated");
+        const unsigned char* data = m_data + m_ofs;
+        m_ofs += bytes;
+        return data;
+    }
+
+} // namespace eeng
@@ -0,0 +1,131 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef MeshCook_hpp
+#define MeshCook_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace eeng
+{
+    /// Alignment of blobs in cooked files, relative the start of the file
+    constexpr size_t CookBlobAlignment = 16;
+
+    /// @brief A read-only memory mapping of a whole file
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /// @brief Map a file
+        /// @return False if the file cannot be opened or is empty
+        bool open(const std::string& file);
+
+        void close();
+
+        const unsigned char* data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+    private:
+        const unsigned char* m_data = nullptr;
+        size_t m_size = 0;
+#ifdef _WIN32
+        void* m_file = nullptr;
+        void* m_mapping = nullptr;
+#endif
+    };
+
+    /// @brief Writes values, strings and aligned blobs to a cooked file
+    class CookWriter
+    {
+    public:
+        explicit CookWriter(const std::string& file);
+
+        template<class T>
+        void value(const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            m_out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void string(const std::string& str);
+
+        /// @brief Element count, then the elements aligned to CookBlobAlignment
+        template<class T>
+        void blob(std::span<const T> elements)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            value((uint64_t)elements.size());
+            align();
+            m_out.write(reinterpret_cast<const char*>(elements.data()), elements.size_bytes());
+        }
+
+        template<class T>
+        void blob(const std::vector<T>& elements)
+        {
+            blob(std::span<const T>(elements));
+        }
+
+        /// @brief Throw if any write failed
+        void finish();
+
+    private:
+        void align();
+
+        std::ofstream m_out;
+        std::string m_file;
+    };
+
+    /// @brief Reads what a CookWriter wrote, from memory
+    /// Blobs are returned as views into the memory, without copying.
+    class CookReader
+    {
+    public:
+        CookReader(const unsigned char* data, size_t size, const std::string& file)
+            : m_data(data), m_size(size), m_file(file) {
+        }
+
+        template<class T>
+        T value()
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            T value;
+            std::memcpy(&value, take(sizeof(T)), sizeof(T));
+            return value;
+        }
+
+        std::string string();
+
+        template<class T>
+        std::span<const T> blob()
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            const size_t count = (size_t)value<uint64_t>();
+            m_ofs = (m_ofs + CookBlobAlignment - 1) / CookBlobAlignment * CookBlobAlignment;
+            const unsigned char* data = take(count * sizeof(T));
+            return { reinterpret_cast<const T*>(data), count };
+        }
+
+    private:
+        /// Advance past bytes, throws if the file is truncated
+        const unsigned char* take(size_t bytes);
+
+        const unsigned char* m_data;
+        size_t m_size;
+        size_t m_ofs = 0;
+        std::string m_file;
+    };
+
+} // namespace eeng
+
+#endif /* MeshCook_hpp */
@@ -0,0 +1,216 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <algorithm>
+#include "MeshLoader.hpp"
+
+namespace eeng
+{
+    namespace
+    {
+        float elapsed_ms(std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    MeshLoader::MeshLoader(unsigned nbr_threads, size_t upload_budget_bytes)
+        : m_upload_budget(upload_budget_bytes)
+    {
+        if (!nbr_threads)
+            nbr_threads = std::max(1u, std::thread::hardware_concurrency() - 1);
+        for (unsigned i = 0; i < nbr_threads; i++)
+            m_loaders.emplace_back(&MeshLoader::loaderLoop, this);
+    }
+
+    MeshLoader::~MeshLoader()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        for (auto& loader : m_loaders)
+            loader.join();
+    }
+
+    MeshLoadHandle MeshLoader::load(
+        std::shared_ptr<RenderableMesh> mesh,
+        const std::string& file,
+        std::vector<std::string> animation_files,
+        LoadedFunc on_loaded,
+        unsigned xiflags)
+    {
+        EENG_ASSERT(mesh, "No mesh to load {0} into", file);
+        EENG_ASSERT(xiflags & xi_load_meshes, "Loads of {0} must include meshes", file);
+
+        auto load = std::make_shared<MeshLoad>();
+        load->file = file;
+        load->start = std::chrono::steady_clock::now();
+
+        // Loads that only differ in mesh settings share the first mesh
+        if (m_cache && animation_files.empty() && !on_loaded)
+        {
+            std::erase_if(m_mesh_loads, [](const auto& entry) { return entry.second.expired(); });
+            auto cached = m_cache->insertMesh(file, xiflags, DefaultAiFlags, mesh);
+            if (cached != mesh)
+            {
+                if (auto shared_load = m_mesh_loads[cached.get()].lock())
+                    return shared_load;
+                // Loaded earlier and still in use
+                load->mesh = std::move(cached);
+                load->state = MeshLoadState::Ready;
+                load->loaded = true;
+                load->ready_ms = elapsed_ms(load->start);
+                m_mesh_loads[load->mesh.get()] = load;
+                return load;
+            }
+            m_mesh_loads[mesh.get()] = load;
+        }
+        if (m_cache)
+            mesh->setResourceCache(m_cache);
+
+        load->mesh = std::move(mesh);
+        m_nbr_loading++;
+        {
+            std::lock_guard lock(m_mutex);
+            m_pending.push_back({ load, std::move(animation_files), std::move(on_loaded), xiflags });
+        }
+        m_cv.notify_one();
+        return load;
+    }
+
+    void MeshLoader::update()
+    {
+        takeLoaded();
+
+        // Oldest loads first, so that each mesh becomes ready as early as possible
+        size_t budget = m_upload_budget;
+        m_uploaded_bytes = 0;
+        while (m_uploading.size() && budget)
+        {
+            auto& load = *m_uploading.front();
+            const size_t bytes = upload(load, budget);
+            m_uploaded_bytes += bytes;
+            budget -= std::min(bytes, budget);
+            if (!load.done())
+                break;
+            m_uploading.pop_front();
+        }
+    }
+
+    void MeshLoader::wait(const MeshLoadHandle& handle)
+    {
+        {
+            std::unique_lock lock(m_mutex);
+            m_done_cv.wait(lock, [&] { return handle->loaded; });
+        }
+        takeLoaded();
+
+        auto it = std::find(m_uploading.begin(), m_uploading.end(), handle);
+        if (it == m_uploading.end())
+            return;
+        upload(**it, SIZE_MAX);
+        m_uploading.erase(it);
+    }
+
+    void MeshLoader::flush()
+    {
+        {
+            std::unique_lock lock(m_mutex);
+            m_done_cv.wait(lock, [&] { return m_loaded.size() + m_uploading.size() == m_nbr_loading; });
+        }
+        takeLoaded();
+
+        for (auto& load : m_uploading)
+            upload(*load, SIZE_MAX);
+        m_uploading.clear();
+    }
+
+    void MeshLoader::takeLoaded()
+    {
+        std::vector<std::shared_ptr<MeshLoad>> loaded;
+        {
+            std::lock_guard lock(m_mutex);
+            loaded.swap(m_loaded);
+        }
+        for (auto& load : loaded)
+        {
+            if (load->error.size())
+            {
+                if (m_cache)
+                    m_cache->eraseMesh(load->mesh);
+                finish(*load, MeshLoadState::Failed);
+                continue;
+            }
+            load->state = MeshLoadState::Uploading;
+            m_uploading.push_back(std::move(load));
+        }
+    }
+
+    size_t MeshLoader::upload(MeshLoad& load, size_t budget_bytes)
+    {
+        size_t bytes = 0;
+        try
+        {
+            bytes = load.mesh->uploadPending(budget_bytes);
+        }
+        catch (const std::exception& e)
+        {
+            load.error = e.what();
+            finish(load, MeshLoadState::Failed);
+            return bytes;
+        }
+        if (!load.mesh->hasPendingUpload())
+            finish(load, MeshLoadState::Ready);
+        return bytes;
+    }
+
+    void MeshLoader::finish(MeshLoad& load, MeshLoadState state)
+    {
+        load.state = state;
+        load.ready_ms = elapsed_ms(load.start);
+        m_nbr_loading--;
+    }
+
+    void MeshLoader::loaderLoop()
+    {
+        std::unique_lock lock(m_mutex);
+        for (;;)
+        {
+            m_cv.wait(lock, [&] { return m_stop || m_pending.size(); });
+            if (m_stop)
+                return;
+
+            Request request = std::move(m_pending.front());
+            m_pending.pop_front();
+            lock.unlock();
+
+            auto& load = *request.load;
+            auto& mesh = *load.mesh;
+            const auto start = std::chrono::steady_clock::now();
+            try
+            {
+                mesh.load(load.file, request.xiflags | xi_defer_upload, DefaultAiFlags);
+                load.cooked = mesh.wasLoadedCooked();
+                for (const auto& file : request.animation_files)
+                {
+                    mesh.load(file, true);
+                    load.cooked = load.cooked && mesh.wasLoadedCooked();
+                }
+                if (request.on_loaded)
+                    request.on_loaded(mesh);
+            }
+            catch (const std::exception& e)
+            {
+                load.error = e.what();
+            }
+            load.load_ms = elapsed_ms(start);
+
+            lock.lock();
+            load.loaded = true;
+            m_loaded.push_back(std::move(request.load));
+            m_done_cv.notify_all();
+        }
+    }
+
+} // namespace eeng
@@ -0,0 +1,157 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef MeshLoader_hpp
+#define MeshLoader_hpp
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "RenderableMesh.hpp"
+#include "ResourceCache.hpp"
+
+namespace eeng
+{
+    enum class MeshLoadState
+    {
+        Loading,        //!< Importing or decoding on a loader thread
+        Uploading,      //!< Creating GL buffers and textures, a part per MeshLoader::update()
+        Ready,          //!< The mesh can be drawn
+        Failed          //!< See MeshLoad::error
+    };
+
+    /// @brief A load started by MeshLoader::load(), used like a future
+    /// The state is only changed by MeshLoader::update() and MeshLoader::wait().
+    /// The mesh must not be used before the state is Ready.
+    struct MeshLoad
+    {
+        std::shared_ptr<RenderableMesh> mesh;
+        std::string file;
+        MeshLoadState state = MeshLoadState::Loading;
+        std::string error;          //!< Set if the load failed
+        bool cooked = false;        //!< True if all files were read from cooked files
+        float load_ms = 0.0f;       //!< Time spent on the loader thread
+        float ready_ms = 0.0f;      //!< Time from the request until Ready
+
+        bool ready() const { return state == MeshLoadState::Ready; }
+        bool failed() const { return state == MeshLoadState::Failed; }
+        bool done() const { return ready() || failed(); }
+
+    private:
+        friend class MeshLoader;
+        std::chrono::steady_clock::time_point start;
+        bool loaded = false;        // Set by the loader thread, under the loader mutex
+    };
+
+    using MeshLoadHandle = std::shared_ptr<const MeshLoad>;
+
+    /// @brief Loads meshes on background threads
+    /// Import and texture decoding run on loader threads, with meshes loaded
+    /// using xi_defer_upload. GL buffers and textures are then created on the
+    /// thread that calls update(), within a budget of bytes per call, so that
+    /// a large mesh is spread over several frames.
+    /// Meshes that share a ClipLibrary can be loaded at the same time.
+    /// With a ResourceCache, repeated loads of a file return the load, or the
+    /// cached mesh, of the first, and textures are shared between meshes.
+    class MeshLoader
+    {
+    public:
+        /// Called on the loader thread once all files of a load are read, e.g. to edit clips
+        using LoadedFunc = std::function<void(RenderableMesh& mesh)>;
+
+        /// @brief Start the loader threads
+        /// @param nbr_threads Loader threads, or 0 for one less than the hardware threads
+        /// @param upload_budget_bytes Bytes uploaded per update()
+        explicit MeshLoader(unsigned nbr_threads = 0, size_t upload_budget_bytes = 8u << 20);
+
+        /// @brief Stop the loader threads. Loads not yet started are dropped.
+        ~MeshLoader();
+
+        MeshLoader(const MeshLoader&) = delete;
+        MeshLoader& operator=(const MeshLoader&) = delete;
+
+        /// @brief Queue a load
+        /// If a cache is set and the load has no animation files or callback, a mesh
+        /// of the same file that is cached or loading is used instead (see MeshLoad::mesh).
+        /// @param mesh Mesh to load into, which is not used by the caller until the load is Ready
+        /// @param file Mesh file
+        /// @param animation_files Files to append animations from, in order
+        /// @param on_loaded Called on the loader thread after all files are read, or empty
+        /// @param xiflags Flags of the mesh file, see RenderableMesh::load()
+        /// @return Handle of the load
+        MeshLoadHandle load(
+            std::shared_ptr<RenderableMesh> mesh,
+            const std::string& file,
+            std::vector<std::string> animation_files = {},
+            LoadedFunc on_loaded = {},
+            unsigned xiflags = xi_load_meshes | xi_load_animations);
+
+        /// @brief Upload loaded meshes within the budget, and mark them Ready
+        /// Call once per frame, on the GL thread.
+        void update();
+
+        /// @brief Block until a load is read, then upload all of it. Call on the GL thread.
+        void wait(const MeshLoadHandle& handle);
+
+        /// @brief Block until all loads are read, then upload all of them. Call on the GL thread.
+        void flush();
+
+        /// @brief Set a cache to share meshes and textures through. Only affects later loads.
+        void setResourceCache(ResourceCache* cache) { m_cache = cache; }
+
+        void setUploadBudget(size_t budget_bytes) { m_upload_budget = budget_bytes; }
+
+        size_t getUploadBudget() const { return m_upload_budget; }
+
+        /// @brief Bytes uploaded by the last update()
+        size_t uploadedBytes() const { return m_uploaded_bytes; }
+
+        /// @brief Number of loads not yet Ready or Failed
+        size_t nbrLoading() const { return m_nbr_loading; }
+
+    private:
+        struct Request
+        {
+            std::shared_ptr<MeshLoad> load;
+            std::vector<std::string> animation_files;
+            LoadedFunc on_loaded;
+            unsigned xiflags;
+        };
+
+        void loaderLoop();
+
+        /// Move loads read by loader threads to the upload queue
+        void takeLoaded();
+
+        /// Upload part of a load
+        /// @return Bytes uploaded
+        size_t upload(MeshLoad& load, size_t budget_bytes);
+
+        void finish(MeshLoad& load, MeshLoadState state);
+
+        std::deque<std::shared_ptr<MeshLoad>> m_uploading;
+        ResourceCache* m_cache = nullptr;
+        std::unordered_map<const RenderableMesh*, std::weak_ptr<MeshLoad>> m_mesh_loads;   // Loads of cached meshes
+        size_t m_upload_budget;
+        size_t m_uploaded_bytes = 0;
+        size_t m_nbr_loading = 0;
+
+        std::vector<std::thread> m_loaders;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;           // Signals new loads or stop
+        std::condition_variable m_done_cv;      // Signals loads read
+        std::deque<Request> m_pending;
+        std::vector<std::shared_ptr<MeshLoad>> m_loaded;
+        bool m_stop = false;
+    };
+
+} // namespace eeng
+
+#endif /* MeshLoader_hpp */
@@ -0,0 +1,99 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <algorithm>
+#include "MorphTargets.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EENG_MORPH_SSE
+#include <emmintrin.h>
+#endif
+
+namespace eeng
+{
+    namespace
+    {
+        /// out += weight * in, over count floats
+        inline void axpy(float* out, const float* in, float weight, size_t count)
+        {
+            size_t i = 0;
+#ifdef EENG_MORPH_SSE
+            const __m128 w = _mm_set1_ps(weight);
+            for (; i + 4 <= count; i += 4)
+                _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), w)));
+#endif
+            for (; i < count; i++)
+                out[i] += weight * in[i];
+        }
+    }
+
+    size_t MorphTarget::byteSize() const
+    {
+        return sizeof(MorphTarget) + name.capacity() +
+            runs.capacity() * sizeof(MorphRun) +
+            (position_deltas.capacity() + normal_deltas.capacity()) * sizeof(glm::vec3);
+    }
+
+    MorphTarget make_morph_target(
+        const std::string& name,
+        std::span<const uint32_t> vertices,
+        std::span<const glm::vec3> position_deltas,
+        std::span<const glm::vec3> normal_deltas)
+    {
+        MorphTarget target;
+        target.name = name;
+        if (vertices.empty())
+            return target;
+
+        const bool has_normals = !normal_deltas.empty();
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            const uint32_t v = vertices[i];
+            MorphRun* run = (target.runs.empty() ? nullptr : &target.runs.back());
+            if (!run || v >= run->begin + run->count + MorphRunMergeGap)
+            {
+                target.runs.push_back({ v, 0, (uint32_t)target.position_deltas.size() });
+                run = &target.runs.back();
+            }
+
+            // Zero deltas for unmoved vertices inside the run
+            const uint32_t gap = v - (run->begin + run->count);
+            target.position_deltas.insert(target.position_deltas.end(), gap, glm::vec3(0.0f));
+            target.position_deltas.push_back(position_deltas[i]);
+            if (has_normals)
+            {
+                target.normal_deltas.insert(target.normal_deltas.end(), gap, glm::vec3(0.0f));
+                target.normal_deltas.push_back(normal_deltas[i]);
+            }
+            run->count += gap + 1;
+        }
+        target.begin = target.runs.front().begin;
+        target.end = target.runs.back().begin + target.runs.back().count;
+        return target;
+    }
+
+    void accumulate_morph_target(
+        const MorphTarget& target,
+        float weight,
+        uint32_t range_begin,
+        glm::vec3* positions,
+        glm::vec3* normals,
+        uint32_t begin,
+        uint32_t end)
+    {
+        // A run is count * 3 consecutive floats in both the deltas and the output
+        for (const auto& run : target.runs)
+        {
+            const uint32_t run_begin = std::max(run.begin, begin);
+            const uint32_t run_end = std::min(run.begin + run.count, end);
+            if (run_begin >= run_end)
+                continue;
+            const size_t ofs = run_begin - range_begin;
+            const size_t delta_ofs = run.delta_ofs + (run_begin - run.begin);
+            const size_t count = (run_end - run_begin) * 3;
+            axpy(&positions[ofs].x, &target.position_deltas[delta_ofs].x, weight, count);
+            if (!target.normal_deltas.empty())
+                axpy(&normals[ofs].x, &target.normal_deltas[delta_ofs].x, weight, count);
+        }
+    }
+
+} // namespace eeng
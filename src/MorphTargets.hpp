@@ -0,0 +1,77 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef MorphTargets_hpp
+#define MorphTargets_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace eeng
+{
+    /// Vertices that move less than this are not stored in a morph target
+    constexpr float MorphDeltaEpsilon = 1e-6f;
+
+    /// Runs of moved vertices closer than this are merged, storing zero deltas in between
+    constexpr uint32_t MorphRunMergeGap = 8;
+
+    /// @brief Consecutive vertices moved by a morph target
+    struct MorphRun
+    {
+        uint32_t begin = 0;         //!< First vertex
+        uint32_t count = 0;
+        uint32_t delta_ofs = 0;     //!< First delta of the run
+    };
+
+    /// @brief A sparse morph target (blend shape)
+    /// Stores position and normal deltas from the base mesh for the vertices
+    /// it moves only, as runs of consecutive vertices so that deltas can be
+    /// accumulated without gathering.
+    struct MorphTarget
+    {
+        std::string name;
+        std::vector<MorphRun> runs;
+        std::vector<glm::vec3> position_deltas;
+        std::vector<glm::vec3> normal_deltas;       //!< Empty if normals are not morphed
+        uint32_t begin = 0, end = 0;                //!< Range of vertices moved
+
+        /// @brief Deltas stored, including zero deltas of merged runs
+        size_t nbrDeltas() const { return position_deltas.size(); }
+
+        size_t byteSize() const;
+    };
+
+    /// @brief Make a target from the vertices it moves
+    /// @param name Target name
+    /// @param vertices Vertices moved, in increasing order
+    /// @param position_deltas Position delta per vertex
+    /// @param normal_deltas Normal delta per vertex, or empty
+    MorphTarget make_morph_target(
+        const std::string& name,
+        std::span<const uint32_t> vertices,
+        std::span<const glm::vec3> position_deltas,
+        std::span<const glm::vec3> normal_deltas);
+
+    /// @brief Add the weighted deltas of a target, four floats at a time
+    /// @param target Target to add
+    /// @param weight Target weight
+    /// @param range_begin Vertex at the start of the arrays
+    /// @param positions Positions to add to
+    /// @param normals Normals to add to, if the target has normal deltas
+    /// @param begin First vertex to update
+    /// @param end Vertex after the last to update
+    void accumulate_morph_target(
+        const MorphTarget& target,
+        float weight,
+        uint32_t range_begin,
+        glm::vec3* positions,
+        glm::vec3* normals,
+        uint32_t begin = 0,
+        uint32_t end = UINT32_MAX);
+
+} // namespace eeng
+
+#endif /* MorphTargets_hpp */
@@ -0,0 +1,322 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "MotionDatabase.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EENG_MOTION_SSE
+#include <emmintrin.h>
+#endif
+
+namespace eeng
+{
+    namespace
+    {
+        // Feature layout
+        constexpr size_t LeftFootPos = 0, RightFootPos = 3;
+        constexpr size_t LeftFootVel = 6, RightFootVel = 9;
+        constexpr size_t HipsVel = 12;
+        constexpr size_t TrajectoryPos = 15;
+        constexpr size_t TrajectoryDir = TrajectoryPos + 2 * MotionTrajectorySamples;
+
+        /// Nodes of a pose that features are computed from, in model space
+        struct RootSample
+        {
+            glm::vec3 hips, facing, left_foot, right_foot;
+        };
+
+        /// Vector in a root frame with a given facing. Facing +Z gives the vector itself.
+        glm::vec3 to_root(const glm::vec3& v, const glm::vec3& facing)
+        {
+            const glm::vec3 side(facing.z, 0.0f, -facing.x);
+            return { glm::dot(v, side), v.y, glm::dot(v, facing) };
+        }
+
+        /// Normalized direction on the ground plane, or +Z if there is none
+        glm::vec3 ground_direction(const glm::vec3& v)
+        {
+            const glm::vec3 d(v.x, 0.0f, v.z);
+            const float len = glm::length(d);
+            return len > 1e-6f ? d / len : glm::vec3(0.0f, 0.0f, 1.0f);
+        }
+
+        void set3(MotionDatabase::Features& f, size_t ofs, const glm::vec3& v)
+        {
+            f[ofs] = v.x; f[ofs + 1] = v.y; f[ofs + 2] = v.z;
+        }
+
+        /// Squared distances of the frames of a batch to a normalized query
+        inline void batch_costs(const float* batch, const float* query, float* costs)
+        {
+#ifdef EENG_MOTION_SSE
+            __m128 acc = _mm_setzero_ps();
+            for (size_t f = 0; f < MotionFeatureCount; f++)
+            {
+                const __m128 d = _mm_sub_ps(_mm_loadu_ps(batch + f * MotionBatchWidth), _mm_set1_ps(query[f]));
+                acc = _mm_add_ps(acc, _mm_mul_ps(d, d));
+            }
+            _mm_storeu_ps(costs, acc);
+#else
+            for (size_t l = 0; l < MotionBatchWidth; l++)
+                costs[l] = 0.0f;
+            for (size_t f = 0; f < MotionFeatureCount; f++)
+                for (size_t l = 0; l < MotionBatchWidth; l++)
+                {
+                    const float d = batch[f * MotionBatchWidth + l] - query[f];
+                    costs[l] += d * d;
+                }
+#endif
+        }
+    }
+
+    void MotionDatabase::build(
+        const RenderableMesh& mesh,
+        const std::vector<int>& clips,
+        const MotionDatabaseSettings& settings)
+    {
+        EENG_ASSERT(settings.sample_rate > 0.0f, "Invalid sample rate {0}", settings.sample_rate);
+        m_frame_clips.clear();
+        m_frame_times.clear();
+        m_frame_facings.clear();
+        m_features.clear();
+        m_clip_frames.assign(mesh.getNbrAnimations(), {});
+        m_sample_rate = settings.sample_rate;
+        std::copy(std::begin(settings.trajectory_times), std::end(settings.trajectory_times), m_trajectory_times);
+
+        const int hips = mesh.m_nodetree.find_node_index(settings.hips);
+        const int left_foot = mesh.m_nodetree.find_node_index(settings.left_foot);
+        const int right_foot = mesh.m_nodetree.find_node_index(settings.right_foot);
+        EENG_ASSERT(hips != EENG_NULL_INDEX && left_foot != EENG_NULL_INDEX && right_foot != EENG_NULL_INDEX,
+            "Feature nodes {0}, {1}, {2} not found", settings.hips, settings.left_foot, settings.right_foot);
+
+        // Hips axis that points along model +Z in bind pose
+        AnimationPose pose = mesh.createPose();
+        const glm::vec3 hips_forward = glm::inverse(pose.global_tfms[hips].linear()) * glm::vec3(0.0f, 0.0f, 1.0f);
+
+        for (int clip : clips)
+        {
+            EENG_ASSERT(clip >= 0 && clip < (int)mesh.getNbrAnimations(), "{0} is not a valid clip index", clip);
+            const float duration = mesh.getAnimationDuration(clip);
+            auto sample = [&](float time)
+                {
+                    mesh.animate(pose, clip, duration > 0.0f ? glm::clamp(time / duration, 0.0f, 1.0f) : 0.0f, AnmationTimeFormat::NormalizedTime);
+                    const auto& hips_tfm = pose.global_tfms[hips];
+                    return RootSample{
+                        hips_tfm.translation(),
+                        ground_direction(hips_tfm.linear() * hips_forward),
+                        pose.global_tfms[left_foot].translation(),
+                        pose.global_tfms[right_foot].translation() };
+                };
+
+            const size_t first = m_features.size();
+            const size_t count = (size_t)std::floor(duration * m_sample_rate) + 1;
+            if (!m_clip_frames[clip].count)
+                m_clip_frames[clip] = { first, count, duration };
+
+            const float h = 1.0f / m_sample_rate;
+            for (size_t i = 0; i < count; i++)
+            {
+                const float time = std::min(i * h, duration);
+                const RootSample s = sample(time);
+                const glm::vec3 origin(s.hips.x, 0.0f, s.hips.z);
+
+                // Velocities by forward differences, backward at the clip end
+                RootSample a = s, b = s;
+                if (time + h <= duration)
+                    b = sample(time + h);
+                else if (time >= h)
+                    a = sample(time - h);
+
+                Features f{};
+                set3(f, LeftFootPos, to_root(s.left_foot - origin, s.facing));
+                set3(f, RightFootPos, to_root(s.right_foot - origin, s.facing));
+                set3(f, LeftFootVel, to_root((b.left_foot - a.left_foot) / h, s.facing));
+                set3(f, RightFootVel, to_root((b.right_foot - a.right_foot) / h, s.facing));
+                set3(f, HipsVel, to_root((b.hips - a.hips) / h, s.facing));
+
+                // Trajectory ahead, clamped at the clip end
+                for (size_t k = 0; k < MotionTrajectorySamples; k++)
+                {
+                    const RootSample t = sample(time + m_trajectory_times[k]);
+                    const glm::vec3 p = to_root(t.hips - s.hips, s.facing);
+                    const glm::vec3 d = to_root(t.facing, s.facing);
+                    f[TrajectoryPos + 2 * k] = p.x;
+                    f[TrajectoryPos + 2 * k + 1] = p.z;
+                    f[TrajectoryDir + 2 * k] = d.x;
+                    f[TrajectoryDir + 2 * k + 1] = d.z;
+                }
+
+                m_frame_clips.push_back(clip);
+                m_frame_times.push_back(time);
+                m_frame_facings.push_back(s.facing);
+                m_features.push_back(f);
+            }
+        }
+
+        buildSearchData(settings);
+    }
+
+    void MotionDatabase::buildSearchData(const MotionDatabaseSettings& settings)
+    {
+        // Per-group normalization, so that the weights decide the influence of groups
+        const size_t nbr_frames = m_features.size();
+        const struct { size_t begin, end; float weight; } groups[] = {
+            { LeftFootPos, LeftFootVel, settings.foot_position_weight },
+            { LeftFootVel, HipsVel, settings.foot_velocity_weight },
+            { HipsVel, TrajectoryPos, settings.hips_velocity_weight },
+            { TrajectoryPos, TrajectoryDir, settings.trajectory_position_weight },
+            { TrajectoryDir, MotionFeatureCount, settings.trajectory_direction_weight } };
+        m_mean.fill(0.0f);
+        for (const auto& f : m_features)
+            for (size_t j = 0; j < MotionFeatureCount; j++)
+                m_mean[j] += f[j] / nbr_frames;
+        for (const auto& group : groups)
+        {
+            float variance = 0.0f;
+            for (const auto& f : m_features)
+                for (size_t j = group.begin; j < group.end; j++)
+                    variance += (f[j] - m_mean[j]) * (f[j] - m_mean[j]);
+            variance /= std::max<size_t>(1, nbr_frames * (group.end - group.begin));
+            const float std_dev = std::sqrt(variance);
+            for (size_t j = group.begin; j < group.end; j++)
+                m_scale[j] = (std_dev > 1e-6f ? group.weight / std_dev : group.weight);
+        }
+
+        // Interleave batches, padded by repeating the last frame
+        const size_t nbr_batches = (nbr_frames + MotionBatchWidth - 1) / MotionBatchWidth;
+        m_batches.resize(nbr_batches * MotionFeatureCount * MotionBatchWidth);
+        for (size_t b = 0; b < nbr_batches; b++)
+            for (size_t l = 0; l < MotionBatchWidth; l++)
+            {
+                const Features f = normalize(m_features[std::min(b * MotionBatchWidth + l, nbr_frames - 1)]);
+                for (size_t j = 0; j < MotionFeatureCount; j++)
+                    m_batches[(b * MotionFeatureCount + j) * MotionBatchWidth + l] = f[j];
+            }
+    }
+
+    size_t MotionDatabase::findFrame(int clip, float time) const
+    {
+        if (clip < 0 || clip >= (int)m_clip_frames.size() || !m_clip_frames[clip].count)
+            return 0;
+
+        const auto& frames = m_clip_frames[clip];
+        if (frames.duration > 0.0f)
+            time = std::fmod(std::max(time, 0.0f), frames.duration);
+        const size_t i = (size_t)std::lround(time * m_sample_rate);
+        return frames.first + std::min(i, frames.count - 1);
+    }
+
+    MotionDatabase::Features MotionDatabase::makeQuery(
+        size_t frame,
+        const glm::vec3& velocity,
+        const glm::vec3& facing) const
+    {
+        EENG_ASSERT(frame < nbrFrames(), "{0} is not a valid frame", frame);
+
+        // Pose features of the frame, trajectory from constant velocity and facing
+        Features query = m_features[frame];
+        const glm::vec3& frame_facing = m_frame_facings[frame];
+        const glm::vec3 v = to_root(velocity, frame_facing);
+        const glm::vec3 d = to_root(ground_direction(facing), frame_facing);
+        for (size_t k = 0; k < MotionTrajectorySamples; k++)
+        {
+            query[TrajectoryPos + 2 * k] = v.x * m_trajectory_times[k];
+            query[TrajectoryPos + 2 * k + 1] = v.z * m_trajectory_times[k];
+            query[TrajectoryDir + 2 * k] = d.x;
+            query[TrajectoryDir + 2 * k + 1] = d.z;
+        }
+        return query;
+    }
+
+    MotionMatch MotionDatabase::search(
+        const Features& query,
+        float budget_ms,
+        size_t first_frame) const
+    {
+        if (m_features.empty())
+            return {};
+
+        using clock = std::chrono::steady_clock;
+        const auto start_time = clock::now();
+        const auto budget = std::chrono::duration<float, std::milli>(budget_ms);
+
+        const Features q = normalize(query);
+        const size_t nbr_frames = m_features.size();
+        const size_t nbr_batches = (nbr_frames + MotionBatchWidth - 1) / MotionBatchWidth;
+        const size_t first_batch = std::min(first_frame, nbr_frames - 1) / MotionBatchWidth;
+
+        float best_cost = std::numeric_limits<float>::max();
+        size_t best_frame = 0;
+        bool complete = true;
+        for (size_t i = 0; i < nbr_batches; i++)
+        {
+            const size_t b = (first_batch + i) % nbr_batches;
+            float costs[MotionBatchWidth];
+            batch_costs(&m_batches[b * MotionFeatureCount * MotionBatchWidth], q.data(), costs);
+            for (size_t l = 0; l < MotionBatchWidth; l++)
+                if (costs[l] < best_cost)
+                {
+                    best_cost = costs[l];
+                    best_frame = std::min(b * MotionBatchWidth + l, nbr_frames - 1);
+                }
+
+            // Check the clock now and then
+            if (budget_ms > 0.0f && (i & 63) == 63 && i + 1 < nbr_batches && clock::now() - start_time > budget)
+            {
+                complete = false;
+                break;
+            }
+        }
+        return makeMatch(best_frame, best_cost, complete);
+    }
+
+    MotionMatch MotionDatabase::searchScalar(const Features& query) const
+    {
+        if (m_features.empty())
+            return {};
+
+        const Features q = normalize(query);
+        float best_cost = std::numeric_limits<float>::max();
+        size_t best_frame = 0;
+        for (size_t i = 0; i < m_features.size(); i++)
+        {
+            const Features f = normalize(m_features[i]);
+            float cost = 0.0f;
+            for (size_t j = 0; j < MotionFeatureCount; j++)
+                cost += (f[j] - q[j]) * (f[j] - q[j]);
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_frame = i;
+            }
+        }
+        return makeMatch(best_frame, best_cost, true);
+    }
+
+    size_t MotionDatabase::byteSize() const
+    {
+        return sizeof(MotionDatabase) +
+            m_frame_clips.capacity() * sizeof(int) +
+            m_frame_times.capacity() * sizeof(float) +
+            m_frame_facings.capacity() * sizeof(glm::vec3) +
+            m_features.capacity() * sizeof(Features) +
+            m_batches.capacity() * sizeof(float) +
+            m_clip_frames.capacity() * sizeof(ClipFrames);
+    }
+
+    MotionDatabase::Features MotionDatabase::normalize(const Features& features) const
+    {
+        Features normalized;
+        for (size_t j = 0; j < MotionFeatureCount; j++)
+            normalized[j] = (features[j] - m_mean[j]) * m_scale[j];
+        return normalized;
+    }
+
+    MotionMatch MotionDatabase::makeMatch(size_t frame, float cost, bool complete) const
+    {
+        return { m_frame_clips[frame], m_frame_times[frame], frame, cost, complete };
+    }
+
+} // namespace eeng
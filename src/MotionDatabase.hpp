@@ -0,0 +1,141 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef MotionDatabase_hpp
+#define MotionDatabase_hpp
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "config.h"
+#include "RenderableMesh.hpp"
+
+namespace eeng
+{
+    /// Number of frames compared at once by MotionDatabase::search()
+    constexpr size_t MotionBatchWidth = 4;
+
+    /// Number of trajectory samples per frame
+    constexpr size_t MotionTrajectorySamples = 3;
+
+    /// Features per frame: foot positions and velocities, hips velocity,
+    /// and trajectory positions and directions on the ground plane
+    constexpr size_t MotionFeatureCount = 3 * 5 + 4 * MotionTrajectorySamples;
+
+    /// @brief How a MotionDatabase samples clips and weighs features
+    struct MotionDatabaseSettings
+    {
+        std::string hips = "mixamorig:Hips";            //!< Node that defines the root frame
+        std::string left_foot = "mixamorig:LeftFoot";
+        std::string right_foot = "mixamorig:RightFoot";
+        float sample_rate = 30.0f;                      //!< Frames per second of clip time
+        float trajectory_times[MotionTrajectorySamples] = { 0.2f, 0.4f, 0.6f };   //!< Seconds ahead
+
+        float foot_position_weight = 1.0f;
+        float foot_velocity_weight = 1.0f;
+        float hips_velocity_weight = 1.0f;
+        float trajectory_position_weight = 1.0f;
+        float trajectory_direction_weight = 1.5f;
+    };
+
+    /// @brief Result of a MotionDatabase search
+    struct MotionMatch
+    {
+        int clip = EENG_NULL_INDEX;     //!< Clip index of the mesh
+        float time = 0.0f;              //!< Clip time in seconds
+        size_t frame = 0;               //!< Database frame
+        float cost = std::numeric_limits<float>::max();
+        bool complete = true;           //!< False if the time budget ran out before all frames were compared
+    };
+
+    /// @brief Pose features of clip frames, for motion matching
+    /// Features are expressed in a root frame at the hips, projected to the
+    /// ground plane and rotated to the facing of the hips. Clips should keep
+    /// their root motion when the database is built, since trajectory
+    /// features come from it.
+    /// Features are normalized per group (see MotionDatabaseSettings) and
+    /// stored interleaved in batches of MotionBatchWidth frames, so that a
+    /// search compares a batch of frames per instruction.
+    class MotionDatabase
+    {
+    public:
+        using Features = std::array<float, MotionFeatureCount>;
+
+        /// @brief Sample clips of a mesh and build the search data
+        /// @param mesh Mesh to evaluate poses of
+        /// @param clips Clip indices to include. Clips may be listed more than once.
+        /// @param settings Feature nodes, sample rate and weights
+        void build(
+            const RenderableMesh& mesh,
+            const std::vector<int>& clips,
+            const MotionDatabaseSettings& settings = {});
+
+        size_t nbrFrames() const { return m_frame_clips.size(); }
+
+        int frameClip(size_t frame) const { return m_frame_clips[frame]; }
+
+        float frameTime(size_t frame) const { return m_frame_times[frame]; }
+
+        /// @brief Features of a frame, not normalized
+        const Features& frameFeatures(size_t frame) const { return m_features[frame]; }
+
+        /// @brief Frame of a clip nearest to a time. Times past the clip duration wrap.
+        /// @return Frame, or 0 if the clip is not in the database
+        size_t findFrame(int clip, float time) const;
+
+        /// @brief Query with the pose features of a frame and a desired trajectory
+        /// @param frame Frame that is playing
+        /// @param velocity Desired velocity in model space, in model units per second
+        /// @param facing Desired facing in model space
+        Features makeQuery(
+            size_t frame,
+            const glm::vec3& velocity,
+            const glm::vec3& facing) const;
+
+        /// @brief Find the frame with features nearest to a query
+        /// @param query Features, not normalized, see makeQuery()
+        /// @param budget_ms Time after which the best frame so far is returned, or 0 for no limit
+        /// @param first_frame Frame to start from, e.g. the playing frame, so that
+        ///        frames near it are compared before the budget runs out
+        MotionMatch search(
+            const Features& query,
+            float budget_ms = 0.0f,
+            size_t first_frame = 0) const;
+
+        /// @brief Search of all frames one at a time, as a reference for search()
+        MotionMatch searchScalar(const Features& query) const;
+
+        /// @brief Heap and member bytes held by the database
+        size_t byteSize() const;
+
+    private:
+        /// Normalize features and interleave them in batches
+        void buildSearchData(const MotionDatabaseSettings& settings);
+
+        Features normalize(const Features& features) const;
+
+        MotionMatch makeMatch(size_t frame, float cost, bool complete) const;
+
+        std::vector<int> m_frame_clips;
+        std::vector<float> m_frame_times;
+        std::vector<Features> m_features;       // Not normalized
+        std::vector<float> m_batches;           // Normalized, [batch][feature][lane]
+        Features m_mean{}, m_scale{};           // Normalized = (feature - mean) * scale
+        std::vector<glm::vec3> m_frame_facings; // Facing of the root frame, in model space
+
+        struct ClipFrames
+        {
+            size_t first = 0, count = 0;
+            float duration = 0.0f;
+        };
+        std::vector<ClipFrames> m_clip_frames;  // Per clip index of the mesh, first occurrence only
+        float m_sample_rate = 30.0f;
+        float m_trajectory_times[MotionTrajectorySamples] = {};
+    };
+
+} // namespace eeng
+
+#endif /* MotionDatabase_hpp */
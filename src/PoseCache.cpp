@@ -0,0 +1,173 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <atomic>
+#include <cmath>
+#include "PoseCache.hpp"
+#include "hash_combine.h"
+
+namespace eeng
+{
+    namespace
+    {
+        std::atomic<uint64_t> total_hits{ 0 };
+        std::atomic<uint64_t> total_misses{ 0 };
+    }
+
+    PoseCacheCounters pose_cache_totals()
+    {
+        return { total_hits.load(std::memory_order_relaxed), total_misses.load(std::memory_order_relaxed) };
+    }
+
+    size_t PoseCache::KeyHash::operator()(const Key& key) const
+    {
+        return hash_combine(key.mesh, key.anim_index0, key.anim_index1, key.time_tick0, key.time_tick1, key.blend_tick);
+    }
+
+    PoseCache::PoseCache(
+        float time_quantum,
+        float blend_quantum)
+    {
+        setTimeQuantum(time_quantum);
+        setBlendQuantum(blend_quantum);
+    }
+
+    void PoseCache::setTimeQuantum(float time_quantum)
+    {
+        EENG_ASSERT(time_quantum > 0.0f, "Invalid time quantum {0}", time_quantum);
+        m_time_quantum = time_quantum;
+    }
+
+    void PoseCache::setBlendQuantum(float blend_quantum)
+    {
+        EENG_ASSERT(blend_quantum > 0.0f, "Invalid blend quantum {0}", blend_quantum);
+        m_blend_quantum = blend_quantum;
+    }
+
+    void PoseCache::beginFrame()
+    {
+        m_index.clear();
+        m_nbr_used = 0;
+        m_frame_counters = {};
+    }
+
+    const AnimationPose& PoseCache::animate(
+        const RenderableMesh& mesh,
+        int anim_index,
+        float time,
+        AnmationTimeFormat animTimeFormat)
+    {
+        if (anim_index < 0 || anim_index >= (int)mesh.getNbrAnimations())
+            anim_index = EENG_NULL_INDEX;
+
+        const Key key{
+            &mesh,
+            anim_index,
+            EENG_NULL_INDEX,
+            quantizeTime(mesh, anim_index, time, animTimeFormat),
+            0,
+            0 };
+        bool is_miss;
+        Entry& entry = lookup(key, is_miss);
+        if (is_miss)
+            mesh.animate(entry.pose,
+                anim_index,
+                tickToNormalizedTime(mesh, anim_index, key.time_tick0),
+                AnmationTimeFormat::NormalizedTime);
+        return entry.pose;
+    }
+
+    const AnimationPose& PoseCache::animateBlend(
+        const RenderableMesh& mesh,
+        int anim_index0,
+        int anim_index1,
+        float time0,
+        float time1,
+        float frac,
+        AnmationTimeFormat animTimeFormat0,
+        AnmationTimeFormat animTimeFormat1)
+    {
+        const Key key{
+            &mesh,
+            anim_index0,
+            anim_index1,
+            quantizeTime(mesh, anim_index0, time0, animTimeFormat0),
+            quantizeTime(mesh, anim_index1, time1, animTimeFormat1),
+            (int32_t)std::lround(glm::clamp(frac, 0.0f, 1.0f) / m_blend_quantum) };
+        bool is_miss;
+        Entry& entry = lookup(key, is_miss);
+        if (is_miss)
+            mesh.animateBlend(entry.pose,
+                anim_index0,
+                anim_index1,
+                tickToNormalizedTime(mesh, anim_index0, key.time_tick0),
+                tickToNormalizedTime(mesh, anim_index1, key.time_tick1),
+                glm::min(key.blend_tick * m_blend_quantum, 1.0f),
+                AnmationTimeFormat::NormalizedTime,
+                AnmationTimeFormat::NormalizedTime);
+        return entry.pose;
+    }
+
+    PoseCache::Entry& PoseCache::lookup(const Key& key, bool& is_miss)
+    {
+        const auto [it, inserted] = m_index.try_emplace(key, m_nbr_used);
+        is_miss = inserted;
+        if (!inserted)
+        {
+            m_frame_counters.hits++;
+            total_hits.fetch_add(1, std::memory_order_relaxed);
+            return m_entries[it->second];
+        }
+        m_frame_counters.misses++;
+        total_misses.fetch_add(1, std::memory_order_relaxed);
+
+        if (m_nbr_used == m_entries.size())
+            m_entries.emplace_back();
+        Entry& entry = m_entries[m_nbr_used++];
+        if (entry.mesh != key.mesh || entry.pose.nbr_nodes() != key.mesh->m_nodetree.size())
+        {
+            entry.mesh = key.mesh;
+            entry.pose = key.mesh->createPose();
+        }
+        return entry;
+    }
+
+    int32_t PoseCache::quantizeTime(
+        const RenderableMesh& mesh,
+        int anim_index,
+        float time,
+        AnmationTimeFormat animTimeFormat) const
+    {
+        if (anim_index < 0)
+            return 0;
+
+        // Clip time in seconds, wrapped as animate() does for real time
+        const float duration = mesh.getAnimationDuration(anim_index);
+        if (duration <= 0.0f)
+            return 0;
+
+        float clip_time;
+        if (animTimeFormat == AnmationTimeFormat::RealTime)
+        {
+            clip_time = std::fmod(time, duration);
+            if (clip_time < 0.0f)
+                clip_time += duration;
+        }
+        else
+            clip_time = glm::clamp(time, 0.0f, 1.0f) * duration;
+
+        return (int32_t)std::lround(clip_time / m_time_quantum);
+    }
+
+    float PoseCache::tickToNormalizedTime(
+        const RenderableMesh& mesh,
+        int anim_index,
+        int32_t time_tick) const
+    {
+        if (anim_index < 0)
+            return 0.0f;
+
+        const float duration = mesh.getAnimationDuration(anim_index);
+        return duration > 0.0f ? glm::min(time_tick * m_time_quantum / duration, 1.0f) : 0.0f;
+    }
+
+} // namespace eeng
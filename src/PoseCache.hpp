@@ -0,0 +1,134 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef PoseCache_hpp
+#define PoseCache_hpp
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+
+#include "RenderableMesh.hpp"
+
+namespace eeng
+{
+    /// @brief Hit and miss counts of pose lookups
+    struct PoseCacheCounters
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+
+        float hitRate() const { return hits + misses ? float(hits) / (hits + misses) : 0.0f; }
+    };
+
+    /// @brief Counts summed over all pose caches since start, e.g. for the engine info UI
+    PoseCacheCounters pose_cache_totals();
+
+    /// @brief Poses shared by instances that play the same clips at the same quantized time
+    /// Lookups with the same mesh, clips, quantized times and quantized blend
+    /// fraction return the same pose, evaluated once per frame. Clip time is
+    /// rounded to a multiple of the time quantum, which trades accuracy for
+    /// hit rate. Returned poses are shared and must be treated as read-only.
+    /// Not thread-safe.
+    class PoseCache
+    {
+    public:
+        /// @param time_quantum Clip time resolution, in seconds
+        /// @param blend_quantum Blend fraction resolution
+        explicit PoseCache(
+            float time_quantum = 1.0f / 30.0f,
+            float blend_quantum = 1.0f / 16.0f);
+
+        void setTimeQuantum(float time_quantum);
+
+        void setBlendQuantum(float blend_quantum);
+
+        float timeQuantum() const { return m_time_quantum; }
+
+        float blendQuantum() const { return m_blend_quantum; }
+
+        /// @brief Start a new frame
+        /// Previous poses are dropped, but their memory is kept for reuse.
+        /// References returned before the call are invalidated.
+        void beginFrame();
+
+        /// @brief Pose of a mesh animated by a clip, see RenderableMesh::animate()
+        const AnimationPose& animate(
+            const RenderableMesh& mesh,
+            int anim_index,
+            float time,
+            AnmationTimeFormat animTimeFormat = AnmationTimeFormat::RealTime);
+
+        /// @brief Pose of a mesh animated by a blend of two clips, see RenderableMesh::animateBlend()
+        const AnimationPose& animateBlend(
+            const RenderableMesh& mesh,
+            int anim_index0,
+            int anim_index1,
+            float time0,
+            float time1,
+            float frac,
+            AnmationTimeFormat animTimeFormat0 = AnmationTimeFormat::RealTime,
+            AnmationTimeFormat animTimeFormat1 = AnmationTimeFormat::RealTime);
+
+        /// @brief Counts since beginFrame()
+        const PoseCacheCounters& frameCounters() const { return m_frame_counters; }
+
+        /// @brief Number of poses evaluated since beginFrame()
+        size_t nbrPoses() const { return m_nbr_used; }
+
+    private:
+        struct Key
+        {
+            const RenderableMesh* mesh;
+            int anim_index0;
+            int anim_index1;
+            int32_t time_tick0;
+            int32_t time_tick1;
+            int32_t blend_tick;
+
+            bool operator==(const Key& other) const
+            {
+                return mesh == other.mesh &&
+                    anim_index0 == other.anim_index0 &&
+                    anim_index1 == other.anim_index1 &&
+                    time_tick0 == other.time_tick0 &&
+                    time_tick1 == other.time_tick1 &&
+                    blend_tick == other.blend_tick;
+            }
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const;
+        };
+
+        struct Entry
+        {
+            const RenderableMesh* mesh = nullptr;
+            AnimationPose pose;
+        };
+
+        int32_t quantizeTime(
+            const RenderableMesh& mesh,
+            int anim_index,
+            float time,
+            AnmationTimeFormat animTimeFormat) const;
+
+        float tickToNormalizedTime(
+            const RenderableMesh& mesh,
+            int anim_index,
+            int32_t time_tick) const;
+
+        /// Entry of a key, where is_miss tells if it is new and needs to be evaluated
+        Entry& lookup(const Key& key, bool& is_miss);
+
+        float m_time_quantum;
+        float m_blend_quantum;
+        std::unordered_map<Key, size_t, KeyHash> m_index;   // Entry per key, for this frame
+        std::deque<Entry> m_entries;                        // In use first, then kept for reuse. Deque, so references stay valid.
+        size_t m_nbr_used = 0;
+        PoseCacheCounters m_frame_counters;
+    };
+
+} // namespace eeng
+
+#endif /* PoseCache_hpp */
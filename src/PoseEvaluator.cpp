@@ -0,0 +1,257 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include "PoseEvaluator.hpp"
+
+#include <cmath>
+#include "config.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EENG_POSE_EVALUATOR_SSE
+#include <emmintrin.h>
+#endif
+
+namespace eeng
+{
+    namespace
+    {
+#ifdef EENG_POSE_EVALUATOR_SSE
+        /// Translation, rotation and scale of four nodes, one component per register
+        struct Trs4
+        {
+            __m128 px, py, pz;
+            __m128 rx, ry, rz, rw;
+            __m128 sx, sy, sz;
+        };
+
+        /// Load 3 floats without reading past them
+        inline __m128 load3(const float* p)
+        {
+            return _mm_movelh_ps(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p))), _mm_load_ss(p + 2));
+        }
+
+        inline void load3_soa(const float* p0, const float* p1, const float* p2, const float* p3, __m128& x, __m128& y, __m128& z)
+        {
+            __m128 a = load3(p0), b = load3(p1), c = load3(p2), d = load3(p3);
+            _MM_TRANSPOSE4_PS(a, b, c, d);
+            x = a; y = b; z = c;
+        }
+
+        inline void load4_soa(const float* p0, const float* p1, const float* p2, const float* p3, __m128& x, __m128& y, __m128& z, __m128& w)
+        {
+            __m128 a = _mm_loadu_ps(p0), b = _mm_loadu_ps(p1), c = _mm_loadu_ps(p2), d = _mm_loadu_ps(p3);
+            _MM_TRANSPOSE4_PS(a, b, c, d);
+            x = a; y = b; z = c; w = d;
+        }
+
+        inline __m128 lerp(__m128 a, __m128 b, __m128 t)
+        {
+            return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+        }
+
+        /// Normalized lerp along the shortest arc
+        inline void nlerp(
+            __m128 ax, __m128 ay, __m128 az, __m128 aw,
+            __m128 bx, __m128 by, __m128 bz, __m128 bw,
+            __m128 t,
+            __m128& x, __m128& y, __m128& z, __m128& w)
+        {
+            const __m128 dot = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+                _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+            const __m128 sign = _mm_and_ps(dot, _mm_set1_ps(-0.0f));
+            x = lerp(ax, _mm_xor_ps(bx, sign), t);
+            y = lerp(ay, _mm_xor_ps(by, sign), t);
+            z = lerp(az, _mm_xor_ps(bz, sign), t);
+            w = lerp(aw, _mm_xor_ps(bw, sign), t);
+
+            const __m128 len_sq = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+            const __m128 inv_len = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(len_sq));
+            x = _mm_mul_ps(x, inv_len);
+            y = _mm_mul_ps(y, inv_len);
+            z = _mm_mul_ps(z, inv_len);
+            w = _mm_mul_ps(w, inv_len);
+        }
+
+        /// Interpolate keys of four nodes
+        inline Trs4 interpolate4(const TrsKeys* k, __m128 t)
+        {
+            Trs4 a, b, r;
+            load3_soa(k[0].pos0, k[1].pos0, k[2].pos0, k[3].pos0, a.px, a.py, a.pz);
+            load3_soa(k[0].pos1, k[1].pos1, k[2].pos1, k[3].pos1, b.px, b.py, b.pz);
+            load4_soa(k[0].rot0, k[1].rot0, k[2].rot0, k[3].rot0, a.rx, a.ry, a.rz, a.rw);
+            load4_soa(k[0].rot1, k[1].rot1, k[2].rot1, k[3].rot1, b.rx, b.ry, b.rz, b.rw);
+            load3_soa(k[0].scale0, k[1].scale0, k[2].scale0, k[3].scale0, a.sx, a.sy, a.sz);
+            load3_soa(k[0].scale1, k[1].scale1, k[2].scale1, k[3].scale1, b.sx, b.sy, b.sz);
+
+            r.px = lerp(a.px, b.px, t); r.py = lerp(a.py, b.py, t); r.pz = lerp(a.pz, b.pz, t);
+            nlerp(a.rx, a.ry, a.rz, a.rw, b.rx, b.ry, b.rz, b.rw, t, r.rx, r.ry, r.rz, r.rw);
+            r.sx = lerp(a.sx, b.sx, t); r.sy = lerp(a.sy, b.sy, t); r.sz = lerp(a.sz, b.sz, t);
+            return r;
+        }
+
+        inline Trs4 blend4(const Trs4& a, const Trs4& b, __m128 t)
+        {
+            Trs4 r;
+            r.px = lerp(a.px, b.px, t); r.py = lerp(a.py, b.py, t); r.pz = lerp(a.pz, b.pz, t);
+            nlerp(a.rx, a.ry, a.rz, a.rw, b.rx, b.ry, b.rz, b.rw, t, r.rx, r.ry, r.rz, r.rw);
+            r.sx = lerp(a.sx, b.sx, t); r.sy = lerp(a.sy, b.sy, t); r.sz = lerp(a.sz, b.sz, t);
+            return r;
+        }
+
+        inline void store_row(__m128 x, __m128 y, __m128 z, __m128 w, size_t row, Affine* const* out, size_t count)
+        {
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            const __m128 lanes[] = { x, y, z, w };
+            for (size_t i = 0; i < count; i++)
+                _mm_storeu_ps(&out[i]->rows[row].x, lanes[i]);
+        }
+
+        /// Compose T * R * S of four nodes into affine matrices
+        inline void compose4(const Trs4& t, Affine* const* out, size_t count)
+        {
+            const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+            const __m128 xx = _mm_mul_ps(t.rx, t.rx), yy = _mm_mul_ps(t.ry, t.ry), zz = _mm_mul_ps(t.rz, t.rz);
+            const __m128 xy = _mm_mul_ps(t.rx, t.ry), xz = _mm_mul_ps(t.rx, t.rz), yz = _mm_mul_ps(t.ry, t.rz);
+            const __m128 wx = _mm_mul_ps(t.rw, t.rx), wy = _mm_mul_ps(t.rw, t.ry), wz = _mm_mul_ps(t.rw, t.rz);
+
+            // Rotation columns scaled by the scale components
+            const __m128 m00 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), t.sx);
+            const __m128 m01 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), t.sx);
+            const __m128 m02 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), t.sx);
+            const __m128 m10 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), t.sy);
+            const __m128 m11 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), t.sy);
+            const __m128 m12 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), t.sy);
+            const __m128 m20 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), t.sz);
+            const __m128 m21 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), t.sz);
+            const __m128 m22 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), t.sz);
+
+            // mCR is column C, row R
+            store_row(m00, m10, m20, t.px, 0, out, count);
+            store_row(m01, m11, m21, t.py, 1, out, count);
+            store_row(m02, m12, m22, t.pz, 2, out, count);
+        }
+
+        /// Copy keys to four lanes, repeating the first node in unused lanes
+        inline void fill_lanes(const TrsKeys* keys, size_t count, TrsKeys* lanes)
+        {
+            for (size_t i = 0; i < PoseEvaluatorWidth; i++)
+                lanes[i] = keys[i < count ? i : 0];
+        }
+#else
+        /// Translation, rotation and scale of a node
+        struct Trs
+        {
+            float p[3], r[4], s[3];
+        };
+
+        inline float lerp(float a, float b, float t)
+        {
+            return a + (b - a) * t;
+        }
+
+        /// Normalized lerp along the shortest arc
+        inline void nlerp(const float* a, const float* b, float t, float* r)
+        {
+            const float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+            const float sign = (dot < 0.0f ? -1.0f : 1.0f);
+            float len_sq = 0.0f;
+            for (int i = 0; i < 4; i++)
+            {
+                r[i] = lerp(a[i], sign * b[i], t);
+                len_sq += r[i] * r[i];
+            }
+            const float inv_len = 1.0f / std::sqrt(len_sq);
+            for (int i = 0; i < 4; i++)
+                r[i] *= inv_len;
+        }
+
+        inline Trs interpolate(const TrsKeys& k, float t)
+        {
+            Trs r;
+            for (int i = 0; i < 3; i++)
+            {
+                r.p[i] = lerp(k.pos0[i], k.pos1[i], t);
+                r.s[i] = lerp(k.scale0[i], k.scale1[i], t);
+            }
+            nlerp(k.rot0, k.rot1, t, r.r);
+            return r;
+        }
+
+        inline Trs blend(const Trs& a, const Trs& b, float t)
+        {
+            Trs r;
+            for (int i = 0; i < 3; i++)
+            {
+                r.p[i] = lerp(a.p[i], b.p[i], t);
+                r.s[i] = lerp(a.s[i], b.s[i], t);
+            }
+            nlerp(a.r, b.r, t, r.r);
+            return r;
+        }
+
+        /// Compose T * R * S into an affine matrix
+        inline void compose(const Trs& t, Affine& M)
+        {
+            const float x = t.r[0], y = t.r[1], z = t.r[2], w = t.r[3];
+            const float sx = t.s[0], sy = t.s[1], sz = t.s[2];
+            M.rows[0] = glm::vec4((1.0f - 2.0f * (y * y + z * z)) * sx, 2.0f * (x * y - w * z) * sy, 2.0f * (x * z + w * y) * sz, t.p[0]);
+            M.rows[1] = glm::vec4(2.0f * (x * y + w * z) * sx, (1.0f - 2.0f * (x * x + z * z)) * sy, 2.0f * (y * z - w * x) * sz, t.p[1]);
+            M.rows[2] = glm::vec4(2.0f * (x * z - w * y) * sx, 2.0f * (y * z + w * x) * sy, (1.0f - 2.0f * (x * x + y * y)) * sz, t.p[2]);
+        }
+#endif
+    }
+
+    bool pose_evaluator_is_vectorized()
+    {
+#ifdef EENG_POSE_EVALUATOR_SSE
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void evaluate_trs(
+        const TrsKeys* keys,
+        size_t count,
+        float frac,
+        Affine* const* out)
+    {
+        EENG_ASSERT(count <= PoseEvaluatorWidth, "Too many nodes ({0})", count);
+        if (!count) return;
+#ifdef EENG_POSE_EVALUATOR_SSE
+        TrsKeys lanes[PoseEvaluatorWidth];
+        fill_lanes(keys, count, lanes);
+        compose4(interpolate4(lanes, _mm_set1_ps(frac)), out, count);
+#else
+        for (size_t i = 0; i < count; i++)
+            compose(interpolate(keys[i], frac), *out[i]);
+#endif
+    }
+
+    void evaluate_blend_trs(
+        const TrsKeys* keys0,
+        const TrsKeys* keys1,
+        size_t count,
+        float frac0,
+        float frac1,
+        float blend_frac,
+        Affine* const* out)
+    {
+        EENG_ASSERT(count <= PoseEvaluatorWidth, "Too many nodes ({0})", count);
+        if (!count) return;
+#ifdef EENG_POSE_EVALUATOR_SSE
+        TrsKeys lanes0[PoseEvaluatorWidth], lanes1[PoseEvaluatorWidth];
+        fill_lanes(keys0, count, lanes0);
+        fill_lanes(keys1, count, lanes1);
+        const Trs4 trs0 = interpolate4(lanes0, _mm_set1_ps(frac0));
+        const Trs4 trs1 = interpolate4(lanes1, _mm_set1_ps(frac1));
+        compose4(blend4(trs0, trs1, _mm_set1_ps(blend_frac)), out, count);
+#else
+        for (size_t i = 0; i < count; i++)
+            compose(blend(interpolate(keys0[i], frac0), interpolate(keys1[i], frac1), blend_frac), *out[i]);
+#endif
+    }
+
+} // namespace eeng
@@ -0,0 +1,67 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef PoseEvaluator_hpp
+#define PoseEvaluator_hpp
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "Affine.hpp"
+
+namespace eeng
+{
+    /// @brief Implementation used to evaluate local node transforms of a pose
+    enum class AnimationEvaluator
+    {
+        Scalar,     //!< glm TRS matrices, slerp, dual quaternion blending
+        Simd        //!< Several nodes at once, lerp/nlerp composed directly into affine matrices
+    };
+
+    /// @brief Keys of a node to interpolate between
+    /// Translations and scales are 3 floats, rotations 4 floats (x, y, z, w).
+    struct TrsKeys
+    {
+        const float* pos0;
+        const float* pos1;
+        const float* rot0;
+        const float* rot1;
+        const float* scale0;
+        const float* scale1;
+    };
+
+    /// Number of nodes evaluated at once by the SIMD evaluator
+    constexpr size_t PoseEvaluatorWidth = 4;
+
+    /// @brief True if the SIMD evaluator uses vector instructions, false if it runs the scalar fallback
+    bool pose_evaluator_is_vectorized();
+
+    /// @brief Interpolate keys of up to PoseEvaluatorWidth nodes and compose local transforms
+    /// @param keys Keys per node
+    /// @param count Number of nodes, at most PoseEvaluatorWidth
+    /// @param frac Interpolation fraction between keys
+    /// @param out Transform per node
+    void evaluate_trs(
+        const TrsKeys* keys,
+        size_t count,
+        float frac,
+        Affine* const* out);
+
+    /// @brief Interpolate keys of up to PoseEvaluatorWidth nodes in two clips, blend and compose local transforms
+    /// @param keys0 Keys per node of clip 0
+    /// @param keys1 Keys per node of clip 1
+    /// @param count Number of nodes, at most PoseEvaluatorWidth
+    /// @param frac0 Interpolation fraction between keys of clip 0
+    /// @param frac1 Interpolation fraction between keys of clip 1
+    /// @param blend_frac Blend fraction, where 0 gives clip 0 and 1 gives clip 1
+    /// @param out Transform per node
+    void evaluate_blend_trs(
+        const TrsKeys* keys0,
+        const TrsKeys* keys1,
+        size_t count,
+        float frac0,
+        float frac1,
+        float blend_frac,
+        Affine* const* out);
+
+} // namespace eeng
+
+#endif /* PoseEvaluator_hpp */
@@ -3,11 +3,23 @@
 
 #include "RenderableMesh.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <thread>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtx/dual_quaternion.hpp>
 #include <assimp/version.h>
 
 #include "ShaderLoader.h"
 #include "parseutil.h"
+#include "ThreadPool.hpp"
+#include "ClipLibrary.hpp"
+#include "ClipStreamer.hpp"
+#include "hash_combine.h"
+#include "MeshCook.hpp"
+#include "ResourceCache.hpp"
 
 namespace eeng
 {
@@ -23,6 +35,13 @@ namespace eeng
             return glm::quat(aiq.w, aiq.x, aiq.y, aiq.z);
         }
 
+        /// Signed normalized 10:10:10:2, as read by GL_INT_2_10_10_10_REV attributes
+        inline uint32_t pack_direction(const glm::vec3& v, float w = 0.0f)
+        {
+            const float length = glm::length(v);
+            return glm::packSnorm3x10_1x2(glm::vec4(length > 0.0f ? v / length : v, w));
+        }
+
         inline glm::mat4 aimat_to_glmmat(const aiMatrix4x4& aim)
         {
             glm::mat4 glmm;
@@ -67,6 +86,41 @@ namespace eeng
             return transformMatrix;
         }
 
+        /// Resample an Assimp key track to uniformly spaced samples over [0, duration_ticks].
+        /// Keys are located by their time stamps, so tracks with non-uniform key spacing
+        /// are handled. Sample times increase, so the key cursor only moves forward.
+        template<class T, class AiKey, class Convert, class Interpolate>
+        void resample_keys(
+            const AiKey* keys,
+            unsigned nbr_keys,
+            double duration_ticks,
+            size_t nbr_samples,
+            const T& default_value,
+            std::vector<T>& samples,
+            Convert&& convert,
+            Interpolate&& interpolate)
+        {
+            samples.resize(nbr_samples, default_value);
+            if (!nbr_keys) return;
+
+            unsigned k = 0;
+            for (size_t i = 0; i < nbr_samples; i++)
+            {
+                const double t = (nbr_samples > 1 ? duration_ticks * i / (nbr_samples - 1) : 0.0);
+                while (k + 1 < nbr_keys && keys[k + 1].mTime <= t)
+                    k++;
+
+                if (k + 1 >= nbr_keys || t <= keys[k].mTime)
+                {
+                    samples[i] = convert(keys[k].mValue);
+                    continue;
+                }
+                const double dt = keys[k + 1].mTime - keys[k].mTime;
+                const float frac = (dt > 0.0 ? float((t - keys[k].mTime) / dt) : 0.0f);
+                samples[i] = interpolate(convert(keys[k].mValue), convert(keys[k + 1].mValue), frac);
+            }
+        }
+
         void dump_tree_to_stream(
             const VecTree<SkeletonNode>& tree,
             logstreamer_t&& outstream)
@@ -87,12 +141,53 @@ namespace eeng
                         << ", parent ofs " << parent_ofs << ")\n";
                 });
         }
+
+        // Cooked files, see RenderableMesh::setUseCookedFiles().
+        // Layout: header (magic, version, source time, Assimp flags, sample rate,
+        // skin weight threshold, skeleton signature, mesh flag), the mesh if the
+        // flag is set, then the clips with uncompressed keys.
+        constexpr std::array<char, 4> CookedMeshMagic = { 'E', 'E', 'M', 'S' };
+        constexpr uint32_t CookedMeshVersion = 1;
+
+        enum class CookedTexture : uint32_t { File, Raw, Compressed };
+
+        std::string cooked_path(const std::string& file)
+        {
+            return file + ".eemesh";
+        }
+
+        int64_t source_time(const std::string& file)
+        {
+            std::error_code ec;
+            const auto time = std::filesystem::last_write_time(file, ec);
+            return ec ? 0 : (int64_t)time.time_since_epoch().count();
+        }
+
+        template<class Hash>
+        void write_hash(CookWriter& out, const Hash& hash)
+        {
+            out.value((uint32_t)hash.size());
+            for (const auto& [key, index] : hash)
+            {
+                out.string(key);
+                out.value(index);
+            }
+        }
+
+        template<class Hash>
+        void read_hash(CookReader& in, Hash& hash)
+        {
+            const uint32_t size = in.value<uint32_t>();
+            for (uint32_t i = 0; i < size; i++)
+            {
+                std::string key = in.string();
+                hash[key] = in.value<typename Hash::mapped_type>();
+            }
+        }
     }
 
     void RenderableMesh::SkinData::addWeight(unsigned bone_index, float bone_weight)
     {
-        nbr_added++;
-
         float min_weight = 1;
         unsigned min_index = 0;
         for (uint i = 0; i < numelem(bone_indices); i++)
@@ -108,6 +203,99 @@ namespace eeng
         }
     }
 
+    void RenderableMesh::SkinData::prune(float threshold)
+    {
+        // Sort by weight, largest first
+        for (int i = 1; i < BonesPerVertex; i++)
+            for (int j = i; j > 0 && bone_weights[j] > bone_weights[j - 1]; j--)
+            {
+                std::swap(bone_weights[j], bone_weights[j - 1]);
+                std::swap(bone_indices[j], bone_indices[j - 1]);
+            }
+
+        // The largest weight is always kept
+        float sum = 0.0f;
+        for (int i = 0; i < BonesPerVertex; i++)
+        {
+            if (bone_weights[i] <= 0.0f || (i > 0 && bone_weights[i] < threshold))
+            {
+                bone_weights[i] = 0.0f;
+                bone_indices[i] = 0;
+            }
+            sum += bone_weights[i];
+        }
+
+        // Same fallback as the shader for vertices without weights
+        if (sum < 0.01f)
+        {
+            *this = SkinData();
+            bone_weights[0] = 1.0f;
+            return;
+        }
+        for (int i = 0; i < BonesPerVertex; i++)
+            bone_weights[i] /= sum;
+    }
+
+    int RenderableMesh::SkinData::nbrInfluences() const
+    {
+        int count = 0;
+        for (int i = 0; i < BonesPerVertex; i++)
+            count += (bone_weights[i] > 0.0f);
+        return count;
+    }
+
+    RenderableMesh::ClipSample RenderableMesh::ClipData::sampleAt(float ntime) const
+    {
+        // Single multiply-and-floor, valid for all channels since keys are uniform
+        const size_t last_key = (nbr_samples ? nbr_samples - 1 : 0);
+        const float indexf = glm::clamp(ntime, 0.0f, 1.0f) * last_key;
+        const size_t key0 = std::min((size_t)indexf, last_key);
+        return { key0, std::min(key0 + 1, last_key), indexf - key0 };
+    }
+
+    size_t RenderableMesh::ClipData::byteSize() const
+    {
+        size_t bytes = sizeof(ClipData) - sizeof(CompressedClip) + name.capacity();
+        for (const auto& channel_name : channel_names)
+            bytes += sizeof(std::string) + channel_name.capacity();
+        bytes += channels.capacity() * sizeof(ChannelKeys);
+        bytes += keys.data.capacity() * sizeof(float);
+        return bytes + compressed.byteSize();
+    }
+
+    size_t RenderableMesh::AnimationClip::byteSize() const
+    {
+        return sizeof(AnimationClip) + node_channels.capacity() * sizeof(int);
+    }
+
+    TrsKeys RenderableMesh::ClipData::keysAt(int channel_index, const ClipSample& sample) const
+    {
+        const auto& channel = channels[channel_index];
+        const size_t key0 = channel.key_ofs + sample.key0;
+        const size_t key1 = channel.key_ofs + sample.key1;
+        return {
+            &keys.positions()[key0].x, &keys.positions()[key1].x,
+            &keys.rotations()[key0].x, &keys.rotations()[key1].x,
+            &keys.scales()[key0].x, &keys.scales()[key1].x };
+    }
+
+    const RenderableMesh::ClipData& RenderableMesh::AnimationClip::clip() const
+    {
+        return stream ? *stream->current : *data;
+    }
+
+    bool RenderableMesh::AnimationClip::animatesNode(size_t node_index) const
+    {
+        return node_channels[node_index] != EENG_NULL_INDEX;
+    }
+
+    void RenderableMesh::KeyPool::resize(size_t nbr_keys)
+    {
+        // Translations (3 floats), rotations (4 floats) and scales (3 floats) per key
+        this->nbr_keys = nbr_keys;
+        data.resize(nbr_keys * 10);
+    }
+
     RenderableMesh::RenderableMesh()
     {
     }
@@ -116,29 +304,14 @@ namespace eeng
     {
         unsigned xiflags = (append_animations ? xi_load_animations : (xi_load_meshes | xi_load_animations));
 
-        unsigned aiflags;
-        //    aiflags |= aiProcess_Triangulate;
-        //    aiflags |= aiProcess_JoinIdenticalVertices;
+        // Other flags that have been useful for some models
         //    aiflags |= aiProcess_GenSmoothNormals; // needed for ArmyPilot
-        //    //aiflags |= aiProcess_GenUVCoords;
         //    //aiflags |= aiProcess_TransformUVCoords;
         //    aiflags |= aiProcess_RemoveComponent;
-        //    aiflags |= aiProcess_FlipUVs;
-        //    aiflags |= aiProcess_CalcTangentSpace;
 
         // aiflags = aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_FlipUVs;
 
-        aiflags =
-            aiProcess_CalcTangentSpace /*  */ |
-            aiProcess_GenNormals |
-            aiProcess_JoinIdenticalVertices |
-            aiProcess_Triangulate /* Must be here for render geometry */ |
-            aiProcess_GenUVCoords |
-            aiProcess_SortByPType |
-            aiProcess_FlipUVs | // added
-            aiProcess_OptimizeGraph;
-
-        load(file, xiflags, aiflags);
+        load(file, xiflags, DefaultAiFlags);
     }
 
     void RenderableMesh::load(const std::string& file,
@@ -147,7 +320,15 @@ namespace eeng
 
     {
         // Plan is to utilize xiflags with more detail
-        bool append_animations = (xiflags == xi_load_animations);
+        bool append_animations = !(xiflags & xi_load_meshes);
+        if (!append_animations)
+        {
+            m_headless = (xiflags & xi_headless);
+            m_keep_cpu_geometry = (xiflags & xi_keep_cpu_geometry);
+            m_defer_upload = (xiflags & xi_defer_upload) && !m_headless;
+            if (m_defer_upload)
+                m_pending = std::make_unique<PendingUpload>();
+        }
 
         //
         std::string filepath, filename, fileext;
@@ -164,6 +345,21 @@ namespace eeng
             log.add_ofstream(filepath + filename + "_log.txt", PRTVERBOSE);
         }
 
+        // Clips already loaded for this skeleton need no import
+        m_loaded_cooked = false;
+        if (append_animations && m_meshes.size() && addLibraryClips(file))
+        {
+            buildEvalList();
+            return;
+        }
+
+        // Neither does anything in an up-to-date cooked file
+        if (m_use_cooked && (!append_animations || m_meshes.size()) && loadCooked(file, aiflags, append_animations))
+        {
+            m_loaded_cooked = true;
+            return;
+        }
+
         // Log misc stuff
         log << priority(PRTSTRICT) << "Assimp version: "
             << aiGetVersionMajor() << "."
@@ -194,17 +390,20 @@ namespace eeng
             if (!m_meshes.size())
                 throw std::runtime_error("Cannot append animations to an empty model\n");
 
-            loadAnimations(aiscene);
+            const size_t first_clip = m_animations.size();
+            loadAnimations(aiscene, file);
+            buildEvalList();
+            if (m_use_cooked)
+                writeCooked(file, aiflags, aiscene, nullptr, first_clip);
 
             log << priority(PRTSTRICT) << "Done appending animations.\n";
             return;
         }
 
-        glGenVertexArrays(1, &m_VAO);
-        glBindVertexArray(m_VAO);
-        glGenBuffers(numelem(m_Buffers), m_Buffers);
-        loadScene(aiscene, filepath);
-        glBindVertexArray(0);
+        SceneGeometry geometry;
+        loadScene(aiscene, filepath, geometry);
+        if (!m_headless)
+            createBuffers(geometry.view());
 
         loadNodes(aiscene->mRootNode);
 
@@ -212,14 +411,397 @@ namespace eeng
         dump_tree_to_stream(m_nodetree, logstreamer_t{ filepath + filename + "_nodetree.txt", PRTVERBOSE });
         // m_nodetree.debug_print({filepath + filename + "_nodetree.txt", PRTVERBOSE});
 
-        loadAnimations(aiscene);
-
+        m_skeleton_signature = computeSkeletonSignature();
+        const size_t first_clip = m_animations.size();
+        loadAnimations(aiscene, file);
 
-        // Traverse the hierarchy.
-        // Animated meshes must be traversed before each frame.
-        animate(-1, 0.0f);
 
         mSceneAABB = measureScene(aiscene); // Only captures bind pose.
+
+        initPoseData();
+
+        // Materials are only loaded with GL
+        if (m_use_cooked && !m_headless)
+            writeCooked(file, aiflags, aiscene, &geometry, first_clip);
+    }
+
+    void RenderableMesh::initPoseData()
+    {
+        computeNodeReach();
+        computeBindLocalPose();
+        buildEvalList();
+        buildPoseBounds();
+
+        // Default pose, in bind pose.
+        // Animated instances should evaluate their own poses before each frame.
+        m_pose = createPose();
+    }
+
+    bool RenderableMesh::loadCooked(const std::string& file, unsigned aiflags, bool append_animations)
+    {
+        const std::string cooked_file = cooked_path(file);
+        MappedFile mapped;
+        if (!mapped.open(cooked_file))
+            return false;
+        CookReader in(mapped.data(), mapped.size(), cooked_file);
+
+        try
+        {
+            const bool valid =
+                in.value<std::array<char, 4>>() == CookedMeshMagic &&
+                in.value<uint32_t>() == CookedMeshVersion &&
+                in.value<int64_t>() == source_time(file) &&
+                in.value<uint32_t>() == aiflags &&
+                in.value<float>() == m_sample_rate &&
+                in.value<float>() == m_skin_weight_threshold;
+            const uint64_t signature = (valid ? in.value<uint64_t>() : 0);
+            const bool has_mesh = (valid ? in.value<uint32_t>() : 0);
+
+            // A file of clips must match the skeleton they were sampled for
+            if (!valid || has_mesh == append_animations || (append_animations && signature != m_skeleton_signature))
+            {
+                log << priority(PRTSTRICT) << "Cooked file " << cooked_file << " is stale" << std::endl;
+                return false;
+            }
+            log << priority(PRTSTRICT) << "Loading cooked file " << cooked_file << std::endl;
+
+            if (has_mesh)
+            {
+                // Blobs are views into the mapping
+                GeometryView geometry;
+                geometry.positions = in.blob<glm::vec3>();
+                geometry.normals = in.blob<glm::vec3>();
+                geometry.tangents = in.blob<glm::vec3>();
+                geometry.binormals = in.blob<glm::vec3>();
+                geometry.texcoords = in.blob<glm::vec2>();
+                geometry.skin = in.blob<SkinData>();
+                geometry.indices = in.blob<uint>();
+
+                const auto meshes = in.blob<Submesh>();
+                m_meshes.assign(meshes.begin(), meshes.end());
+
+                // Morph targets
+                m_morph_targets.resize(in.value<uint32_t>());
+                for (auto& target : m_morph_targets)
+                {
+                    target.name = in.string();
+                    const auto runs = in.blob<MorphRun>();
+                    const auto position_deltas = in.blob<glm::vec3>();
+                    const auto normal_deltas = in.blob<glm::vec3>();
+                    target.runs.assign(runs.begin(), runs.end());
+                    target.position_deltas.assign(position_deltas.begin(), position_deltas.end());
+                    target.normal_deltas.assign(normal_deltas.begin(), normal_deltas.end());
+                    target.begin = in.value<uint32_t>();
+                    target.end = in.value<uint32_t>();
+                }
+                m_morph_weights.assign(m_morph_targets.size(), 0.0f);
+                m_morph_applied_weights.assign(m_morph_targets.size(), 0.0f);
+                initMorphRange(geometry.positions.data(), geometry.normals.data());
+
+                const auto materials = in.blob<PhongMaterial>();
+                m_materials.assign(materials.begin(), materials.end());
+
+                // Textures, decoded unless headless
+                m_embedded_textures_ofs = in.value<uint32_t>();
+                const uint32_t nbr_textures = in.value<uint32_t>();
+                for (uint32_t i = 0; i < nbr_textures; i++)
+                {
+                    const std::string name = in.string();
+                    const std::string path = in.string();
+                    const auto address_mode = in.value<texture_address_mode_t>();
+                    const auto kind = in.value<CookedTexture>();
+                    const uint32_t width = in.value<uint32_t>();
+                    const uint32_t height = in.value<uint32_t>();
+                    const auto data = in.blob<unsigned char>();
+                    if (m_headless)
+                        continue;
+
+                    unsigned index;
+                    if (kind == CookedTexture::Raw)
+                        index = addTexture(name, path, Texture2D::copy_image(data.data(), width, height, 4));
+                    else if (kind == CookedTexture::Compressed)
+                        index = addTexture(name, path, Texture2D::decode_memory(name, data.data(), (int)data.size()));
+                    else
+                        index = addTextureFile(name, path);
+                    m_textures[index].set_address_mode(address_mode);
+                    log << priority(PRTVERBOSE) << "Loaded texture " << m_textures[index] << std::endl;
+                }
+                index_hash_t texturehash;
+                read_hash(in, texturehash);
+                if (!m_headless)
+                    m_texturehash = std::move(texturehash);
+
+                // Nodes, in depth-first order
+                const uint32_t nbr_nodes = in.value<uint32_t>();
+                std::vector<std::string> node_names(nbr_nodes);
+                for (uint32_t i = 0; i < nbr_nodes; i++)
+                {
+                    SkeletonNode node(in.string());
+                    node.local_tfm = in.value<glm::mat4>();
+                    node.bone_index = in.value<int32_t>();
+                    node.nbr_meshes = in.value<int32_t>();
+                    const int32_t parent_index = in.value<int32_t>();
+                    node_names[i] = node.name;
+
+                    if (parent_index == EENG_NULL_INDEX)
+                        m_nodetree.insert_as_root(node);
+                    else if (parent_index >= (int32_t)i || !m_nodetree.insert(node, node_names[parent_index]))
+                        throw std::runtime_error("Node tree insertion failed, hierarchy corrupt");
+                    m_nodehash[node.name] = i;
+                }
+
+                const auto bones = in.blob<Bone>();
+                m_bones.assign(bones.begin(), bones.end());
+                read_hash(in, m_bonehash);
+
+                mSceneAABB = in.value<AABB>();
+                const auto bone_aabbs = in.blob<AABB>();
+                const auto mesh_aabbs = in.blob<AABB>();
+                m_bone_aabbs_bind.assign(bone_aabbs.begin(), bone_aabbs.end());
+                m_mesh_aabbs_bind.assign(mesh_aabbs.begin(), mesh_aabbs.end());
+
+                if (m_keep_cpu_geometry)
+                {
+                    m_cpu_positions.assign(geometry.positions.begin(), geometry.positions.end());
+                    m_cpu_normals.assign(geometry.normals.begin(), geometry.normals.end());
+                    m_cpu_skin.assign(geometry.skin.begin(), geometry.skin.end());
+                }
+
+                // Buffers are filled straight from the mapping, unless uploads are deferred
+                if (!m_headless)
+                    createBuffers(geometry);
+
+                m_skeleton_signature = computeSkeletonSignature();
+            }
+
+            // Clips
+            log << priority(PRTSTRICT) << "Loading animations..." << std::endl;
+            if (!addLibraryClips(file))
+            {
+                ClipLibrary::ClipList clips(in.value<uint32_t>());
+                for (auto& clip : clips)
+                {
+                    clip = std::make_shared<ClipData>();
+                    clip->name = in.string();
+                    clip->duration_ticks = in.value<float>();
+                    clip->tps = in.value<float>();
+                    clip->sample_rate = in.value<float>();
+                    clip->nbr_samples = in.value<uint32_t>();
+                    clip->channel_names.resize(in.value<uint32_t>());
+                    for (auto& channel_name : clip->channel_names)
+                        channel_name = in.string();
+                    const auto channels = in.blob<ChannelKeys>();
+                    const auto keys = in.blob<float>();
+                    clip->channels.assign(channels.begin(), channels.end());
+                    clip->keys.resize(keys.size() / 10);
+                    std::copy(keys.begin(), keys.end(), clip->keys.data.begin());
+
+                    if (m_compression.enabled)
+                        compressClip(*clip);
+                }
+                for (const auto& clip : clips)
+                    addClip(clip);
+
+                if (m_clip_library)
+                    m_clip_library->insert(file, m_skeleton_signature, m_sample_rate, m_compression, std::move(clips));
+            }
+            log << priority(PRTSTRICT) << "Animations in total " << m_animations.size() << std::endl;
+        }
+        catch (const std::runtime_error& e)
+        {
+            // Data may be partially loaded at this point
+            throw std::runtime_error(std::string("Corrupt cooked file: ") + e.what() + ", delete it to re-import");
+        }
+
+        if (append_animations)
+            buildEvalList();
+        else
+            initPoseData();
+        return true;
+    }
+
+    void RenderableMesh::writeCooked(const std::string& file,
+        unsigned aiflags,
+        const aiScene* aiscene,
+        const SceneGeometry* geometry,
+        size_t first_clip)
+    {
+        // Written to a temporary file first, so a failed write leaves no partial cooked file.
+        // The file is per thread, since meshes may load the same file at the same time.
+        const std::string cooked_file = cooked_path(file);
+        const std::string tmp_file = cooked_file + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+        try
+        {
+            {
+                CookWriter out(tmp_file);
+                out.value(CookedMeshMagic);
+                out.value(CookedMeshVersion);
+                out.value(source_time(file));
+                out.value((uint32_t)aiflags);
+                out.value(m_sample_rate);
+                out.value(m_skin_weight_threshold);
+                out.value((uint64_t)m_skeleton_signature);
+                out.value((uint32_t)(geometry != nullptr));
+
+                if (geometry)
+                {
+                    out.blob(geometry->positions);
+                    out.blob(geometry->normals);
+                    out.blob(geometry->tangents);
+                    out.blob(geometry->binormals);
+                    out.blob(geometry->texcoords);
+                    out.blob(geometry->skin);
+                    out.blob(geometry->indices);
+                    out.blob(m_meshes);
+
+                    out.value((uint32_t)m_morph_targets.size());
+                    for (const auto& target : m_morph_targets)
+                    {
+                        out.string(target.name);
+                        out.blob(target.runs);
+                        out.blob(target.position_deltas);
+                        out.blob(target.normal_deltas);
+                        out.value(target.begin);
+                        out.value(target.end);
+                    }
+
+                    out.blob(m_materials);
+
+                    // Embedded textures keep their encoded data, textures on file only their path
+                    out.value((uint32_t)m_embedded_textures_ofs);
+                    out.value((uint32_t)m_textures.size());
+                    for (unsigned i = 0; i < m_textures.size(); i++)
+                    {
+                        const auto& texture = m_textures[i];
+                        out.string(texture.m_name);
+                        out.string(texture.m_fullpath);
+                        out.value(texture.m_address_mode);
+
+                        const bool embedded = (i >= m_embedded_textures_ofs && i < m_embedded_textures_ofs + aiscene->mNumTextures);
+                        if (!embedded)
+                        {
+                            out.value(CookedTexture::File);
+                            out.value(0u);
+                            out.value(0u);
+                            out.blob(std::span<const unsigned char>());
+                            continue;
+                        }
+                        const aiTexture* aitexture = aiscene->mTextures[i - m_embedded_textures_ofs];
+                        const bool raw = aitexture->mHeight;
+                        out.value(raw ? CookedTexture::Raw : CookedTexture::Compressed);
+                        out.value(aitexture->mWidth);
+                        out.value(aitexture->mHeight);
+                        out.blob(std::span<const unsigned char>(
+                            (const unsigned char*)aitexture->pcData,
+                            raw ? aitexture->mWidth * aitexture->mHeight * 4 : aitexture->mWidth));
+                    }
+                    write_hash(out, m_texturehash);
+
+                    // Nodes with parent indices, so that the tree can be rebuilt in order
+                    out.value((uint32_t)m_nodetree.size());
+                    m_nodetree.traverse_depthfirst([&](const SkeletonNode& node, size_t i, size_t level)
+                        {
+                            auto [nbr_children, branch_stride, parent_ofs] = m_nodetree.get_node_info(node);
+                            out.string(node.name);
+                            out.value(node.local_tfm);
+                            out.value((int32_t)node.bone_index);
+                            out.value((int32_t)node.nbr_meshes);
+                            out.value((int32_t)(parent_ofs ? (int)(i - parent_ofs) : EENG_NULL_INDEX));
+                        });
+
+                    out.blob(m_bones);
+                    write_hash(out, m_bonehash);
+
+                    out.value(mSceneAABB);
+                    out.blob(m_bone_aabbs_bind);
+                    out.blob(m_mesh_aabbs_bind);
+                }
+
+                // Clips are stored uncompressed, so that compression settings can change
+                const size_t nbr_clips = m_animations.size() - first_clip;
+                out.value((uint32_t)nbr_clips);
+                for (size_t i = 0; i < nbr_clips; i++)
+                {
+                    auto clip = m_animations[first_clip + i].data;
+                    if (clip->is_compressed)
+                    {
+                        EENG_ASSERT(nbr_clips == aiscene->mNumAnimations, "Clips of {0} do not match the import", file);
+                        clip = loadClip(aiscene->mAnimations[i], false);
+                    }
+
+                    out.string(clip->name);
+                    out.value(clip->duration_ticks);
+                    out.value(clip->tps);
+                    out.value(clip->sample_rate);
+                    out.value((uint32_t)clip->nbr_samples);
+                    out.value((uint32_t)clip->channel_names.size());
+                    for (const auto& channel_name : clip->channel_names)
+                        out.string(channel_name);
+                    out.blob(clip->channels);
+                    out.blob(clip->keys.data);
+                }
+                out.finish();
+            }
+            std::filesystem::rename(tmp_file, cooked_file);
+            log << priority(PRTSTRICT) << "Wrote cooked file " << cooked_file << std::endl;
+        }
+        catch (const std::exception& e)
+        {
+            log << priority(PRTSTRICT) << "Failed to write cooked file " << cooked_file << ": " << e.what() << std::endl;
+            std::error_code ec;
+            std::filesystem::remove(tmp_file, ec);
+        }
+    }
+
+    void RenderableMesh::setAnimationSampleRate(float samples_per_sec)
+    {
+        EENG_ASSERT(samples_per_sec > 0.0f, "Invalid sample rate {0}", samples_per_sec);
+        m_sample_rate = samples_per_sec;
+    }
+
+    void RenderableMesh::setSkinWeightThreshold(float threshold)
+    {
+        EENG_ASSERT(threshold >= 0.0f && threshold < 1.0f, "Invalid skin weight threshold {0}", threshold);
+        m_skin_weight_threshold = threshold;
+    }
+
+    void RenderableMesh::setAnimationCompression(const AnimationCompression& settings)
+    {
+        m_compression = settings;
+    }
+
+    void RenderableMesh::setResourceCache(ResourceCache* cache)
+    {
+        m_resource_cache = cache;
+    }
+
+    void RenderableMesh::setClipLibrary(ClipLibrary* library)
+    {
+        m_clip_library = library;
+    }
+
+    int RenderableMesh::addStreamedAnimation(ClipStreamer& streamer, const std::string& file)
+    {
+        EENG_ASSERT(m_meshes.size(), "Cannot add animations to an empty model");
+
+        const StreamedClip* stream = streamer.registerClip(file);
+        addClip(stream->fallback);
+        m_animations.back().stream = stream;
+        buildEvalList();
+
+        log << priority(PRTSTRICT) << "Added streamed animation '" << stream->fallback->name << "' from " << file << std::endl;
+        return (int)m_animations.size() - 1;
+    }
+
+    void RenderableMesh::cookAnimation(unsigned i, const std::string& file, float fallback_rate) const
+    {
+        EENG_ASSERT(i < getNbrAnimations(), "{0} is not a valid clip index", i);
+        ClipStreamer::cook(m_animations[i].clip(), file, fallback_rate);
+    }
+
+    void RenderableMesh::setAnimationEvaluator(AnimationEvaluator evaluator)
+    {
+        m_evaluator = evaluator;
     }
 
     void RenderableMesh::removeTranslationKeys(const std::string& node_name)
@@ -229,16 +811,29 @@ namespace eeng
 
     void RenderableMesh::removeTranslationKeys(int node_index)
     {
+        // Keys are modified in place, so meshes that share a clip (see ClipLibrary) see the change too.
+        // Flattening is idempotent, so meshes that share a clip can all make this call.
+        // Streamed clips are read-only, keys should be removed before cooking
         for (auto& anim : m_animations)
         {
-            EENG_ASSERT(node_index <= anim.node_animations.size(), "{0} is not a valid node index", node_index);
-            auto& pos_keys = anim.node_animations[node_index].pos_keys;
-            for (auto& pk : pos_keys)
-                pk = { 0, pk.y, 0 };
+            EENG_ASSERT(node_index < anim.node_channels.size(), "{0} is not a valid node index", node_index);
+            const int channel_index = anim.node_channels[node_index];
+            if (channel_index == EENG_NULL_INDEX || anim.stream)
+                continue;
+            auto& data = *anim.data;
+            if (data.is_compressed)
+            {
+                data.compressed.flattenTranslation(channel_index);
+                continue;
+            }
+            const auto& channel = data.channels[channel_index];
+            glm::vec3* pos_keys = data.keys.positions() + channel.key_ofs;
+            for (uint32_t k = 0; k < channel.nbr_keys; k++)
+                pos_keys[k] = { 0, pos_keys[k].y, 0 };
         }
     }
 
-    bool RenderableMesh::loadScene(const aiScene* aiscene, const std::string& filename)
+    bool RenderableMesh::loadScene(const aiScene* aiscene, const std::string& filename, SceneGeometry& geometry)
     {
         unsigned scene_nbr_meshes = aiscene->mNumMeshes;
         unsigned scene_nbr_mtl = aiscene->mNumMaterials;
@@ -274,13 +869,13 @@ namespace eeng
         m_meshes.resize(scene_nbr_meshes);
         m_materials.resize(scene_nbr_mtl);
 
-        std::vector<glm::vec3> scene_positions;
-        std::vector<glm::vec3> scene_normals;
-        std::vector<glm::vec3> scene_tangents;
-        std::vector<glm::vec3> scene_binormals;
-        std::vector<glm::vec2> scene_texcoords;
-        std::vector<SkinData> scene_skinweights;
-        std::vector<uint> scene_indices;
+        auto& scene_positions = geometry.positions;
+        auto& scene_normals = geometry.normals;
+        auto& scene_tangents = geometry.tangents;
+        auto& scene_binormals = geometry.binormals;
+        auto& scene_texcoords = geometry.texcoords;
+        auto& scene_skinweights = geometry.skin;
+        auto& scene_indices = geometry.indices;
 
         // Count vertices and indices of the whole scene
         for (unsigned i = 0; i < m_meshes.size(); i++)
@@ -326,18 +921,26 @@ namespace eeng
                 scene_indices);
         }
 
+        // Prune small bone weights and group triangles by the influences of their vertices
+        for (const auto& mesh : m_meshes)
+        {
+            if (!mesh.is_skinned)
+                continue;
+            for (unsigned j = mesh.base_vertex; j < mesh.base_vertex + mesh.nbr_vertices; j++)
+                scene_skinweights[j].prune(m_skin_weight_threshold);
+        }
+        groupTrianglesBySkinVariant(scene_skinweights, scene_indices);
+
         log << priority(PRTSTRICT);
         log << "Scene total vertices " << scene_nbr_vertices << ", triangles " << scene_nbr_indices / 3 << std::endl;
         log << "Bone mapping contains " << m_bonehash.size() << " bones in total\n";
 
+        loadMorphTargets(aiscene, scene_positions, scene_normals);
+
 #if 1
         // Model & bone AABB's
-        boneMatrices.resize(m_bones.size());
         m_bone_aabbs_bind.resize(m_bones.size()); // Constructor resets AABB
-        m_bone_aabbs_pose.resize(m_bones.size());
-
         m_mesh_aabbs_bind.resize(m_meshes.size());
-        m_mesh_aabbs_pose.resize(m_meshes.size());
 
         for (int i = 0; i < m_meshes.size(); i++)
         {
@@ -362,55 +965,224 @@ namespace eeng
         }
 
 #endif
+        if (m_keep_cpu_geometry)
+        {
+            m_cpu_positions = scene_positions;
+            m_cpu_normals = scene_normals;
+            m_cpu_skin = scene_skinweights;
+        }
+
+        if (m_headless)
+        {
+            log << priority(PRTSTRICT) << "Headless load, skipping materials and GL buffers\n";
+            return true;
+        }
+
         loadMaterials(aiscene, filename);
+        return true;
+    }
+
+    std::vector<RenderableMesh::PackedVertex> RenderableMesh::packVertices(const GeometryView& geometry)
+    {
+        std::vector<PackedVertex> vertices(geometry.positions.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            auto& vertex = vertices[i];
+            vertex.position = geometry.positions[i];
+            vertex.texcoord[0] = glm::packHalf1x16(geometry.texcoords[i].x);
+            vertex.texcoord[1] = glm::packHalf1x16(geometry.texcoords[i].y);
+
+            // The shader rebuilds the binormal as cross(normal, tangent) * sign
+            const glm::vec3& normal = geometry.normals[i];
+            const glm::vec3& tangent = geometry.tangents[i];
+            const float sign = glm::dot(glm::cross(normal, tangent), geometry.binormals[i]) < 0.0f ? -1.0f : 1.0f;
+            vertex.normal = pack_direction(normal);
+            vertex.tangent = pack_direction(tangent, sign);
+
+            // Rounding errors of normalized weights go to the largest weight
+            const auto& skin = geometry.skin[i];
+            int sum = 0, largest = 0;
+            for (int j = 0; j < BonesPerVertex; j++)
+            {
+                EENG_ASSERT(skin.bone_indices[j] <= UINT8_MAX, "Bone index {0} exceeds the vertex format", skin.bone_indices[j]);
+                vertex.bone_indices[j] = (uint8_t)skin.bone_indices[j];
+                vertex.bone_weights[j] = (uint8_t)std::lround(glm::clamp(skin.bone_weights[j], 0.0f, 1.0f) * 255.0f);
+                sum += vertex.bone_weights[j];
+                if (vertex.bone_weights[j] > vertex.bone_weights[largest])
+                    largest = j;
+            }
+            if (sum && std::abs(sum - 255) <= BonesPerVertex)
+                vertex.bone_weights[largest] = (uint8_t)(vertex.bone_weights[largest] + 255 - sum);
+        }
+        return vertices;
+    }
+
+    std::vector<uint8_t> RenderableMesh::packIndices(std::span<const uint> indices, GLenum index_type)
+    {
+        if (index_type == GL_UNSIGNED_INT)
+        {
+            const auto bytes = std::as_bytes(indices);
+            return { (const uint8_t*)bytes.data(), (const uint8_t*)bytes.data() + bytes.size() };
+        }
+
+        std::vector<uint8_t> data(indices.size() * sizeof(uint16_t));
+        auto* indices16 = reinterpret_cast<uint16_t*>(data.data());
+        for (size_t i = 0; i < indices.size(); i++)
+            indices16[i] = (uint16_t)indices[i];
+        return data;
+    }
 
+    void RenderableMesh::uploadGeometry(std::span<const PackedVertex> vertices, std::span<const uint8_t> indices)
+    {
         // Load GL buffers
 #define POSITION_LOCATION 0
 #define TEXCOORD_LOCATION 1
 #define NORMAL_LOCATION 2
 #define TANGENT_LOCATION 3
-#define BINORMAL_LOCATION 4
 #define BONE_INDEX_LOCATION 5
 #define BONE_WEIGHT_LOCATION 6
 
-        // Generate and populate the buffers with vertex attributes and the indices
-        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[PositionBuffer]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(scene_positions[0]) * scene_positions.size(), &scene_positions[0], GL_STATIC_DRAW);
+        glGenVertexArrays(1, &m_VAO);
+        glBindVertexArray(m_VAO);
+        glGenBuffers(numelem(m_Buffers), m_Buffers);
+
+        // One interleaved buffer of vertices, and the indices
+        // Positions and normals are rewritten by updateMorphTargets()
+        const GLenum usage = m_morph_targets.empty() ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW;
+        const GLsizei stride = sizeof(PackedVertex);
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[VertexBuffer]);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size_bytes(), vertices.data(), usage);
+
         glEnableVertexAttribArray(POSITION_LOCATION);
-        glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof(PackedVertex, position));
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[TexturecoordBuffer]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(scene_texcoords[0]) * scene_texcoords.size(), &scene_texcoords[0], GL_STATIC_DRAW);
         glEnableVertexAttribArray(TEXCOORD_LOCATION);
-        glVertexAttribPointer(TEXCOORD_LOCATION, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glVertexAttribPointer(TEXCOORD_LOCATION, 2, GL_HALF_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof(PackedVertex, texcoord));
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[NormalBuffer]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(scene_normals[0]) * scene_normals.size(), &scene_normals[0], GL_STATIC_DRAW);
         glEnableVertexAttribArray(NORMAL_LOCATION);
-        glVertexAttribPointer(NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glVertexAttribPointer(NORMAL_LOCATION, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (const GLvoid*)offsetof(PackedVertex, normal));
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[TangentBuffer]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(scene_tangents[0]) * scene_tangents.size(), &scene_tangents[0], GL_STATIC_DRAW);
         glEnableVertexAttribArray(TANGENT_LOCATION);
-        glVertexAttribPointer(TANGENT_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[BinormalBuffer]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(scene_binormals[0]) * scene_binormals.size(), &scene_binormals[0], GL_STATIC_DRAW);
-        glEnableVertexAttribArray(BINORMAL_LOCATION);
-        glVertexAttribPointer(BINORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glVertexAttribPointer(TANGENT_LOCATION, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (const GLvoid*)offsetof(PackedVertex, tangent));
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[BoneBuffer]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(scene_skinweights[0]) * scene_skinweights.size(), &scene_skinweights[0], GL_STATIC_DRAW);
         glEnableVertexAttribArray(BONE_INDEX_LOCATION);
-        glVertexAttribIPointer(BONE_INDEX_LOCATION, 4, GL_UNSIGNED_INT, sizeof(SkinData), (const GLvoid*)0);
+        glVertexAttribIPointer(BONE_INDEX_LOCATION, 4, GL_UNSIGNED_BYTE, stride, (const GLvoid*)offsetof(PackedVertex, bone_indices));
         glEnableVertexAttribArray(BONE_WEIGHT_LOCATION);
-        glVertexAttribPointer(BONE_WEIGHT_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(SkinData), (const GLvoid*)16);
+        glVertexAttribPointer(BONE_WEIGHT_LOCATION, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const GLvoid*)offsetof(PackedVertex, bone_weights));
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[IndexBuffer]);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(scene_indices[0]) * scene_indices.size(), &scene_indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size(), indices.data(), GL_STATIC_DRAW);
 
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
         CheckAndThrowGLErrors();
-        return true;
+    }
+
+    void RenderableMesh::createBuffers(const GeometryView& geometry)
+    {
+        // Indices are relative the base vertex of their submesh
+        const bool short_indices = std::all_of(geometry.indices.begin(), geometry.indices.end(),
+            [](uint index) { return index <= UINT16_MAX; });
+        m_index_type = short_indices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+        auto vertices = packVertices(geometry);
+        auto indices = packIndices(geometry.indices, m_index_type);
+        log << priority(PRTSTRICT) << "Packed " << vertices.size() << " vertices to "
+            << vertices.size() * sizeof(PackedVertex) << " bytes, "
+            << geometry.indices.size() << " indices to " << indices.size() << " bytes" << std::endl;
+        if (m_defer_upload)
+        {
+            m_pending->vertices = std::move(vertices);
+            m_pending->indices = std::move(indices);
+            return;
+        }
+        uploadGeometry(vertices, indices);
+    }
+
+    unsigned RenderableMesh::addTexture(const std::string& name, const std::string& fullpath, texture_image_t image)
+    {
+        const unsigned index = (unsigned)m_textures.size();
+        Texture2D texture;
+        texture.m_fullpath = fullpath;
+        if (m_defer_upload)
+        {
+            texture.m_name = name;
+            texture.m_width = image.width;
+            texture.m_height = image.height;
+            texture.m_channels = image.channels;
+            m_pending->textures.push_back({ index, std::move(image) });
+        }
+        else
+            texture.load_image(name, image);
+        m_textures.push_back(texture);
+        m_shared_textures.push_back(nullptr);
+        if (!m_defer_upload)
+            shareTexture(index);
+        return index;
+    }
+
+    unsigned RenderableMesh::addTextureFile(const std::string& name, const std::string& fullpath)
+    {
+        // Textures of other meshes are reused without decoding
+        if (m_resource_cache)
+        {
+            if (auto shared = m_resource_cache->findTexture(fullpath))
+            {
+                const unsigned index = (unsigned)m_textures.size();
+                m_textures.push_back(*shared);
+                m_shared_textures.push_back(std::move(shared));
+                return index;
+            }
+        }
+        return addTexture(name, fullpath, Texture2D::decode_file(fullpath));
+    }
+
+    void RenderableMesh::shareTexture(unsigned index)
+    {
+        auto& texture = m_textures[index];
+        if (!m_resource_cache || texture.m_fullpath.empty())
+            return;
+
+        // Another mesh may have added the texture since it was looked up
+        auto shared = m_resource_cache->insertTexture(texture);
+        if (shared->m_handle != texture.m_handle)
+            texture.free();
+        const auto address_mode = texture.m_address_mode;
+        texture = *shared;
+        texture.m_address_mode = address_mode;
+        m_shared_textures[index] = std::move(shared);
+    }
+
+    size_t RenderableMesh::uploadPending(size_t budget_bytes)
+    {
+        if (!m_pending)
+            return 0;
+
+        // Textures first, so that the mesh is complete once it has buffers
+        size_t bytes = 0;
+        auto& textures = m_pending->textures;
+        while (!textures.empty())
+        {
+            const auto& pending = textures.back();
+            if (bytes && bytes + pending.image.size() > budget_bytes)
+                return bytes;
+            auto& texture = m_textures[pending.index];
+            texture.load_image(texture.m_name, pending.image);
+            shareTexture(pending.index);
+            bytes += pending.image.size();
+            textures.pop_back();
+        }
+
+        const auto& vertices = m_pending->vertices;
+        const auto& indices = m_pending->indices;
+        const size_t geometry_bytes = vertices.size() * sizeof(PackedVertex) + indices.size();
+        if (bytes && bytes + geometry_bytes > budget_bytes)
+            return bytes;
+
+        m_defer_upload = false;
+        uploadGeometry(vertices, indices);
+        m_pending.reset();
+        return bytes + geometry_bytes;
     }
 
     void RenderableMesh::loadMesh(uint meshindex,
@@ -463,13 +1235,59 @@ namespace eeng
         }
     }
 
-    AABB RenderableMesh::measureScene(const aiScene* aiscene)
+    void RenderableMesh::groupTrianglesBySkinVariant(const std::vector<SkinData>& scene_skindata,
+        std::vector<unsigned int>& scene_indices)
     {
-        AABB aabb;
-        measureNode(aiscene, aiscene->mRootNode, glm::mat4{ 1.0f }, aabb);
+        std::vector<unsigned int> variant_indices[SkinVariantCount];
+        size_t nbr_triangles[SkinVariantCount]{ 0 };
 
-        return aabb;
-    }
+        for (auto& mesh : m_meshes)
+        {
+            for (auto& range : mesh.skin_ranges)
+                range = { mesh.base_index, 0 };
+            if (!mesh.is_skinned)
+            {
+                mesh.skin_ranges[Skin1].nbr_indices = mesh.nbr_indices;
+                continue;
+            }
+
+            // Variant of a triangle is that of its vertex with the most influences
+            for (auto& indices : variant_indices)
+                indices.clear();
+            for (unsigned i = mesh.base_index; i < mesh.base_index + mesh.nbr_indices; i += 3)
+            {
+                int nbr_influences = 0;
+                for (unsigned k = 0; k < 3; k++)
+                    nbr_influences = std::max(nbr_influences, scene_skindata[mesh.base_vertex + scene_indices[i + k]].nbrInfluences());
+                const int variant = (nbr_influences <= 1 ? Skin1 : (nbr_influences == 2 ? Skin2 : Skin4));
+                variant_indices[variant].insert(variant_indices[variant].end(), &scene_indices[i], &scene_indices[i] + 3);
+            }
+
+            // Write back in variant order, keeping the order of triangles within a variant
+            unsigned base_index = mesh.base_index;
+            for (int variant = 0; variant < SkinVariantCount; variant++)
+            {
+                const auto& indices = variant_indices[variant];
+                std::copy(indices.begin(), indices.end(), scene_indices.begin() + base_index);
+                mesh.skin_ranges[variant] = { base_index, (unsigned)indices.size() };
+                nbr_triangles[variant] += indices.size() / 3;
+                base_index += (unsigned)indices.size();
+            }
+        }
+
+        log << priority(PRTSTRICT) << "Skinned triangles by influences per vertex:";
+        for (int variant = 0; variant < SkinVariantCount; variant++)
+            log << " " << SkinVariantInfluences[variant] << ": " << nbr_triangles[variant];
+        log << std::endl;
+    }
+
+    AABB RenderableMesh::measureScene(const aiScene* aiscene)
+    {
+        AABB aabb;
+        measureNode(aiscene, aiscene->mRootNode, glm::mat4{ 1.0f }, aabb);
+
+        return aabb;
+    }
 
     void RenderableMesh::measureNode(const aiScene* aiscene,
         const aiNode* pNode,
@@ -623,7 +1441,7 @@ namespace eeng
                 // Create bone from its inverse bind-pose transform
                 Bone bi;
                 m_bones.push_back(bi);
-                m_bones[bone_index].inversebind_tfm = aimat_to_glmmat(aimesh->mBones[i]->mOffsetMatrix);
+                m_bones[bone_index].inversebind_tfm = Affine(aimat_to_glmmat(aimesh->mBones[i]->mOffsetMatrix));
                 // Hash bone w.r.t. its name
                 m_bonehash[bone_name] = bone_index;
             }
@@ -715,11 +1533,8 @@ namespace eeng
             if (tex_it == m_texturehash.end())
             {
                 // New texture found: create & hash it
-                Texture2D texture;
-                texture.load_from_file(textureFilename, textureAbsPath);
-                log << priority(PRTSTRICT) << "Loaded texture " << texture << std::endl;
-                textureIndex = (unsigned)m_textures.size();
-                m_textures.push_back(texture);
+                textureIndex = addTextureFile(textureFilename, textureAbsPath);
+                log << priority(PRTSTRICT) << "Loaded texture " << m_textures[textureIndex] << std::endl;
                 m_texturehash[textureRelPath] = textureIndex;
             }
             else
@@ -774,28 +1589,27 @@ namespace eeng
             std::string filename = get_filename(aitexture->mFilename.C_Str());
             // std::string filename = std::to_string(i);
 
-            Texture2D texture;
+            unsigned index;
             if (aitexture->mHeight)
             {
                 // Raw embedded image data
-                texture.load_image(filename,
+                index = addTexture(filename, "", Texture2D::copy_image(
                     (unsigned char*)aitexture->pcData,
                     aitexture->mWidth,
                     aitexture->mHeight,
-                    4);
-                log << priority(PRTSTRICT) << "Loaded uncompressed embedded texture " << texture << std::endl;
+                    4));
+                log << priority(PRTSTRICT) << "Loaded uncompressed embedded texture " << m_textures[index] << std::endl;
             }
             else
             {
                 // Compressed embedded image data
-                texture.load_from_memory(filename,
+                index = addTexture(filename, "", Texture2D::decode_memory(filename,
                     (unsigned char*)aitexture->pcData,
-                    sizeof(aiTexel) * (aitexture->mWidth));
-                log << priority(PRTSTRICT) << "Loaded compressed embedded texture " << texture << std::endl;
+                    sizeof(aiTexel) * (aitexture->mWidth)));
+                log << priority(PRTSTRICT) << "Loaded compressed embedded texture " << m_textures[index] << std::endl;
             }
 
-            m_texturehash[filename] = (unsigned)m_textures.size();
-            m_textures.push_back(texture);
+            m_texturehash[filename] = index;
         }
         log << priority(PRTSTRICT) << "Loaded " << aiscene->mNumTextures << " embedded textures\n";
 
@@ -867,102 +1681,256 @@ namespace eeng
             log << "\t" << t.m_name << std::endl;
     }
 
-    void RenderableMesh::loadAnimations(const aiScene* scene)
+    void RenderableMesh::loadAnimations(const aiScene* scene, const std::string& file)
     {
         log << priority(PRTSTRICT) << "Loading animations..." << std::endl;
 
-        for (int i = 0; i < scene->mNumAnimations; i++)
+        if (!addLibraryClips(file))
         {
-            aiAnimation* aianim = scene->mAnimations[i];
+            ClipLibrary::ClipList clips;
+            for (int i = 0; i < scene->mNumAnimations; i++)
+                clips.push_back(loadClip(scene->mAnimations[i]));
+            for (const auto& clip : clips)
+                addClip(clip);
+
+            if (m_clip_library)
+                m_clip_library->insert(file, m_skeleton_signature, m_sample_rate, m_compression, std::move(clips));
+        }
 
-            AnimationClip anim;
-            anim.name = std::string(aianim->mName.C_Str());
-            anim.duration_ticks = aianim->mDuration;
-            anim.tps = aianim->mTicksPerSecond;
-            anim.node_animations.resize(m_nodetree.size());
+        log << priority(PRTSTRICT) << "Animations in total " << m_animations.size() << std::endl;
+    }
 
-            log << priority(PRTSTRICT)
-                << "Loading animation '" << anim.name
-                << "', dur in ticks " << anim.duration_ticks
-                << ", tps " << anim.tps
-                << ", nbr channels " << aianim->mNumChannels
+    std::shared_ptr<RenderableMesh::ClipData> RenderableMesh::loadClip(const aiAnimation* aianim, bool compress)
+    {
+        auto anim_ptr = std::make_shared<ClipData>();
+        auto& anim = *anim_ptr;
+        anim.name = std::string(aianim->mName.C_Str());
+        anim.duration_ticks = aianim->mDuration;
+        anim.tps = (aianim->mTicksPerSecond > 0.0 ? aianim->mTicksPerSecond : 25.0); // Assimp uses 0 for 'unspecified'
+
+        // Number of uniform samples that cover the clip at the requested rate
+        const float duration_sec = anim.duration_ticks / anim.tps;
+        anim.nbr_samples = std::max<size_t>(2, (size_t)std::ceil(duration_sec * m_sample_rate) + 1);
+        anim.sample_rate = (duration_sec > 0.0f ? (anim.nbr_samples - 1) / duration_sec : m_sample_rate);
+
+        log << priority(PRTSTRICT)
+            << "Loading animation '" << anim.name
+            << "', dur in ticks " << anim.duration_ticks
+            << ", tps " << anim.tps
+            << ", nbr channels " << aianim->mNumChannels
+            << ", resampled to " << anim.nbr_samples << " keys (" << anim.sample_rate << " per sec)"
+            << std::endl;
+
+        // Keys of channels are resampled into one array per type, then moved to the pool
+        std::vector<glm::vec3> pos_keys, scale_keys, channel_vec3_keys;
+        std::vector<glm::quat> rot_keys, channel_quat_keys;
+
+        for (int j = 0; j < aianim->mNumChannels; j++)
+        {
+            aiNodeAnim* ainode_anim = aianim->mChannels[j];
+            auto name = std::string(ainode_anim->mNodeName.C_Str());
+
+            log << priority(PRTVERBOSE)
+                << "\tLoading channel " << name
+                << ", nbr pos keys  " << ainode_anim->mNumPositionKeys
+                << ", nbr scale keys  " << ainode_anim->mNumScalingKeys
+                << ", nbr rot keys  " << ainode_anim->mNumRotationKeys
                 << std::endl;
 
-            for (int j = 0; j < aianim->mNumChannels; j++)
+            // Channels of nodes not in the tree take no storage
+            if (m_nodetree.find_node_index(name) == EENG_NULL_INDEX)
+                continue;
+
+            ChannelKeys channel;
+            channel.key_ofs = (uint32_t)pos_keys.size();
+            channel.nbr_keys = (uint32_t)anim.nbr_samples;
+
+            resample_keys(ainode_anim->mPositionKeys,
+                ainode_anim->mNumPositionKeys,
+                anim.duration_ticks,
+                anim.nbr_samples,
+                glm::vec3{ 0.0f },
+                channel_vec3_keys,
+                aivec_to_glmvec,
+                [](const glm::vec3& a, const glm::vec3& b, float t) { return glm::mix(a, b, t); });
+            pos_keys.insert(pos_keys.end(), channel_vec3_keys.begin(), channel_vec3_keys.end());
+            resample_keys(ainode_anim->mScalingKeys,
+                ainode_anim->mNumScalingKeys,
+                anim.duration_ticks,
+                anim.nbr_samples,
+                glm::vec3{ 1.0f },
+                channel_vec3_keys,
+                aivec_to_glmvec,
+                [](const glm::vec3& a, const glm::vec3& b, float t) { return glm::mix(a, b, t); });
+            scale_keys.insert(scale_keys.end(), channel_vec3_keys.begin(), channel_vec3_keys.end());
+            resample_keys(ainode_anim->mRotationKeys,
+                ainode_anim->mNumRotationKeys,
+                anim.duration_ticks,
+                anim.nbr_samples,
+                glm::quat{ 1.0f, 0.0f, 0.0f, 0.0f },
+                channel_quat_keys,
+                aiquat_to_glmquat,
+                [](const glm::quat& a, const glm::quat& b, float t) { return glm::slerp(a, b, t); });
+            rot_keys.insert(rot_keys.end(), channel_quat_keys.begin(), channel_quat_keys.end());
+
+            anim.channel_names.push_back(name);
+            anim.channels.push_back(channel);
+        }
+
+        anim.keys.resize(pos_keys.size());
+        std::copy(pos_keys.begin(), pos_keys.end(), anim.keys.positions());
+        std::copy(rot_keys.begin(), rot_keys.end(), anim.keys.rotations());
+        std::copy(scale_keys.begin(), scale_keys.end(), anim.keys.scales());
+
+        if (compress && m_compression.enabled)
+            compressClip(anim);
+        else
+            log << priority(PRTSTRICT) << "Animation '" << anim.name << "', " << anim.byteSize() << " bytes" << std::endl;
+
+        return anim_ptr;
+    }
+
+    void RenderableMesh::compressClip(ClipData& anim)
+    {
+        // Replace full-precision keys with compressed keys
+        const size_t bytes_before = anim.byteSize();
+        anim.compressed.init(anim.channels.size(), anim.nbr_samples);
+        for (const auto& channel : anim.channels)
+        {
+            anim.compressed.addChannel(
+                anim.keys.positions() + channel.key_ofs,
+                anim.keys.rotations() + channel.key_ofs,
+                anim.keys.scales() + channel.key_ofs,
+                channel.nbr_keys,
+                m_compression);
+        }
+        anim.compressed.shrink();
+        anim.channels = {};
+        anim.keys = {};
+        anim.is_compressed = true;
+
+        const size_t bytes_after = anim.byteSize();
+        log << priority(PRTSTRICT)
+            << "Compressed animation '" << anim.name
+            << "', " << bytes_before << " bytes -> " << bytes_after << " bytes ("
+            << (100.0f * bytes_after / bytes_before) << "%), "
+            << anim.compressed.nbrKeys() << " keys kept of " << (anim.compressed.nbrChannels() * anim.nbr_samples * 3)
+            << std::endl;
+    }
+
+    void RenderableMesh::addClip(const std::shared_ptr<ClipData>& data)
+    {
+        AnimationClip anim;
+        anim.data = data;
+        anim.node_channels.resize(m_nodetree.size(), EENG_NULL_INDEX);
+        for (size_t i = 0; i < data->channel_names.size(); i++)
+        {
+            const auto index = m_nodetree.find_node_index(data->channel_names[i]);
+            if (index != EENG_NULL_INDEX)
+                anim.node_channels[index] = (int)i;
+        }
+        m_animations.push_back(std::move(anim));
+    }
+
+    bool RenderableMesh::addLibraryClips(const std::string& file)
+    {
+        if (!m_clip_library)
+            return false;
+        const auto* clips = m_clip_library->find(file, m_skeleton_signature, m_sample_rate, m_compression);
+        if (!clips)
+            return false;
+
+        for (const auto& clip : *clips)
+            addClip(clip);
+        log << priority(PRTSTRICT) << "Shared " << clips->size() << " animations of " << file << " from clip library" << std::endl;
+        return true;
+    }
+
+    size_t RenderableMesh::computeSkeletonSignature() const
+    {
+        std::vector<int> parents(m_nodetree.size(), EENG_NULL_INDEX);
+        m_nodetree.traverse_progressive(
+            [&](const SkeletonNode* node, const SkeletonNode* parent_node, size_t node_index, size_t parent_index)
             {
-                aiNodeAnim* ainode_anim = aianim->mChannels[j];
-                NodeKeyframes node_anim;
-                node_anim.is_used = true;
-                auto name = std::string(ainode_anim->mNodeName.C_Str());
-
-                log << priority(PRTVERBOSE)
-                    << "\tLoading channel " << name
-                    << ", nbr pos keys  " << ainode_anim->mNumPositionKeys
-                    << ", nbr scale keys  " << ainode_anim->mNumScalingKeys
-                    << ", nbr rot keys  " << ainode_anim->mNumRotationKeys
-                    << std::endl;
-
-                for (int k = 0; k < ainode_anim->mNumPositionKeys; k++)
-                {
-                    glm::vec3 pos_key = aivec_to_glmvec(ainode_anim->mPositionKeys[k].mValue);
-                    node_anim.pos_keys.push_back(pos_key);
-                }
-                for (int k = 0; k < ainode_anim->mNumScalingKeys; k++)
-                {
-                    glm::vec3 scale_key = aivec_to_glmvec(ainode_anim->mScalingKeys[k].mValue);
-                    node_anim.scale_keys.push_back(scale_key);
-                }
-                for (int k = 0; k < ainode_anim->mNumRotationKeys; k++)
-                {
-                    glm::quat rot_key = aiquat_to_glmquat(ainode_anim->mRotationKeys[k].mValue);
-                    node_anim.rot_keys.push_back(rot_key);
-                }
+                if (parent_node)
+                    parents[node_index] = (int)parent_index;
+            });
 
-                auto index = m_nodetree.find_node_index(name);
-                if (index != EENG_NULL_INDEX)
-                    anim.node_animations[index] = node_anim;
-            }
+        // Bone nodes and their ancestors
+        std::vector<bool> in_skeleton(m_nodetree.size(), false);
+        for (const auto& bone : m_bones)
+            for (int i = bone.node_index; i != EENG_NULL_INDEX && !in_skeleton[i]; i = parents[i])
+                in_skeleton[i] = true;
 
-            m_animations.push_back(anim);
+        // Names and parent names, in pre-order
+        size_t signature = 0;
+        for (size_t i = 0; i < m_nodetree.size(); i++)
+        {
+            if (!in_skeleton[i])
+                continue;
+            const auto& parent_name = parents[i] != EENG_NULL_INDEX ?
+                m_nodetree.get_payload_at(parents[i]).name :
+                std::string();
+            signature = hash_combine(signature, m_nodetree.get_payload_at(i).name, parent_name);
         }
+        return signature;
+    }
 
-        log << priority(PRTSTRICT) << "Animations in total " << m_animations.size() << std::endl;
+    const RenderableMesh::AnimationClip* RenderableMesh::playableClip(int anim_index) const
+    {
+        if (anim_index < 0 || anim_index >= getNbrAnimations())
+            return nullptr;
+
+        const AnimationClip* anim = &m_animations[anim_index];
+        if (anim->stream && !anim->stream->requested.load(std::memory_order_relaxed))
+            anim->stream->requested.store(true, std::memory_order_relaxed);
+        return anim->clip().hasKeys() ? anim : nullptr;
+    }
+
+    bool RenderableMesh::sampleNode(
+        size_t node_index,
+        const AnimationClip* anim,
+        const ClipSample& sample,
+        uint16_t* cursors,
+        glm::vec3& pos,
+        glm::quat& rot,
+        glm::vec3& scale) const
+    {
+        const int channel_index = anim->node_channels[node_index];
+        if (channel_index == EENG_NULL_INDEX) return false;
+
+        const auto& data = anim->clip();
+        if (data.is_compressed)
+        {
+            data.compressed.sample(channel_index, sample.key0 + sample.frac, cursors, pos, rot, scale);
+            return true;
+        }
+
+        const auto& channel = data.channels[channel_index];
+        const glm::vec3* pos_keys = data.keys.positions() + channel.key_ofs;
+        const glm::quat* rot_keys = data.keys.rotations() + channel.key_ofs;
+        const glm::vec3* scale_keys = data.keys.scales() + channel.key_ofs;
+
+        // Blend keys. All channels share key indices since keys are uniformly resampled.
+        pos = glm::mix(pos_keys[sample.key0], pos_keys[sample.key1], sample.frac);
+        rot = glm::slerp(rot_keys[sample.key0], rot_keys[sample.key1], sample.frac);
+        scale = glm::mix(scale_keys[sample.key0], scale_keys[sample.key1], sample.frac);
+        return true;
     }
 
     glm::mat4 RenderableMesh::animateNode(
         size_t node_index,
         const AnimationClip* anim,
-        float ntime) const
+        const ClipSample& sample,
+        uint16_t* cursors) const
     {
         const auto& node = m_nodetree.get_payload_at(node_index);
         if (!anim) return node.local_tfm;
-        if (!anim->node_animations[node_index].is_used) return node.local_tfm;
-
-        auto& node_keyframes = anim->node_animations[node_index];
-        const auto& rot_keys = node_keyframes.rot_keys;
-        const auto& pos_keys = node_keyframes.pos_keys;
-        const auto& scale_keys = node_keyframes.scale_keys;
-        const size_t nbr_pos_keys = pos_keys.size();
-        const size_t nbr_rot_keys = rot_keys.size();
-        const size_t nbr_scale_keys = scale_keys.size();
-
-        // Blend translation keys
-        float pos_indexf = ntime * (nbr_pos_keys - 1ull);
-        size_t pos_index0 = std::floor(pos_indexf);
-        size_t pos_index1 = std::min(pos_index0 + 1ull, nbr_pos_keys - 1ull);
-        const auto blendpos = glm::mix(pos_keys[pos_index0], pos_keys[pos_index1], pos_indexf - pos_index0);
-
-        // Blend rotation keys
-        float rot_indexf = ntime * (nbr_rot_keys - 1ull);
-        size_t rot_index0 = std::floor(rot_indexf);
-        size_t rot_index1 = std::min(rot_index0 + 1ull, nbr_rot_keys - 1ull);
-        const auto blendrot = glm::slerp(rot_keys[rot_index0], rot_keys[rot_index1], rot_indexf - rot_index0);
-
-        // Blend scaling keys
-        float scale_indexf = ntime * (nbr_scale_keys - 1ull);
-        size_t scale_index0 = std::floor(scale_indexf);
-        size_t scale_index1 = std::min(scale_index0 + 1ull, nbr_scale_keys - 1ull);
-        const auto blendscale = glm::mix(scale_keys[scale_index0], scale_keys[scale_index1], scale_indexf - scale_index0);
+
+        glm::vec3 blendpos, blendscale;
+        glm::quat blendrot;
+        if (!sampleNode(node_index, anim, sample, cursors, blendpos, blendrot, blendscale))
+            return node.local_tfm;
 
         // Concatenate
         const glm::mat4 translationMatrix = glm::translate(glm::mat4(1.0f), blendpos);
@@ -975,53 +1943,23 @@ namespace eeng
         size_t node_index,
         const AnimationClip* anim0,
         const AnimationClip* anim1,
-        float ntime0,
-        float ntime1,
+        const ClipSample& sample0,
+        const ClipSample& sample1,
+        uint16_t* cursors0,
+        uint16_t* cursors1,
         float frac) const
     {
         assert(frac >= 0.0f && frac <= 1.0f);
         const auto& node = m_nodetree.get_payload_at(node_index);
 
         assert(anim0 && anim1);
-        if (!anim0->node_animations[node_index].is_used) return node.local_tfm;
-        if (!anim1->node_animations[node_index].is_used) return node.local_tfm;
-
-        const NodeKeyframes* node_keyframe[] = {
-             &anim0->node_animations[node_index],
-             &anim1->node_animations[node_index]
-        };
-        float ntime[] = { ntime0, ntime1 };
         glm::vec3 blendpos[2];
         glm::quat blendrot[2];
         glm::vec3 blendscale[2];
-
-        for (int i = 0; i < 2; i++)
-        {
-            const auto& pos_keys = node_keyframe[i]->pos_keys;
-            const auto& rot_keys = node_keyframe[i]->rot_keys;
-            const auto& scale_keys = node_keyframe[i]->scale_keys;
-            const size_t nbr_pos_keys = pos_keys.size();
-            const size_t nbr_rot_keys = rot_keys.size();
-            const size_t nbr_scale_keys = scale_keys.size();
-
-            // Blend translation keys
-            float pos_indexf = ntime[i] * (nbr_pos_keys - 1ull);
-            size_t pos_index0 = std::floor(pos_indexf);
-            size_t pos_index1 = std::min(pos_index0 + 1ull, nbr_pos_keys - 1ull);
-            blendpos[i] = glm::mix(pos_keys[pos_index0], pos_keys[pos_index1], pos_indexf - pos_index0);
-
-            // Blend rotation keys
-            float rot_indexf = ntime[i] * (nbr_rot_keys - 1ull);
-            size_t rot_index0 = std::floor(rot_indexf);
-            size_t rot_index1 = std::min(rot_index0 + 1ull, nbr_rot_keys - 1ull);
-            blendrot[i] = glm::slerp(rot_keys[rot_index0], rot_keys[rot_index1], rot_indexf - rot_index0);
-
-            // Blend scaling keys
-            float scale_indexf = ntime[i] * (nbr_scale_keys - 1ull);
-            size_t scale_index0 = std::floor(scale_indexf);
-            size_t scale_index1 = std::min(scale_index0 + 1ull, nbr_scale_keys - 1ull);
-            blendscale[i] = glm::mix(scale_keys[scale_index0], scale_keys[scale_index1], scale_indexf - scale_index0);
-        }
+        if (!sampleNode(node_index, anim0, sample0, cursors0, blendpos[0], blendrot[0], blendscale[0]))
+            return node.local_tfm;
+        if (!sampleNode(node_index, anim1, sample1, cursors1, blendpos[1], blendrot[1], blendscale[1]))
+            return node.local_tfm;
 
         // Use dual quaternions to blend rotations and translations between clips
         glm::dualquat dqA = glm::dualquat(blendrot[0], blendpos[0]);
@@ -1035,74 +1973,275 @@ namespace eeng
         return M;
     }
 
-    void RenderableMesh::animate(
-        int anim_index,
-        float time,
-        AnmationTimeFormat animTimeFormat)
+    void RenderableMesh::animateNodesSimd(
+        AnimationPose& pose,
+        const AnimationClip* anim,
+        const ClipSample& sample) const
     {
-        AnimationClip* anim = nullptr;
-        if (anim_index >= 0 && anim_index < getNbrAnimations())
+        // Gather animated nodes in groups of PoseEvaluatorWidth
+        TrsKeys keys[PoseEvaluatorWidth];
+        Affine* out[PoseEvaluatorWidth];
+        size_t count = 0;
+
+        for (size_t i : m_animated_nodes)
         {
-            anim = &m_animations[anim_index];
+            if (isNodeSkipped(pose, i))
+                continue;
+
+            const int channel_index = anim->node_channels[i];
+            if (channel_index == EENG_NULL_INDEX)
+            {
+                pose.local_tfms[i] = Affine(m_nodetree.get_payload_at(i).local_tfm);
+                continue;
+            }
+
+            keys[count] = anim->keysAt(channel_index, sample);
+            out[count] = &pose.local_tfms[i];
+            if (++count == PoseEvaluatorWidth)
+            {
+                evaluate_trs(keys, count, sample.frac, out);
+                count = 0;
+            }
         }
+        evaluate_trs(keys, count, sample.frac, out);
+    }
 
-        // Convert to normalized time
-        float ntime = time;
-        if (anim && animTimeFormat == AnmationTimeFormat::RealTime)
+    void RenderableMesh::animateBlendNodesSimd(
+        AnimationPose& pose,
+        const AnimationClip* anim0,
+        const AnimationClip* anim1,
+        const ClipSample& sample0,
+        const ClipSample& sample1,
+        float frac) const
+    {
+        // Gather nodes animated by both clips in groups of PoseEvaluatorWidth
+        TrsKeys keys0[PoseEvaluatorWidth], keys1[PoseEvaluatorWidth];
+        Affine* out[PoseEvaluatorWidth];
+        size_t count = 0;
+
+        for (size_t i : m_animated_nodes)
+        {
+            if (isNodeSkipped(pose, i))
+                continue;
+
+            const int channel_index0 = anim0->node_channels[i];
+            const int channel_index1 = anim1->node_channels[i];
+            if (channel_index0 == EENG_NULL_INDEX || channel_index1 == EENG_NULL_INDEX)
+            {
+                pose.local_tfms[i] = Affine(m_nodetree.get_payload_at(i).local_tfm);
+                continue;
+            }
+
+            keys0[count] = anim0->keysAt(channel_index0, sample0);
+            keys1[count] = anim1->keysAt(channel_index1, sample1);
+            out[count] = &pose.local_tfms[i];
+            if (++count == PoseEvaluatorWidth)
+            {
+                evaluate_blend_trs(keys0, keys1, count, sample0.frac, sample1.frac, frac, out);
+                count = 0;
+            }
+        }
+        evaluate_blend_trs(keys0, keys1, count, sample0.frac, sample1.frac, frac, out);
+    }
+
+    uint16_t* RenderableMesh::keyCursors(
+        AnimationPose& pose,
+        int slot,
+        int anim_index) const
+    {
+        return keyCursors(pose.key_cursors[slot], anim_index);
+    }
+
+    uint16_t* RenderableMesh::keyCursors(
+        AnimationPose::KeyCursors& cursors,
+        int anim_index) const
+    {
+        if (anim_index < 0 || anim_index >= getNbrAnimations()) return nullptr;
+        const auto& data = m_animations[anim_index].clip();
+        if (!data.is_compressed) return nullptr;
+
+        // Cursors are reset when switching to another clip
+        if (cursors.clip_index != anim_index || cursors.keys.size() != data.compressed.nbrCursors())
         {
-            const float dur_ticks = anim->duration_ticks;
-            const float animdur_sec = dur_ticks / anim->tps;
-            const float animtime_sec = fmod(time, animdur_sec);
-            const float animtime_ticks = animtime_sec * anim->tps;
-            ntime = animtime_ticks / dur_ticks;
+            cursors.clip_index = anim_index;
+            cursors.keys.assign(data.compressed.nbrCursors(), 0);
         }
+        return cursors.keys.data();
+    }
 
-        // Traverse the node tree and animate all nodes
+    float RenderableMesh::normalizedTime(
+        const AnimationClip* anim,
+        float time,
+        AnmationTimeFormat animTimeFormat) const
+    {
+        if (!anim || animTimeFormat != AnmationTimeFormat::RealTime)
+            return time;
+
+        const auto& data = anim->clip();
+        const float dur_ticks = data.duration_ticks;
+        const float animdur_sec = dur_ticks / data.tps;
+        const float animtime_sec = fmod(time, animdur_sec);
+        const float animtime_ticks = animtime_sec * data.tps;
+        return animtime_ticks / dur_ticks;
+    }
+
+    AnimationPose RenderableMesh::createPose() const
+    {
+        AnimationPose pose;
+        pose.local_tfms.resize(m_nodetree.size());
+        pose.global_tfms.resize(m_nodetree.size());
+        pose.bone_matrices.resize(m_bones.size());
+        pose.bone_aabbs.resize(m_bones.size());
+        pose.mesh_aabbs = m_mesh_aabbs_bind;
+
+        // Bind pose for all nodes, including those animate() never visits
         m_nodetree.traverse_progressive(
-            [&](SkeletonNode* node, SkeletonNode* parent_node, size_t node_index, size_t parent_index)
+            [&](const SkeletonNode* node, const SkeletonNode* parent_node, size_t node_index, size_t parent_index)
             {
-                node->global_tfm = animateNode(node_index, anim, ntime);
-
+                pose.local_tfms[node_index] = Affine(node->local_tfm);
                 if (parent_node)
-                    node->global_tfm = parent_node->global_tfm * node->global_tfm;
+                    pose.global_tfms[node_index] = pose.global_tfms[parent_index] * pose.local_tfms[node_index];
+                else
+                    pose.global_tfms[node_index] = pose.local_tfms[node_index];
             });
+        updatePoseBones(pose);
+        return pose;
+    }
 
-        m_model_aabb.reset();
-        for (int i = 0; i < m_bones.size(); i++)
-        {
-            const auto& node_tfm = m_nodetree.get_payload_at(m_bones[i].node_index).global_tfm;
-            const auto& boneIB_tfm = m_bones[i].inversebind_tfm;
-            glm::mat4 M = node_tfm * boneIB_tfm;
+    void RenderableMesh::animate(
+        AnimationPose& pose,
+        int anim_index,
+        float time,
+        AnmationTimeFormat animTimeFormat) const
+    {
+        EENG_ASSERT(pose.nbr_nodes() == m_nodetree.size(), "Pose does not match mesh, use createPose()");
 
-            // Bone matrices
-            boneMatrices[i] = M;
+        const AnimationClip* anim = playableClip(anim_index);
 
-            // AABBs
-            if (m_bone_aabbs_bind[i])
-            {
-                m_bone_aabbs_pose[i] = m_bone_aabbs_bind[i].post_transform(glm::vec3(M[3]), glm::mat3(M));
-                m_model_aabb.grow(m_bone_aabbs_pose[i]);
-            }
+        // Convert to normalized time and locate keys
+        const float ntime = normalizedTime(anim, time, animTimeFormat);
+        const ClipSample sample = (anim ? anim->sampleAt(ntime) : ClipSample{});
+        uint16_t* cursors = keyCursors(pose, 0, anim_index);
+
+        // Sample local transforms of all nodes
+        if (anim && !anim->clip().is_compressed && m_evaluator == AnimationEvaluator::Simd)
+            animateNodesSimd(pose, anim, sample);
+        else
+            for (size_t i : m_animated_nodes)
+                if (!isNodeSkipped(pose, i))
+                    pose.local_tfms[i] = Affine(animateNode(i, anim, sample, cursors));
+
+        updatePoseGlobals(pose);
+        updatePoseBones(pose);
+    }
+
+    void RenderableMesh::animateBlend(
+        AnimationPose& pose,
+        int anim_index0,
+        int anim_index1,
+        float time0,
+        float time1,
+        float frac,
+        AnmationTimeFormat animTimeFormat0,
+        AnmationTimeFormat animTimeFormat1) const
+    {
+        EENG_ASSERT(pose.nbr_nodes() == m_nodetree.size(), "Pose does not match mesh, use createPose()");
+        EENG_ASSERT(anim_index0 >= 0 && anim_index0 < getNbrAnimations(), "{0} is not a valid clip index", anim_index0);
+        EENG_ASSERT(anim_index1 >= 0 && anim_index1 < getNbrAnimations(), "{0} is not a valid clip index", anim_index1);
+
+        // Streamed clips that are not loaded yet play the other clip, or the bind pose
+        const AnimationClip* anim0 = playableClip(anim_index0);
+        const AnimationClip* anim1 = playableClip(anim_index1);
+        if (!anim0 || !anim1)
+        {
+            if (anim0)
+                animate(pose, anim_index0, time0, animTimeFormat0);
+            else
+                animate(pose, anim1 ? anim_index1 : -1, time1, animTimeFormat1);
+            return;
         }
 
-        // Puts mesh AABB's in pose and have them grow model AABB
-        for (int i = 0; i < m_meshes.size(); i++)
+        // Convert to normalized time
+        const float ntime0 = normalizedTime(anim0, time0, animTimeFormat0);
+        const float ntime1 = normalizedTime(anim1, time1, animTimeFormat1);
+        const ClipSample sample0 = anim0->sampleAt(ntime0);
+        const ClipSample sample1 = anim1->sampleAt(ntime1);
+        uint16_t* cursors0 = keyCursors(pose, 0, anim_index0);
+        uint16_t* cursors1 = keyCursors(pose, 1, anim_index1);
+
+        // Sample and blend local transforms of all nodes
+        if (!anim0->clip().is_compressed && !anim1->clip().is_compressed && m_evaluator == AnimationEvaluator::Simd)
+            animateBlendNodesSimd(pose, anim0, anim1, sample0, sample1, frac);
+        else
+            for (size_t i : m_animated_nodes)
+                if (!isNodeSkipped(pose, i))
+                    pose.local_tfms[i] = Affine(animateBlendNode(i, anim0, anim1, sample0, sample1, cursors0, cursors1, frac));
+
+        updatePoseGlobals(pose);
+        updatePoseBones(pose);
+    }
+
+    void RenderableMesh::sampleLocalPose(
+        LocalPose& local,
+        int anim_index,
+        float time,
+        AnmationTimeFormat animTimeFormat,
+        AnimationPose::KeyCursors& cursors,
+        float min_reach) const
+    {
+        local.resize(m_nodetree.size());
+
+        const AnimationClip* anim = playableClip(anim_index);
+
+        const float ntime = normalizedTime(anim, time, animTimeFormat);
+        const ClipSample sample = (anim ? anim->sampleAt(ntime) : ClipSample{});
+        uint16_t* clip_cursors = keyCursors(cursors, anim_index);
+
+        for (size_t i : m_animated_nodes)
         {
-            if (!m_mesh_aabbs_bind[i])
-                continue;
-            if (m_meshes[i].is_skinned)
+            if (m_node_reach[i] < min_reach)
                 continue;
 
-            if (m_meshes[i].node_index > EENG_NULL_INDEX)
+            if (!anim || !sampleNode(i, anim, sample, clip_cursors, local.positions[i], local.rotations[i], local.scales[i]))
             {
-                glm::mat4 M = m_nodetree.get_payload_at(m_meshes[i].node_index).global_tfm;
-                m_mesh_aabbs_pose[i] = m_mesh_aabbs_bind[i].post_transform(glm::vec3(M[3]), glm::mat3(M));
+                local.positions[i] = m_bind_local.positions[i];
+                local.rotations[i] = m_bind_local.rotations[i];
+                local.scales[i] = m_bind_local.scales[i];
             }
-            else
-                m_mesh_aabbs_pose[i] = m_mesh_aabbs_bind[i];
+        }
+    }
+
+    void RenderableMesh::applyLocalPose(
+        AnimationPose& pose,
+        const LocalPose& local) const
+    {
+        EENG_ASSERT(pose.nbr_nodes() == m_nodetree.size(), "Pose does not match mesh, use createPose()");
+        EENG_ASSERT(local.nbr_nodes() == m_nodetree.size(), "Local pose does not match mesh");
 
-            m_model_aabb.grow(m_mesh_aabbs_pose[i]);
+        for (size_t i : m_animated_nodes)
+        {
+            if (isNodeSkipped(pose, i))
+                continue;
+
+            // T * R * S, with rows laid out as in Affine
+            const glm::mat3 R = glm::mat3_cast(local.rotations[i]);
+            const glm::vec3& t = local.positions[i];
+            const glm::vec3& s = local.scales[i];
+            auto& rows = pose.local_tfms[i].rows;
+            for (int r = 0; r < 3; r++)
+                rows[r] = glm::vec4(R[0][r] * s.x, R[1][r] * s.y, R[2][r] * s.z, t[r]);
         }
+
+        updatePoseGlobals(pose);
+        updatePoseBones(pose);
+    }
+
+    void RenderableMesh::animate(
+        int anim_index,
+        float time,
+        AnmationTimeFormat animTimeFormat)
+    {
+        animate(m_pose, anim_index, time, animTimeFormat);
     }
 
     void RenderableMesh::animateBlend(
@@ -1114,78 +2253,428 @@ namespace eeng
         AnmationTimeFormat animTimeFormat0,
         AnmationTimeFormat animTimeFormat1)
     {
-        EENG_ASSERT(anim_index0 >= 0 && anim_index0 < getNbrAnimations(), "{0} is not a valid clip index", anim_index0);
-        EENG_ASSERT(anim_index1 >= 0 && anim_index1 < getNbrAnimations(), "{0} is not a valid clip index", anim_index1);
+        animateBlend(m_pose, anim_index0, anim_index1, time0, time1, frac, animTimeFormat0, animTimeFormat1);
+    }
 
-        AnimationClip* anim0 = &m_animations[anim_index0];
-        AnimationClip* anim1 = &m_animations[anim_index1];
+    void RenderableMesh::computeNodeReach()
+    {
+        // Bind-pose node positions and parents
+        const size_t nbr_nodes = m_nodetree.size();
+        std::vector<glm::mat4> global_tfms(nbr_nodes);
+        std::vector<int> parents(nbr_nodes, EENG_NULL_INDEX);
+        m_nodetree.traverse_progressive(
+            [&](const SkeletonNode* node, const SkeletonNode* parent_node, size_t node_index, size_t parent_index)
+            {
+                if (parent_node)
+                {
+                    global_tfms[node_index] = global_tfms[parent_index] * node->local_tfm;
+                    parents[node_index] = (int)parent_index;
+                }
+                else
+                    global_tfms[node_index] = node->local_tfm;
+            });
 
-        // Convert to normalized time
-        float ntime0 = time0;
-        float ntime1 = time1;
-        if (anim0 && animTimeFormat0 == AnmationTimeFormat::RealTime)
+        // Nodes are stored in pre-order, so a reverse sweep visits children before parents
+        std::vector<float> reach(nbr_nodes, 0.0f);
+        for (size_t i = nbr_nodes; i-- > 0; )
         {
-            const float dur_ticks = anim0->duration_ticks;
-            const float animdur_sec = dur_ticks / anim0->tps;
-            const float animtime_sec = fmod(time0, animdur_sec);
-            const float animtime_ticks = animtime_sec * anim0->tps;
-            ntime0 = animtime_ticks / dur_ticks;
+            if (parents[i] == EENG_NULL_INDEX) continue;
+            const float bone_length = glm::length(glm::vec3(global_tfms[i][3] - global_tfms[parents[i]][3]));
+            reach[parents[i]] = std::max(reach[parents[i]], reach[i] + bone_length);
         }
-        if (anim1 && animTimeFormat1 == AnmationTimeFormat::RealTime)
+
+        const float model_size = 2.0f * mSceneAABB.getBoundingSphere().w;
+        m_node_reach.resize(nbr_nodes);
+        for (size_t i = 0; i < nbr_nodes; i++)
         {
-            const float dur_ticks = anim1->duration_ticks;
-            const float animdur_sec = dur_ticks / anim1->tps;
-            const float animtime_sec = fmod(time1, animdur_sec);
-            const float animtime_ticks = animtime_sec * anim1->tps;
-            ntime1 = animtime_ticks / dur_ticks;
+            // Nodes with meshes attached are never skipped
+            if (m_nodetree.get_payload_at(i).nbr_meshes)
+                m_node_reach[i] = FLT_MAX;
+            else
+                m_node_reach[i] = (model_size > 0.0f ? reach[i] / model_size : 0.0f);
         }
+    }
 
-        // Traverse the node tree and animate all nodes
+    void RenderableMesh::computeBindLocalPose()
+    {
+        m_bind_local.resize(m_nodetree.size());
+        for (size_t i = 0; i < m_nodetree.size(); i++)
+        {
+            // Decompose into T * R * S, assuming no shear
+            const glm::mat4& M = m_nodetree.get_payload_at(i).local_tfm;
+            const glm::vec3 s = { glm::length(glm::vec3(M[0])), glm::length(glm::vec3(M[1])), glm::length(glm::vec3(M[2])) };
+            const glm::mat3 R = {
+                s.x > 0.0f ? glm::vec3(M[0]) / s.x : glm::vec3(1.0f, 0.0f, 0.0f),
+                s.y > 0.0f ? glm::vec3(M[1]) / s.y : glm::vec3(0.0f, 1.0f, 0.0f),
+                s.z > 0.0f ? glm::vec3(M[2]) / s.z : glm::vec3(0.0f, 0.0f, 1.0f) };
+            m_bind_local.positions[i] = glm::vec3(M[3]);
+            m_bind_local.rotations[i] = glm::normalize(glm::quat_cast(R));
+            m_bind_local.scales[i] = s;
+        }
+    }
+
+    void RenderableMesh::buildEvalList()
+    {
+        const size_t nbr_nodes = m_nodetree.size();
+        std::vector<int> parents(nbr_nodes, EENG_NULL_INDEX);
         m_nodetree.traverse_progressive(
-            [&](SkeletonNode* node, SkeletonNode* parent_node, size_t node_index, size_t parent_index)
+            [&](const SkeletonNode* node, const SkeletonNode* parent_node, size_t node_index, size_t parent_index)
             {
-                node->global_tfm = animateBlendNode(node_index, anim0, anim1, ntime0, ntime1, frac);
-
                 if (parent_node)
-                    node->global_tfm = parent_node->global_tfm * node->global_tfm;
+                    parents[node_index] = (int)parent_index;
             });
 
-        m_model_aabb.reset();
+        // Nodes read by bones and meshes, and their ancestors.
+        // Nodes are stored in pre-order, so a reverse sweep visits children before parents.
+        std::vector<bool> is_read(nbr_nodes, false), is_animated(nbr_nodes, false);
+        for (const auto& bone : m_bones)
+            is_read[bone.node_index] = true;
+        for (size_t i = 0; i < nbr_nodes; i++)
+            if (m_nodetree.get_payload_at(i).nbr_meshes)
+                is_read[i] = true;
+        std::vector<bool> is_needed = is_read;
+        for (size_t i = nbr_nodes; i-- > 0; )
+            if (is_needed[i] && parents[i] != EENG_NULL_INDEX)
+                is_needed[parents[i]] = true;
+
+        for (const auto& anim : m_animations)
+            for (size_t i = 0; i < nbr_nodes; i++)
+                if (anim.animatesNode(i))
+                    is_animated[i] = true;
+
+        // Fold chains of static nodes into one offset per node, relative
+        // the nearest animated ancestor. Static nodes are only kept if read
+        // and if they have an animated ancestor (otherwise they never change).
+        std::vector<int> ancestors(nbr_nodes, EENG_NULL_INDEX);
+        std::vector<Affine> offsets(nbr_nodes);     // From the ancestor, including the node if static
+        m_eval_nodes.clear();
+        m_animated_nodes.clear();
+        for (size_t i = 0; i < nbr_nodes; i++)
+        {
+            const int parent = parents[i];
+            NodeEval eval;
+            eval.node_index = (uint32_t)i;
+            eval.is_animated = is_animated[i];
+            if (parent != EENG_NULL_INDEX && is_animated[parent])
+                eval.ancestor = parent;
+            else if (parent != EENG_NULL_INDEX)
+            {
+                eval.ancestor = ancestors[parent];
+                eval.offset = offsets[parent];
+                eval.has_offset = true;
+            }
+
+            ancestors[i] = eval.ancestor;
+            if (!eval.is_animated)
+            {
+                eval.offset = eval.offset * Affine(m_nodetree.get_payload_at(i).local_tfm);
+                eval.has_offset = true;
+            }
+            offsets[i] = eval.offset;
+
+            const bool keep = eval.is_animated ?
+                is_needed[i] :
+                is_read[i] && eval.ancestor != EENG_NULL_INDEX;
+            if (!keep)
+                continue;
+            m_eval_nodes.push_back(eval);
+            if (eval.is_animated)
+                m_animated_nodes.push_back((uint32_t)i);
+        }
+
+        log << priority(PRTSTRICT) << "Evaluation list: " << m_eval_nodes.size() << " of "
+            << nbr_nodes << " nodes, " << m_animated_nodes.size() << " animated" << std::endl;
+    }
+
+    void RenderableMesh::updatePoseGlobals(AnimationPose& pose) const
+    {
+        // Concatenate transforms of the nodes that lead to bones and meshes.
+        // The list is in pre-order, so ancestors are visited before descendants.
+        for (const auto& eval : m_eval_nodes)
+        {
+            auto& global_tfm = pose.global_tfms[eval.node_index];
+            if (eval.ancestor == EENG_NULL_INDEX)
+                global_tfm = eval.offset;
+            else if (eval.has_offset)
+                global_tfm = pose.global_tfms[eval.ancestor] * eval.offset;
+            else
+                global_tfm = pose.global_tfms[eval.ancestor];
+
+            if (eval.is_animated)
+                global_tfm = global_tfm * pose.local_tfms[eval.node_index];
+        }
+    }
+
+    void RenderableMesh::buildPoseBounds()
+    {
+        m_bone_bounds.clear();
+        for (uint32_t i = 0; i < m_bones.size(); i++)
+            m_bone_bounds.add(m_bone_aabbs_bind[i], i, i);
+        m_bone_bounds.pad();
+
+        // Meshes without a node keep their bind AABB
+        m_mesh_bounds.clear();
+        m_static_bounds.reset();
+        for (uint32_t i = 0; i < m_meshes.size(); i++)
+        {
+            if (m_meshes[i].is_skinned || !m_mesh_aabbs_bind[i])
+                continue;
+            if (m_meshes[i].node_index > EENG_NULL_INDEX)
+                m_mesh_bounds.add(m_mesh_aabbs_bind[i], m_meshes[i].node_index, i);
+            else
+                m_static_bounds.grow(m_mesh_aabbs_bind[i]);
+        }
+        m_mesh_bounds.pad();
+    }
+
+    void RenderableMesh::updatePoseBones(AnimationPose& pose) const
+    {
+        // Bone matrices
         for (int i = 0; i < m_bones.size(); i++)
         {
-            const auto& node_tfm = m_nodetree.get_payload_at(m_bones[i].node_index).global_tfm;
+            const auto& node_tfm = pose.global_tfms[m_bones[i].node_index];
             const auto& boneIB_tfm = m_bones[i].inversebind_tfm;
-            glm::mat4 M = node_tfm * boneIB_tfm;
+            pose.bone_matrices[i] = node_tfm * boneIB_tfm;
+        }
+
+        // Bone and mesh AABB's, merged into the model AABB
+        pose.model_aabb = m_static_bounds;
+        transform_aabbs(m_bone_bounds,
+            pose.bone_matrices.data(),
+            pose.part_aabbs ? pose.bone_aabbs.data() : nullptr,
+            pose.model_aabb);
+        transform_aabbs(m_mesh_bounds,
+            pose.global_tfms.data(),
+            pose.part_aabbs ? pose.mesh_aabbs.data() : nullptr,
+            pose.model_aabb);
+    }
 
-            // Bone matrices
-            boneMatrices[i] = M;
+    void RenderableMesh::skin(
+        const AnimationPose& pose,
+        std::span<glm::vec3> out_positions,
+        std::span<glm::vec3> out_normals,
+        ThreadPool* pool) const
+    {
+        // Vertices per work chunk when skinning on a pool
+        const size_t grain_size = 4096;
 
-            // AABBs
-            if (m_bone_aabbs_bind[i])
+        EENG_ASSERT(hasCpuGeometry(), "Mesh has no CPU geometry, load with xi_keep_cpu_geometry");
+        EENG_ASSERT(out_positions.size() >= getNbrVertices(), "Position output too small");
+        EENG_ASSERT(out_normals.empty() || out_normals.size() >= getNbrVertices(), "Normal output too small");
+
+        const bool with_normals = !out_normals.empty();
+        const SkinInfluences influences{
+            reinterpret_cast<const uint32_t*>(m_cpu_skin[0].bone_indices),
+            m_cpu_skin[0].bone_weights,
+            sizeof(SkinData) / sizeof(float) };
+
+        for (const auto& mesh : m_meshes)
+        {
+            const size_t base = mesh.base_vertex;
+            const glm::vec3* normals = with_normals ? m_cpu_normals.data() + base : nullptr;
+            glm::vec3* skinned_normals = with_normals ? out_normals.data() + base : nullptr;
+
+            if (!mesh.is_skinned)
             {
-                m_bone_aabbs_pose[i] = m_bone_aabbs_bind[i].post_transform(glm::vec3(M[3]), glm::mat3(M));
-                m_model_aabb.grow(m_bone_aabbs_pose[i]);
+                const Affine M = mesh.node_index != EENG_NULL_INDEX ? pose.global_tfms[mesh.node_index] : Affine();
+                transform_vertices(M,
+                    m_cpu_positions.data() + base,
+                    normals,
+                    mesh.nbr_vertices,
+                    out_positions.data() + base,
+                    skinned_normals);
+                continue;
             }
+
+            const auto skin_range = [&](size_t begin, size_t end)
+                {
+                    const SkinInfluences range_influences{
+                        influences.indices + (base + begin) * influences.stride,
+                        influences.weights + (base + begin) * influences.stride,
+                        influences.stride };
+                    skin_vertices(pose.bone_matrices.data(),
+                        range_influences,
+                        m_cpu_positions.data() + base + begin,
+                        normals ? normals + begin : nullptr,
+                        end - begin,
+                        out_positions.data() + base + begin,
+                        skinned_normals ? skinned_normals + begin : nullptr);
+                };
+
+            if (pool && mesh.nbr_vertices > grain_size)
+                pool->parallelFor(mesh.nbr_vertices, grain_size, skin_range);
+            else
+                skin_range(0, mesh.nbr_vertices);
         }
+    }
 
-        // Puts mesh AABB's in pose and have them grow model AABB
-        for (int i = 0; i < m_meshes.size(); i++)
+    int RenderableMesh::findMorphTarget(const std::string& name) const
+    {
+        for (size_t i = 0; i < m_morph_targets.size(); i++)
+            if (m_morph_targets[i].name == name)
+                return (int)i;
+        return EENG_NULL_INDEX;
+    }
+
+    void RenderableMesh::setMorphWeight(unsigned i, float weight)
+    {
+        EENG_ASSERT(i < m_morph_weights.size(), "Invalid morph target {0}", i);
+        m_morph_weights[i] = weight;
+    }
+
+    void RenderableMesh::updateMorphTargets()
+    {
+        // Vertices moved by targets with changed weights
+        uint32_t begin = UINT32_MAX, end = 0;
+        for (size_t i = 0; i < m_morph_targets.size(); i++)
         {
-            if (!m_mesh_aabbs_bind[i])
+            if (m_morph_weights[i] == m_morph_applied_weights[i] || m_morph_targets[i].runs.empty())
                 continue;
-            if (m_meshes[i].is_skinned)
+            begin = std::min(begin, m_morph_targets[i].begin);
+            end = std::max(end, m_morph_targets[i].end);
+        }
+        m_morph_applied_weights = m_morph_weights;
+        if (begin >= end)
+            return;
+
+        // Restore the base attributes and add the active targets that overlap
+        const size_t ofs = begin - m_morph_begin;
+        const size_t count = end - begin;
+        std::copy_n(m_morph_base_positions.begin() + ofs, count, m_morph_positions.begin() + ofs);
+        std::copy_n(m_morph_base_normals.begin() + ofs, count, m_morph_normals.begin() + ofs);
+        for (size_t i = 0; i < m_morph_targets.size(); i++)
+        {
+            const auto& target = m_morph_targets[i];
+            if (m_morph_weights[i] == 0.0f || target.end <= begin || target.begin >= end)
                 continue;
+            accumulate_morph_target(target,
+                m_morph_weights[i],
+                m_morph_begin,
+                m_morph_positions.data(),
+                m_morph_normals.data(),
+                begin,
+                end);
+        }
 
-            if (m_meshes[i].node_index > EENG_NULL_INDEX)
+        if (hasCpuGeometry())
+        {
+            std::copy_n(m_morph_positions.begin() + ofs, count, m_cpu_positions.begin() + begin);
+            std::copy_n(m_morph_normals.begin() + ofs, count, m_cpu_normals.begin() + begin);
+        }
+        if (m_headless)
+            return;
+
+        // Write positions and normals into the interleaved vertices, leaving other attributes as they are
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[VertexBuffer]);
+        auto* vertices = static_cast<PackedVertex*>(glMapBufferRange(GL_ARRAY_BUFFER,
+            begin * sizeof(PackedVertex),
+            count * sizeof(PackedVertex),
+            GL_MAP_WRITE_BIT));
+        EENG_ASSERT(vertices, "Failed to map vertices {0} to {1}", begin, end);
+        for (size_t i = 0; i < count; i++)
+        {
+            vertices[i].position = m_morph_positions[ofs + i];
+            vertices[i].normal = pack_direction(m_morph_normals[ofs + i]);
+        }
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    unsigned RenderableMesh::addMorphTarget(
+        const std::string& name,
+        std::span<const uint32_t> vertices,
+        std::span<const glm::vec3> position_deltas,
+        std::span<const glm::vec3> normal_deltas)
+    {
+        EENG_ASSERT(hasCpuGeometry(), "Mesh has no CPU geometry, load with xi_keep_cpu_geometry");
+        EENG_ASSERT(std::all_of(m_morph_applied_weights.begin(), m_morph_applied_weights.end(), [](float w) { return w == 0.0f; }),
+            "Morph targets must be added before weights are applied");
+        EENG_ASSERT(position_deltas.size() == vertices.size(), "Expected {0} position deltas", vertices.size());
+        EENG_ASSERT(normal_deltas.empty() || normal_deltas.size() == vertices.size(), "Expected {0} normal deltas", vertices.size());
+        EENG_ASSERT(vertices.empty() || vertices.back() < getNbrVertices(), "Vertex {0} out of range", vertices.back());
+
+        m_morph_targets.push_back(make_morph_target(name, vertices, position_deltas, normal_deltas));
+        m_morph_weights.push_back(0.0f);
+        m_morph_applied_weights.push_back(0.0f);
+        initMorphRange(m_cpu_positions.data(), m_cpu_normals.data());
+        return (unsigned)m_morph_targets.size() - 1;
+    }
+
+    void RenderableMesh::loadMorphTargets(const aiScene* aiscene,
+        const std::vector<glm::vec3>& scene_positions,
+        const std::vector<glm::vec3>& scene_normals)
+    {
+        const auto moved = [](const glm::vec3& d)
             {
-                glm::mat4 M = m_nodetree.get_payload_at(m_meshes[i].node_index).global_tfm;
-                m_mesh_aabbs_pose[i] = m_mesh_aabbs_bind[i].post_transform(glm::vec3(M[3]), glm::mat3(M));
+                return std::abs(d.x) > MorphDeltaEpsilon || std::abs(d.y) > MorphDeltaEpsilon || std::abs(d.z) > MorphDeltaEpsilon;
+            };
+
+        std::vector<uint32_t> vertices;
+        std::vector<glm::vec3> position_deltas, normal_deltas;
+        for (unsigned i = 0; i < m_meshes.size(); i++)
+        {
+            const aiMesh* aimesh = aiscene->mMeshes[i];
+            const uint32_t base = m_meshes[i].base_vertex;
+
+            for (unsigned k = 0; k < aimesh->mNumAnimMeshes; k++)
+            {
+                // Anim meshes hold absolute attributes, so only vertices that differ are kept
+                const aiAnimMesh* aianimmesh = aimesh->mAnimMeshes[k];
+                if (!aianimmesh->HasPositions())
+                    continue;
+                const bool has_normals = aianimmesh->HasNormals();
+                const unsigned nbr_vertices = std::min(aianimmesh->mNumVertices, aimesh->mNumVertices);
+
+                vertices.clear();
+                position_deltas.clear();
+                normal_deltas.clear();
+                for (unsigned v = 0; v < nbr_vertices; v++)
+                {
+                    const glm::vec3 dp = aivec_to_glmvec(aianimmesh->mVertices[v]) - scene_positions[base + v];
+                    const glm::vec3 dn = has_normals ? aivec_to_glmvec(aianimmesh->mNormals[v]) - scene_normals[base + v] : glm::vec3(0.0f);
+                    if (!moved(dp) && !moved(dn))
+                        continue;
+                    vertices.push_back(base + v);
+                    position_deltas.push_back(dp);
+                    if (has_normals)
+                        normal_deltas.push_back(dn);
+                }
+
+                const std::string name = aianimmesh->mName.length
+                    ? aianimmesh->mName.C_Str()
+                    : std::string(aimesh->mName.C_Str()) + "_morph" + std::to_string(k);
+                m_morph_targets.push_back(make_morph_target(name, vertices, position_deltas, normal_deltas));
+
+                log << priority(PRTVERBOSE) << "Morph target " << name
+                    << ", moves " << vertices.size() << " of " << aimesh->mNumVertices << " vertices"
+                    << ", " << m_morph_targets.back().runs.size() << " runs" << std::endl;
             }
-            else
-                m_mesh_aabbs_pose[i] = m_mesh_aabbs_bind[i];
+        }
 
-            m_model_aabb.grow(m_mesh_aabbs_pose[i]);
+        m_morph_weights.assign(m_morph_targets.size(), 0.0f);
+        m_morph_applied_weights.assign(m_morph_targets.size(), 0.0f);
+        initMorphRange(scene_positions.data(), scene_normals.data());
+    }
+
+    void RenderableMesh::initMorphRange(const glm::vec3* positions, const glm::vec3* normals)
+    {
+        uint32_t begin = UINT32_MAX, end = 0;
+        for (const auto& target : m_morph_targets)
+        {
+            if (target.runs.empty())
+                continue;
+            begin = std::min(begin, target.begin);
+            end = std::max(end, target.end);
         }
+        if (begin >= end)
+            begin = end = 0;
+
+        m_morph_begin = begin;
+        m_morph_end = end;
+        m_morph_base_positions.assign(positions + begin, positions + end);
+        m_morph_base_normals.assign(normals + begin, normals + end);
+        m_morph_positions = m_morph_base_positions;
+        m_morph_normals = m_morph_base_normals;
     }
 
     unsigned RenderableMesh::getNbrAnimations() const
@@ -1195,13 +2684,20 @@ namespace eeng
 
     std::string RenderableMesh::getAnimationName(unsigned i) const
     {
-        return (i < getNbrAnimations() ? m_animations[i].name : "");
+        return (i < getNbrAnimations() ? m_animations[i].data->name : "");
+    }
+
+    float RenderableMesh::getAnimationDuration(unsigned i) const
+    {
+        return (i < getNbrAnimations() ? m_animations[i].data->duration_ticks / m_animations[i].data->tps : 0.0f);
     }
 
     RenderableMesh::~RenderableMesh()
     {
-        for (auto& t : m_textures)
-            t.free();
+        // Shared textures are freed with their last user
+        for (size_t i = 0; i < m_textures.size(); i++)
+            if (!m_shared_textures[i])
+                m_textures[i].free();
 
         if (m_Buffers[0] != 0)
         {
@@ -5,6 +5,8 @@
 #define RenderableMesh_hpp
 
 #include <vector>
+#include <memory>
+#include <span>
 #include <unordered_map>
 #include <string>
 
@@ -15,6 +17,12 @@
 
 #include "glcommon.h"
 #include "AABB.h"
+#include "AabbSoA.hpp"
+#include "AnimationCompression.hpp"
+#include "AnimationPose.hpp"
+#include "CpuSkinning.hpp"
+#include "MorphTargets.hpp"
+#include "PoseEvaluator.hpp"
 #include "Texture.hpp"
 #include "VecTree.h"
 #include "logstreamer.h"
@@ -34,7 +42,6 @@ namespace eeng
     struct SkeletonNode // : public TreeNode
     {
         glm::mat4 local_tfm;
-        glm::mat4 global_tfm{ 1.0f };
 
         int bone_index = EENG_NULL_INDEX;
         int nbr_meshes = 0;
@@ -78,9 +85,41 @@ namespace eeng
     enum xiContentFlags
     {
         xi_load_meshes = 0x1,
-        xi_load_animations = 0x2
+        xi_load_animations = 0x2,
+        xi_headless = 0x4,          // Skip GL buffers and textures (no GL context needed)
+        xi_keep_cpu_geometry = 0x8, // Keep positions, normals and skin data on the CPU, for skin()
+        xi_defer_upload = 0x10      // Create GL buffers and textures in uploadPending(), so load() needs no GL context
     };
 
+    /// Assimp post-processing used by RenderableMesh::load(file, bool)
+    const unsigned DefaultAiFlags =
+        aiProcess_CalcTangentSpace |
+        aiProcess_GenNormals |
+        aiProcess_JoinIdenticalVertices |
+        aiProcess_Triangulate /* Must be here for render geometry */ |
+        aiProcess_GenUVCoords |
+        aiProcess_SortByPType |
+        aiProcess_FlipUVs |
+        aiProcess_OptimizeGraph;
+
+    /// Default rate, in samples per second, that animation clips are resampled to
+    const float DefaultAnimationSampleRate = 30.0f;
+
+    /// Default weight below which bone influences are pruned when a mesh is loaded
+    const float DefaultSkinWeightThreshold = 0.01f;
+
+    /// Skinning variants of the vertex shader, by bone influences per vertex
+    enum SkinVariant
+    {
+        Skin1 = 0,
+        Skin2,
+        Skin4,
+        SkinVariantCount
+    };
+
+    /// Bone influences per vertex of each SkinVariant
+    const int SkinVariantInfluences[SkinVariantCount] = { 1, 2, 4 };
+
     /// @brief Interpretation of time when mapping to keyframes
     /// Real-time means that (t = 0) maps to the first keyframe, 
     /// and (t = clip duration) maps to the last keyframe.
@@ -92,21 +131,25 @@ namespace eeng
         NormalizedTime
     };
 
+    class ThreadPool;
+    class ClipLibrary;
+    class ResourceCache;
+    class ClipStreamer;
+    struct StreamedClip;
+
     /// @brief A model loaded from file prepared with GL textures and buffers
     class RenderableMesh
     {
         friend class ForwardRenderer;
+        friend class ClipLibrary;
+        friend class ClipStreamer;
+        friend struct StreamedClip;
 
     private:
         enum
         {
             IndexBuffer,
-            PositionBuffer,
-            NormalBuffer,
-            TangentBuffer,
-            BinormalBuffer,
-            TexturecoordBuffer,
-            BoneBuffer,
+            VertexBuffer,       // Interleaved PackedVertex
             BufferCount
         };
 
@@ -122,12 +165,22 @@ namespace eeng
             int mtl_index = -1;
             int node_index = -1;
             bool is_skinned = false;
+
+            /// Triangles of skinned submeshes are grouped by the most bone
+            /// influences of their vertices, one range of indices per SkinVariant.
+            /// Non-skinned submeshes are in the Skin1 range.
+            struct IndexRange
+            {
+                unsigned base_index = 0;
+                unsigned nbr_indices = 0;
+            };
+            IndexRange skin_ranges[SkinVariantCount];
         };
 
         /// Per-bone data
         struct Bone
         {
-            glm::mat4 inversebind_tfm{ 1.0f };  //!< Inverse of the global node transform in bind pose
+            Affine inversebind_tfm;             //!< Inverse of the global node transform in bind pose
             int node_index = -1;                //!< Node associated with this bone
         };
 
@@ -137,35 +190,157 @@ namespace eeng
             unsigned bone_indices[BonesPerVertex]{ 0 };
             float bone_weights[BonesPerVertex]{ 0 };
 
-            int nbr_added = 0; // For checking
             void addWeight(unsigned bone_index, float bone_weight);
+
+            /// Remove weights below a threshold, renormalize and sort by weight.
+            /// Vertices left without weights are bound to bone 0, as in the shader.
+            void prune(float threshold);
+
+            /// Number of non-zero weights
+            int nbrInfluences() const;
         };
 
-        /// Keyframe sequence for a node and an animation.
-        struct NodeKeyframes // NodeKeyframes ???
+        /// Vertex as stored in the vertex buffer, see packVertices().
+        /// Binormals are rebuilt by the shader from the normal, the tangent and its sign.
+        struct PackedVertex
         {
-            bool is_used = false;
-            std::vector<glm::vec3> pos_keys;
-            std::vector<glm::vec3> scale_keys;
-            std::vector<glm::quat> rot_keys;
+            glm::vec3 position;
+            uint16_t texcoord[2];                   //!< Half floats
+            uint32_t normal;                        //!< Signed normalized 10:10:10:2
+            uint32_t tangent;                       //!< Signed normalized 10:10:10:2, w is the binormal sign
+            uint8_t bone_indices[BonesPerVertex];
+            uint8_t bone_weights[BonesPerVertex];   //!< Unsigned normalized, summing to 255
         };
+        static_assert(sizeof(PackedVertex) == 32, "Unexpected vertex size");
 
-        /// Data related to an animation clip, including keyframes for all nodes.
-        struct AnimationClip
+        /// Vertex attributes and indices of all submeshes, in buffer order
+        struct GeometryView
+        {
+            std::span<const glm::vec3> positions, normals, tangents, binormals;
+            std::span<const glm::vec2> texcoords;
+            std::span<const SkinData> skin;
+            std::span<const uint> indices;
+        };
+
+        /// Vertex attributes and indices of all submeshes, as imported
+        struct SceneGeometry
+        {
+            std::vector<glm::vec3> positions, normals, tangents, binormals;
+            std::vector<glm::vec2> texcoords;
+            std::vector<SkinData> skin;
+            std::vector<uint> indices;
+
+            GeometryView view() const { return { positions, normals, tangents, binormals, texcoords, skin, indices }; }
+        };
+
+        /// Location of the keys of a channel (an animated node) in a KeyPool.
+        /// Keys are resampled at load, so all channels of a clip hold
+        /// the same number of uniformly spaced keys.
+        struct ChannelKeys
+        {
+            uint32_t key_ofs = 0;   //!< First key of the channel
+            uint32_t nbr_keys = 0;
+        };
+
+        /// Keys of all channels of a clip in one contiguous block, as arrays of
+        /// translations, rotations and scales, each indexed by ChannelKeys::key_ofs.
+        struct KeyPool
+        {
+            std::vector<float> data;
+            size_t nbr_keys = 0;    //!< Keys per array
+
+            void resize(size_t nbr_keys);
+
+            glm::vec3* positions() { return reinterpret_cast<glm::vec3*>(data.data()); }
+            glm::quat* rotations() { return reinterpret_cast<glm::quat*>(data.data() + 3 * nbr_keys); }
+            glm::vec3* scales() { return reinterpret_cast<glm::vec3*>(data.data() + 7 * nbr_keys); }
+            const glm::vec3* positions() const { return reinterpret_cast<const glm::vec3*>(data.data()); }
+            const glm::quat* rotations() const { return reinterpret_cast<const glm::quat*>(data.data() + 3 * nbr_keys); }
+            const glm::vec3* scales() const { return reinterpret_cast<const glm::vec3*>(data.data() + 7 * nbr_keys); }
+        };
+
+        /// Location in time of a clip, shared by all channels
+        struct ClipSample
+        {
+            size_t key0 = 0;    //!< Key before the sample time
+            size_t key1 = 0;    //!< Key after the sample time
+            float frac = 0.0f;  //!< Interpolation fraction between key0 and key1
+        };
+
+        /// Keyframes of an animation clip, with channels identified by node name
+        /// rather than node index. May be shared by meshes with the same skeleton,
+        /// see ClipLibrary.
+        struct ClipData
         {
             std::string name;
             float duration_ticks = 0;
             float tps = 1;
-            std::vector<NodeKeyframes> node_animations;
+            float sample_rate = 0;      //!< Samples per second
+            size_t nbr_samples = 0;     //!< Keys per channel
+            std::vector<std::string> channel_names;     //!< Animated node per channel
+            std::vector<ChannelKeys> channels;          //!< Empty if compressed
+            KeyPool keys;                               //!< Empty if compressed
+            bool is_compressed = false;
+            CompressedClip compressed;
+
+            /// Keys and fraction for a normalized time, clamped to [0, 1]
+            ClipSample sampleAt(float ntime) const;
+
+            /// False for streamed clips that are not loaded and have no fallback keys
+            bool hasKeys() const { return is_compressed || !channels.empty(); }
+
+            /// Heap and member bytes held by the clip data
+            size_t byteSize() const;
+
+            /// Keys of a channel around a sample, for the SIMD evaluator
+            TrsKeys keysAt(int channel_index, const ClipSample& sample) const;
+        };
+
+        /// An animation clip of this mesh: clip data, and the channel that animates each node
+        struct AnimationClip
+        {
+            std::shared_ptr<ClipData> data;
+            std::vector<int> node_channels;     //!< Channel per node, EENG_NULL_INDEX if not animated
+            const StreamedClip* stream = nullptr;   //!< Set if keys are streamed by a ClipStreamer
+
+            /// Keys to play: data, or the keys currently provided by the streamer
+            const ClipData& clip() const;
+
+            ClipSample sampleAt(float ntime) const { return clip().sampleAt(ntime); }
+
+            TrsKeys keysAt(int channel_index, const ClipSample& sample) const { return clip().keysAt(channel_index, sample); }
+
+            /// Bytes held by the node table, not counting the clip data
+            size_t byteSize() const;
+
+            /// True if the clip has a channel for a node
+            bool animatesNode(size_t node_index) const;
+        };
+
+        /// A node that animate() updates, see buildEvalList().
+        /// Global transform is ancestor global * offset, times the local transform if animated.
+        struct NodeEval
+        {
+            Affine offset;                          //!< Static transforms from the ancestor to the node
+            uint32_t node_index = 0;
+            int ancestor = EENG_NULL_INDEX;         //!< Nearest animated ancestor, EENG_NULL_INDEX if none
+            bool is_animated = false;               //!< Node has a channel in some clip
+            bool has_offset = false;                //!< Offset is not identity
         };
 
         GLuint m_VAO = 0;
         GLuint m_Buffers[BufferCount] = { 0 };
+        GLenum m_index_type = GL_UNSIGNED_INT;  // GL_UNSIGNED_SHORT if all indices fit, see createBuffers()
+
+        /// Byte offset of an index in the index buffer, for draw calls
+        const GLvoid* indexOffset(unsigned base_index) const
+        {
+            return (const GLvoid*)(size_t(base_index) * (m_index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint)));
+        }
 
     public:
         VecTree<SkeletonNode> m_nodetree;
         std::vector<Bone> m_bones;
-        std::vector<glm::mat4> boneMatrices;
         std::vector<AnimationClip> m_animations;
 
         std::vector<Submesh> m_meshes;
@@ -174,10 +349,16 @@ namespace eeng
 
         // Bounding volumes
         std::vector<AABB> m_bone_aabbs_bind; // Per-bone bind AABB
-        std::vector<AABB> m_bone_aabbs_pose; // Per-node pose AABB's – intermediary, used for visualization
         std::vector<AABB> m_mesh_aabbs_bind; // Per-mesh bind AABB
-        std::vector<AABB> m_mesh_aabbs_pose; // Per-mesh pose AABB's – intermediary, used for visualization
-        AABB m_model_aabb;                   // AABB for the entire model
+
+        // Bind AABB's prepared for per-pose transformation, see buildPoseBounds()
+        AabbSoA m_bone_bounds;      // Transformed by bone matrices
+        AabbSoA m_mesh_bounds;      // Non-skinned meshes, transformed by node transforms
+        AABB m_static_bounds;       // Non-skinned meshes without a node
+
+        // Pose used by the single-instance animate() overloads.
+        // Holds the bind pose unless any of those are called.
+        AnimationPose m_pose;
 
     public:
         unsigned m_embedded_textures_ofs = 0;
@@ -190,6 +371,56 @@ namespace eeng
         // Log & debug stuff
         logstreamer_t log;
 
+    private:
+        float m_sample_rate = DefaultAnimationSampleRate;
+        float m_skin_weight_threshold = DefaultSkinWeightThreshold;
+        AnimationCompression m_compression;
+        AnimationEvaluator m_evaluator = AnimationEvaluator::Simd;
+        std::vector<float> m_node_reach;    // Per-node bind-pose reach relative model size, for animation LOD
+        LocalPose m_bind_local;             // Bind pose as TRS components, for blending
+        std::vector<NodeEval> m_eval_nodes;         // Nodes that lead to bones or meshes, in pre-order
+        std::vector<uint32_t> m_animated_nodes;     // Nodes in m_eval_nodes that are animated
+        bool m_headless = false;
+        ClipLibrary* m_clip_library = nullptr;  // Where clips are shared, if set
+        ResourceCache* m_resource_cache = nullptr;  // Where textures are shared, if set
+        std::vector<std::shared_ptr<Texture2D>> m_shared_textures;  // Per texture, set if shared through the cache
+        size_t m_skeleton_signature = 0;
+
+        // Bind geometry kept on the CPU, see xi_keep_cpu_geometry
+        std::vector<glm::vec3> m_cpu_positions;
+        std::vector<glm::vec3> m_cpu_normals;
+        std::vector<SkinData> m_cpu_skin;
+        bool m_keep_cpu_geometry = false;
+
+        bool m_use_cooked = true;
+        bool m_loaded_cooked = false;
+
+        // GL resources left to create, see xi_defer_upload
+        struct PendingTexture
+        {
+            unsigned index;             // In m_textures
+            texture_image_t image;
+        };
+        struct PendingUpload
+        {
+            std::vector<PackedVertex> vertices;
+            std::vector<uint8_t> indices;       // Of type m_index_type
+            std::vector<PendingTexture> textures;
+        };
+        std::unique_ptr<PendingUpload> m_pending;
+        bool m_defer_upload = false;
+
+        // Morph targets. Morphed attributes are kept for the range of vertices
+        // moved by any target only.
+        std::vector<MorphTarget> m_morph_targets;
+        std::vector<float> m_morph_weights;
+        std::vector<float> m_morph_applied_weights;     // Weights of the last updateMorphTargets()
+        uint32_t m_morph_begin = 0, m_morph_end = 0;
+        std::vector<glm::vec3> m_morph_base_positions;
+        std::vector<glm::vec3> m_morph_base_normals;
+        std::vector<glm::vec3> m_morph_positions;
+        std::vector<glm::vec3> m_morph_normals;
+
     public:
         AABB mSceneAABB;
 
@@ -213,6 +444,81 @@ namespace eeng
             unsigned xiflags,
             unsigned aiflags = 0);
 
+        /// @brief Set the rate that animation clips are resampled to when loaded.
+        /// Only affects clips loaded after the call.
+        /// @param samples_per_sec Samples per second of clip time
+        void setAnimationSampleRate(float samples_per_sec);
+
+        /// @brief Set the weight below which bone influences are pruned when a mesh is loaded.
+        /// Remaining weights are renormalized. Only affects meshes loaded after the call.
+        /// @param threshold Weight threshold, or 0 to keep all non-zero weights
+        void setSkinWeightThreshold(float threshold);
+
+        /// @brief Set if and how animation clips are compressed when loaded.
+        /// Compressed clips store quantized keys, with keys that can be
+        /// interpolated within tolerance removed.
+        /// Only affects clips loaded after the call.
+        /// @param settings Compression settings
+        void setAnimationCompression(const AnimationCompression& settings);
+
+        /// @brief Set if cooked files are used, enabled by default.
+        /// A cooked file (the source file name followed by .eemesh) is written
+        /// after a source file is imported, with the geometry, materials, nodes,
+        /// bones and clips it loaded. Later loads of the source file map the cooked
+        /// file instead of importing, unless the source file, Assimp flags, sample
+        /// rate or skin weight threshold changed. Headless loads read cooked files
+        /// but do not write them for meshes, since they skip materials.
+        void setUseCookedFiles(bool use) { m_use_cooked = use; }
+
+        /// @brief True if the last call to load() read a cooked file
+        bool wasLoadedCooked() const { return m_loaded_cooked; }
+
+        /// @brief True if a load with xi_defer_upload has GL buffers or textures left to create.
+        /// The mesh must not be drawn until they are created.
+        bool hasPendingUpload() const { return (bool)m_pending; }
+
+        /// @brief Create GL buffers and textures of a load with xi_defer_upload
+        /// Textures are created first, then all vertex buffers at once. At least
+        /// one of these is created per call, even if larger than the budget.
+        /// @param budget_bytes Bytes to upload, after which the call returns
+        /// @return Bytes uploaded
+        size_t uploadPending(size_t budget_bytes = SIZE_MAX);
+
+        /// @brief Set a cache to share textures on file through with other meshes
+        /// Only affects textures loaded after the call. The cache must outlive those loads.
+        void setResourceCache(ResourceCache* cache);
+
+        /// @brief Set a library to share clips through with meshes of the same skeleton
+        /// Only affects clips loaded after the call. The library must outlive those loads,
+        /// but not the mesh, which keeps its clips alive.
+        /// @param library Library to use, or nullptr for clips owned by this mesh alone
+        void setClipLibrary(ClipLibrary* library);
+
+        /// @brief Add a clip streamed from a cooked clip file
+        /// The clip plays fallback keys, or the bind pose, until the streamer has loaded it.
+        /// The streamer must outlive the mesh. Throws std::runtime_error if the file is invalid.
+        /// @param streamer Streamer that loads the clip
+        /// @param file Cooked clip file, see cookAnimation()
+        /// @return Clip index
+        int addStreamedAnimation(ClipStreamer& streamer, const std::string& file);
+
+        /// @brief Write a clip to a cooked clip file, for use with addStreamedAnimation()
+        /// The clip must be loaded without compression.
+        /// @param i Clip index
+        /// @param file File to write
+        /// @param fallback_rate Rate of low-rate keys played until the clip is loaded, or 0 for none
+        void cookAnimation(unsigned i, const std::string& file, float fallback_rate = 0.0f) const;
+
+        /// @brief Hash of the names and hierarchy of the bone nodes and their ancestors
+        /// Meshes with equal signatures can share animation clips, see ClipLibrary.
+        size_t getSkeletonSignature() const { return m_skeleton_signature; }
+
+        /// @brief Set how local node transforms are evaluated by animate() and animateBlend().
+        /// The SIMD evaluator interpolates rotations with nlerp and blends clips
+        /// per TRS component. It is not used for compressed clips.
+        /// @param evaluator Evaluator to use
+        void setAnimationEvaluator(AnimationEvaluator evaluator);
+
         /// @brief
         /// @param node_name
         void removeTranslationKeys(const std::string& node_name);
@@ -221,7 +527,43 @@ namespace eeng
         /// @param node_index
         void removeTranslationKeys(int node_index);
 
-        /// @brief Animate this mesh using an animation clip
+        /// @brief Create a pose sized for this mesh, set to bind pose
+        /// @return A pose that can be passed to animate() and animateBlend()
+        AnimationPose createPose() const;
+
+        /// @brief Animate a pose using an animation clip
+        /// The mesh itself is not modified, so many poses may be evaluated
+        /// from the same mesh, e.g. one per instance, ahead of rendering.
+        /// @param pose Pose to write to. Must be created by createPose().
+        /// @param anim_index Clip index. Use -1 for bind pose.
+        /// @param time Animation time, in seconds or normalized time (see animTimeFormat).
+        /// @param animTimeFormat Interpretation of time when mapping to keyframes.
+        void animate(
+            AnimationPose& pose,
+            int anim_index,
+            float time,
+            AnmationTimeFormat animTimeFormat = AnmationTimeFormat::RealTime) const;
+
+        /// @brief Animate a pose using a blend of two animation clips
+        /// @param pose Pose to write to. Must be created by createPose().
+        /// @param anim_index0 Clip index 0. Must be a valid clip.
+        /// @param anim_index1 Clip index 1. Must be a valid clip.
+        /// @param time0 Animation time for clip 0, in seconds or normalized time (see animTimeFormat).
+        /// @param time1 Animation time for clip 1, in seconds or normalized time (see animTimeFormat).
+        /// @param frac Blend fraction, where 0 gives clip 0 and 1 gives clip 1.
+        /// @param animTimeFormat0 Interpretation of time for clip 0 when mapping to keyframes.
+        /// @param animTimeFormat1 Interpretation of time for clip 1 when mapping to keyframes.
+        void animateBlend(
+            AnimationPose& pose,
+            int anim_index0,
+            int anim_index1,
+            float time0,
+            float time1,
+            float frac,
+            AnmationTimeFormat animTimeFormat0 = AnmationTimeFormat::RealTime,
+            AnmationTimeFormat animTimeFormat1 = AnmationTimeFormat::RealTime) const;
+
+        /// @brief Animate the pose of this mesh (m_pose) using an animation clip
         /// @param anim_index Clip index. Use -1 for bind pose.
         /// @param time Animation time, in seconds or normalized time (see animTimeFormat).
         /// @param animTimeFormat Interpretation of time when mapping to keyframes.
@@ -231,7 +573,7 @@ namespace eeng
             AnmationTimeFormat animTimeFormat = AnmationTimeFormat::RealTime);
 
 
-        /// @brief Animate this mesh using a blend of two animation clips
+        /// @brief Animate the pose of this mesh (m_pose) using a blend of two animation clips
         /// @param anim_index0 Clip index 0. Must be a valid clip.
         /// @param anim_index1 Clip index 1. Must be a valid clip.
         /// @param time0 Animation time for clip 0, in seconds or normalized time (see animTimeFormat).
@@ -247,10 +589,103 @@ namespace eeng
             AnmationTimeFormat animTimeFormat0 = AnmationTimeFormat::RealTime,
             AnmationTimeFormat animTimeFormat1 = AnmationTimeFormat::RealTime);
 
+        /// @brief Sample the local transforms of all nodes from a clip, without composing them
+        /// Nodes not animated by the clip are set to bind pose.
+        /// @param local Pose to write to. Sized for this mesh if needed.
+        /// @param anim_index Clip index. Use -1 for bind pose.
+        /// @param time Animation time, in seconds or normalized time (see animTimeFormat).
+        /// @param animTimeFormat Interpretation of time when mapping to keyframes.
+        /// @param cursors Sampling state, used if the clip is compressed.
+        /// @param min_reach Nodes with a reach below this are not sampled (see AnimationPose::lod_min_reach).
+        void sampleLocalPose(
+            LocalPose& local,
+            int anim_index,
+            float time,
+            AnmationTimeFormat animTimeFormat,
+            AnimationPose::KeyCursors& cursors,
+            float min_reach = 0.0f) const;
+
+        /// @brief Set local transforms of a pose from TRS components and update the pose
+        /// @param pose Pose to write to. Must be created by createPose().
+        /// @param local Local transforms, sized for this mesh.
+        void applyLocalPose(
+            AnimationPose& pose,
+            const LocalPose& local) const;
+
+        /// @brief Bind pose as TRS components
+        const LocalPose& getBindLocalPose() const { return m_bind_local; }
+
+        /// @brief True if the mesh was loaded with xi_keep_cpu_geometry
+        bool hasCpuGeometry() const { return !m_cpu_positions.empty(); }
+
+        /// @brief Number of vertices of all submeshes
+        size_t getNbrVertices() const { return m_cpu_positions.size(); }
+
+        /// @brief Positions kept on the CPU, including applied morph targets
+        std::span<const glm::vec3> getCpuPositions() const { return m_cpu_positions; }
+
+        /// @brief Normals kept on the CPU, including applied morph targets
+        std::span<const glm::vec3> getCpuNormals() const { return m_cpu_normals; }
+
+        /// @brief Skin all vertices of the mesh on the CPU, as the vertex shader does
+        /// Output is relative the model, and in the same order as the vertex buffers.
+        /// Non-skinned submeshes are transformed by the global transform of their node.
+        /// Requires the mesh to be loaded with xi_keep_cpu_geometry.
+        /// @param pose Pose to skin with, evaluated by animate() or animateBlend()
+        /// @param out_positions Skinned positions, at least getNbrVertices() long
+        /// @param out_normals Skinned normals, at least getNbrVertices() long, or empty to skip normals
+        /// @param pool Pool to split large submeshes over, or nullptr to run on the calling thread
+        void skin(
+            const AnimationPose& pose,
+            std::span<glm::vec3> out_positions,
+            std::span<glm::vec3> out_normals = {},
+            ThreadPool* pool = nullptr) const;
+
+        /// @brief Number of morph targets of all submeshes
+        unsigned getNbrMorphTargets() const { return (unsigned)m_morph_targets.size(); }
+
+        /// @brief Morph target, with deltas of the vertices it moves
+        const MorphTarget& getMorphTarget(unsigned i) const { return m_morph_targets[i]; }
+
+        /// @brief Index of a morph target by name
+        /// @return Index, or EENG_NULL_INDEX if not found
+        int findMorphTarget(const std::string& name) const;
+
+        /// @brief Set the weight of a morph target. Applied by updateMorphTargets().
+        void setMorphWeight(unsigned i, float weight);
+
+        float getMorphWeight(unsigned i) const { return m_morph_weights[i]; }
+
+        /// @brief Apply morph weights to the vertex buffers
+        /// Only vertices moved by targets with changed weights are recomputed and
+        /// uploaded, and targets with zero weight are skipped. Since the vertex
+        /// buffers are shared, weights apply to all instances of the mesh.
+        /// Also updates the CPU geometry, if kept, so that skin() sees the morph.
+        void updateMorphTargets();
+
+        /// @brief Add a morph target to a loaded mesh
+        /// Requires the mesh to be loaded with xi_keep_cpu_geometry, and all
+        /// morph weights applied so far to be zero.
+        /// @param name Target name
+        /// @param vertices Vertices moved, in increasing order
+        /// @param position_deltas Position delta per vertex
+        /// @param normal_deltas Normal delta per vertex, or empty
+        /// @return Index of the target
+        unsigned addMorphTarget(
+            const std::string& name,
+            std::span<const uint32_t> vertices,
+            std::span<const glm::vec3> position_deltas,
+            std::span<const glm::vec3> normal_deltas = {});
+
         /// @brief
         /// @return
         unsigned getNbrAnimations() const;
 
+        /// @brief Duration of a clip
+        /// @param i Clip index
+        /// @return Duration in seconds
+        float getAnimationDuration(unsigned i) const;
+
         /// @brief
         /// @param i
         /// @return
@@ -258,7 +693,48 @@ namespace eeng
 
     private:
         bool loadScene(const aiScene* pScene,
-            const std::string& file);
+            const std::string& file,
+            SceneGeometry& geometry);
+
+        /// Quantize and interleave vertex attributes. Requires at most 256 bones.
+        static std::vector<PackedVertex> packVertices(const GeometryView& geometry);
+
+        /// Indices as bytes of an index type, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        static std::vector<uint8_t> packIndices(std::span<const uint> indices, GLenum index_type);
+
+        /// Create the vertex array, and the vertex and index buffers
+        /// @param indices Indices of type m_index_type
+        void uploadGeometry(std::span<const PackedVertex> vertices, std::span<const uint8_t> indices);
+
+        /// Pack the geometry and upload it, or keep it for uploadPending() if uploads are deferred.
+        /// Indices are 16-bit if all fit, which they do if submeshes have at most 65536 vertices.
+        void createBuffers(const GeometryView& geometry);
+
+        /// Add a decoded texture, loaded to VRAM now or by uploadPending()
+        /// @return Index of the texture
+        unsigned addTexture(const std::string& name, const std::string& fullpath, texture_image_t image);
+
+        /// Add a texture on file, shared through the resource cache if there is one
+        unsigned addTextureFile(const std::string& name, const std::string& fullpath);
+
+        /// Share a texture loaded to VRAM through the resource cache, if there is one
+        void shareTexture(unsigned index);
+
+        /// Data derived from the node tree, bones and clips, used to evaluate poses
+        void initPoseData();
+
+        /// Load from the cooked file of a source file
+        /// @return False if there is no cooked file, or if it is stale
+        bool loadCooked(const std::string& file, unsigned aiflags, bool append_animations);
+
+        /// Write the cooked file of a source file just imported. Failures are logged.
+        /// @param geometry Imported geometry, or nullptr for a file of clips only
+        /// @param first_clip First clip added by the import
+        void writeCooked(const std::string& file,
+            unsigned aiflags,
+            const aiScene* aiscene,
+            const SceneGeometry* geometry,
+            size_t first_clip);
 
         void loadMesh(uint MeshIndex,
             const aiMesh* paiMesh,
@@ -270,6 +746,18 @@ namespace eeng
             std::vector<SkinData>& Bones,
             std::vector<unsigned int>& Indices);
 
+        /// Sort triangles of skinned submeshes into ranges by SkinVariant
+        void groupTrianglesBySkinVariant(const std::vector<SkinData>& scene_skindata,
+            std::vector<unsigned int>& scene_indices);
+
+        /// Import anim meshes as sparse morph targets
+        void loadMorphTargets(const aiScene* aiscene,
+            const std::vector<glm::vec3>& scene_positions,
+            const std::vector<glm::vec3>& scene_normals);
+
+        /// Copy base attributes for the range of vertices moved by any target
+        void initMorphRange(const glm::vec3* positions, const glm::vec3* normals);
+
         void compute_bind_aabbs(); // not implemented. where?
         void compute_pose_aabbs(); // not implemented. where?
 
@@ -287,21 +775,95 @@ namespace eeng
             aiTextureType tex_type,
             const std::string& local_filepath);
 
-        void loadAnimations(const aiScene* scene);
+        void loadAnimations(const aiScene* scene,
+            const std::string& file);
+
+        /// Resample the keys of a clip, compressed if enabled and compress is set
+        std::shared_ptr<ClipData> loadClip(const aiAnimation* aianim, bool compress = true);
+
+        /// Replace full-precision keys with compressed keys, see setAnimationCompression()
+        void compressClip(ClipData& anim);
+
+        /// Add a clip, with channels mapped to nodes by name
+        void addClip(const std::shared_ptr<ClipData>& data);
+
+        /// Add clips of a file from the clip library, false if not in the library
+        bool addLibraryClips(const std::string& file);
+
+        size_t computeSkeletonSignature() const;
+
+        /// Clip to play for an index and mark it as played, or nullptr for bind pose
+        const AnimationClip* playableClip(int anim_index) const;
+
+        bool sampleNode(
+            size_t node_index,
+            const AnimationClip* anim,
+            const ClipSample& sample,
+            uint16_t* cursors,
+            glm::vec3& pos,
+            glm::quat& rot,
+            glm::vec3& scale) const;
 
         glm::mat4 animateNode(
             size_t node_index,
             const AnimationClip* anim,
-            float ntime) const;
+            const ClipSample& sample,
+            uint16_t* cursors) const;
 
         glm::mat4 animateBlendNode(
             size_t node_index,
             const AnimationClip* anim0,
             const AnimationClip* anim1,
-            float ntime0,
-            float ntime1,
+            const ClipSample& sample0,
+            const ClipSample& sample1,
+            uint16_t* cursors0,
+            uint16_t* cursors1,
+            float frac) const;
+
+        void animateNodesSimd(
+            AnimationPose& pose,
+            const AnimationClip* anim,
+            const ClipSample& sample) const;
+
+        void animateBlendNodesSimd(
+            AnimationPose& pose,
+            const AnimationClip* anim0,
+            const AnimationClip* anim1,
+            const ClipSample& sample0,
+            const ClipSample& sample1,
             float frac) const;
 
+        uint16_t* keyCursors(
+            AnimationPose& pose,
+            int slot,
+            int anim_index) const;
+
+        uint16_t* keyCursors(
+            AnimationPose::KeyCursors& cursors,
+            int anim_index) const;
+
+        float normalizedTime(
+            const AnimationClip* anim,
+            float time,
+            AnmationTimeFormat animTimeFormat) const;
+
+        bool isNodeSkipped(const AnimationPose& pose, size_t node_index) const
+        {
+            return m_node_reach[node_index] < pose.lod_min_reach;
+        }
+
+        void computeNodeReach();
+
+        void computeBindLocalPose();
+
+        void buildEvalList();
+
+        void buildPoseBounds();
+
+        void updatePoseGlobals(AnimationPose& pose) const;
+
+        void updatePoseBones(AnimationPose& pose) const;
+
         AABB measureScene(const aiScene* aiscene);
 
         void measureNode(const aiScene* aiscene,
@@ -0,0 +1,113 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <algorithm>
+#include <filesystem>
+#include "ResourceCache.hpp"
+
+namespace eeng
+{
+    std::shared_ptr<RenderableMesh> ResourceCache::loadMesh(
+        const std::string& file,
+        unsigned xiflags,
+        unsigned aiflags)
+    {
+        if (auto mesh = findMesh(file, xiflags, aiflags))
+            return mesh;
+
+        auto mesh = std::make_shared<RenderableMesh>();
+        mesh->setResourceCache(this);
+        mesh->load(file, xiflags, aiflags);
+        return insertMesh(file, xiflags, aiflags, mesh);
+    }
+
+    std::shared_ptr<RenderableMesh> ResourceCache::findMesh(
+        const std::string& file,
+        unsigned xiflags,
+        unsigned aiflags) const
+    {
+        const auto key = meshKey(file, xiflags, aiflags);
+        std::lock_guard lock(m_mutex);
+        const auto it = m_meshes.find(key);
+        return it != m_meshes.end() ? it->second.lock() : nullptr;
+    }
+
+    std::shared_ptr<RenderableMesh> ResourceCache::insertMesh(
+        const std::string& file,
+        unsigned xiflags,
+        unsigned aiflags,
+        std::shared_ptr<RenderableMesh> mesh)
+    {
+        const auto key = meshKey(file, xiflags, aiflags);
+        std::lock_guard lock(m_mutex);
+        auto& entry = m_meshes[key];
+        if (auto existing = entry.lock())
+            return existing;
+        entry = mesh;
+        return mesh;
+    }
+
+    void ResourceCache::eraseMesh(const std::shared_ptr<RenderableMesh>& mesh)
+    {
+        std::lock_guard lock(m_mutex);
+        std::erase_if(m_meshes, [&](const auto& entry) { return entry.second.lock() == mesh; });
+    }
+
+    std::shared_ptr<Texture2D> ResourceCache::findTexture(const std::string& fullpath) const
+    {
+        const auto key = canonicalPath(fullpath);
+        std::lock_guard lock(m_mutex);
+        const auto it = m_textures.find(key);
+        return it != m_textures.end() ? it->second.lock() : nullptr;
+    }
+
+    std::shared_ptr<Texture2D> ResourceCache::insertTexture(const Texture2D& texture)
+    {
+        const auto key = canonicalPath(texture.m_fullpath);
+        std::lock_guard lock(m_mutex);
+        auto& entry = m_textures[key];
+        if (auto existing = entry.lock())
+            return existing;
+
+        // Freed with the last user, which is on the GL thread since meshes are
+        std::shared_ptr<Texture2D> shared(new Texture2D(texture), [](Texture2D* texture)
+            {
+                texture->free();
+                delete texture;
+            });
+        entry = shared;
+        return shared;
+    }
+
+    size_t ResourceCache::nbrMeshes() const
+    {
+        std::lock_guard lock(m_mutex);
+        return std::count_if(m_meshes.begin(), m_meshes.end(), [](const auto& entry) { return !entry.second.expired(); });
+    }
+
+    size_t ResourceCache::nbrTextures() const
+    {
+        std::lock_guard lock(m_mutex);
+        return std::count_if(m_textures.begin(), m_textures.end(), [](const auto& entry) { return !entry.second.expired(); });
+    }
+
+    void ResourceCache::purge()
+    {
+        std::lock_guard lock(m_mutex);
+        std::erase_if(m_meshes, [](const auto& entry) { return entry.second.expired(); });
+        std::erase_if(m_textures, [](const auto& entry) { return entry.second.expired(); });
+    }
+
+    std::string ResourceCache::meshKey(const std::string& file, unsigned xiflags, unsigned aiflags)
+    {
+        // Deferred uploads give the same mesh once uploaded
+        return canonicalPath(file) + "|" + std::to_string(xiflags & ~xi_defer_upload) + "|" + std::to_string(aiflags);
+    }
+
+    std::string ResourceCache::canonicalPath(const std::string& file)
+    {
+        std::error_code ec;
+        const auto path = std::filesystem::weakly_canonical(file, ec);
+        return (ec ? std::filesystem::path(file).lexically_normal() : path).generic_string();
+    }
+
+} // namespace eeng
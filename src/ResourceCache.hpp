@@ -0,0 +1,81 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef ResourceCache_hpp
+#define ResourceCache_hpp
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "RenderableMesh.hpp"
+
+namespace eeng
+{
+    /// @brief Meshes and textures shared by path
+    /// Meshes are keyed by canonical path and load flags, textures by canonical
+    /// path. The cache only holds weak references: a resource, and its GL
+    /// buffers or texture, is released when its last user drops it, and is
+    /// loaded again if requested after that.
+    /// Cached meshes are shared, so per-instance state belongs in poses.
+    /// Edits such as morph weights or RenderableMesh::removeTranslationKeys()
+    /// affect all users of a mesh.
+    /// Thread-safe, since meshes loading on MeshLoader threads look up textures.
+    class ResourceCache
+    {
+    public:
+        /// @brief Load a mesh, or find it if loaded and still in use
+        /// @param file Mesh file
+        /// @param xiflags See RenderableMesh::load()
+        /// @param aiflags Assimp post-processing flags
+        std::shared_ptr<RenderableMesh> loadMesh(
+            const std::string& file,
+            unsigned xiflags = xi_load_meshes | xi_load_animations,
+            unsigned aiflags = DefaultAiFlags);
+
+        /// @brief A mesh in use, or nullptr
+        std::shared_ptr<RenderableMesh> findMesh(
+            const std::string& file,
+            unsigned xiflags,
+            unsigned aiflags) const;
+
+        /// @brief Add a mesh, loaded or about to be loaded
+        /// @return The mesh added, or a mesh of the same key that is already in use
+        std::shared_ptr<RenderableMesh> insertMesh(
+            const std::string& file,
+            unsigned xiflags,
+            unsigned aiflags,
+            std::shared_ptr<RenderableMesh> mesh);
+
+        /// @brief Remove a mesh, e.g. if its load failed
+        void eraseMesh(const std::shared_ptr<RenderableMesh>& mesh);
+
+        /// @brief A texture in use, or nullptr
+        std::shared_ptr<Texture2D> findTexture(const std::string& fullpath) const;
+
+        /// @brief Add a texture loaded to VRAM. It is freed when the last user drops it.
+        /// @return The texture added, or a texture of the same path that is already in use
+        std::shared_ptr<Texture2D> insertTexture(const Texture2D& texture);
+
+        /// @brief Number of meshes in use
+        size_t nbrMeshes() const;
+
+        /// @brief Number of textures in use
+        size_t nbrTextures() const;
+
+        /// @brief Remove entries of resources no longer in use
+        void purge();
+
+    private:
+        static std::string meshKey(const std::string& file, unsigned xiflags, unsigned aiflags);
+
+        static std::string canonicalPath(const std::string& file);
+
+        std::unordered_map<std::string, std::weak_ptr<RenderableMesh>> m_meshes;
+        std::unordered_map<std::string, std::weak_ptr<Texture2D>> m_textures;
+        mutable std::mutex m_mutex;
+    };
+
+} // namespace eeng
+
+#endif /* ResourceCache_hpp */
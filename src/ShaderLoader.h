@@ -100,4 +100,37 @@ static GLuint createShaderProgram(const char *vertexShaderSource,
 	return program;
 }
 
+/// Vertex-only program that captures outputs with transform feedback, one buffer per varying
+static GLuint createFeedbackShaderProgram(const char *vertexShaderSource,
+										  const char *const *varyings,
+										  GLsizei nbrVaryings)
+{
+	CheckAndThrowGLErrors();
+
+	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vertexShader, 1, &vertexShaderSource, 0);
+
+	std::cout << "Compiling feedback vertex shader..." << std::endl;
+	glCompileShader(vertexShader);
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertexShader);
+	printShaderLog(program, vertexShader);
+
+	// Varyings are set before linking
+	glTransformFeedbackVaryings(program, nbrVaryings, varyings, GL_SEPARATE_ATTRIBS);
+	glLinkProgram(program);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (glGetError() != GL_NO_ERROR || !linked)
+	{
+		std::cerr << "errors:\n";
+		printShaderLog(program, vertexShader);
+		throw std::runtime_error("shader compilation failed");
+	}
+
+	return program;
+}
+
 #endif
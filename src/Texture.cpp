@@ -31,30 +31,38 @@ void Texture2D::load_from_file(const std::string &filename,
                                const std::string &fullpath)
 {
     m_fullpath = fullpath;
+    load_image(filename, decode_file(fullpath));
+}
+
+// Load from an (embedded) aiTexture and not from file
+// void gl_texture_t::load_from_memory(const std::string& filename, const aiTexture* ait)
+void Texture2D::load_from_memory(const std::string &name,
+                                 const unsigned char *data,
+                                 int len)
+{
+    // Compressed embedded texture
+    load_image(name, decode_memory(name, data, len));
+}
 
+texture_image_t Texture2D::decode_file(const std::string &fullpath)
+{
     unsigned char *image;
     int w, h, channels;
 
-    if (!(image = stbi_load(m_fullpath.c_str(), &w, &h, &channels, 0)))
+    if (!(image = stbi_load(fullpath.c_str(), &w, &h, &channels, 0)))
     {
-        if (!(image = stbi_load(lowercase_of(m_fullpath).c_str(), &w, &h, &channels, 0)))
+        if (!(image = stbi_load(lowercase_of(fullpath).c_str(), &w, &h, &channels, 0)))
         {
-            throw std::runtime_error("Error loading texture " + m_fullpath + "\n");
+            throw std::runtime_error("Error loading texture " + fullpath + "\n");
         }
     }
-
-    load_image(filename, image, w, h, channels);
-    stbi_image_free(image);
+    return { std::shared_ptr<const unsigned char>(image, stbi_image_free), w, h, channels };
 }
 
-// Load from an (embedded) aiTexture and not from file
-// void gl_texture_t::load_from_memory(const std::string& filename, const aiTexture* ait)
-void Texture2D::load_from_memory(const std::string &name,
-                                 const unsigned char *data,
-                                 int len)
+texture_image_t Texture2D::decode_memory(const std::string &name,
+                                         const unsigned char *data,
+                                         int len)
 {
-    // Compressed embedded texture
-
     int w, h, channels;
     unsigned char *image;
     image = stbi_load_from_memory(data,
@@ -64,10 +72,24 @@ void Texture2D::load_from_memory(const std::string &name,
     {
         throw std::runtime_error("Error loading texture " + name + "\n");
     }
+    return { std::shared_ptr<const unsigned char>(image, stbi_image_free), w, h, channels };
+}
 
-    CheckAndThrowGLErrors();
-    load_image(name, image, w, h, channels);
-    stbi_image_free(image);
+texture_image_t Texture2D::copy_image(const unsigned char *image,
+                                      int w,
+                                      int h,
+                                      int channels)
+{
+    const size_t size = (size_t)w * h * channels;
+    std::shared_ptr<unsigned char> pixels(new unsigned char[size], std::default_delete<unsigned char[]>());
+    std::copy(image, image + size, pixels.get());
+    return { pixels, w, h, channels };
+}
+
+void Texture2D::load_image(const std::string &name,
+                           const texture_image_t &image)
+{
+    load_image(name, image.pixels.get(), image.width, image.height, image.channels);
 }
 
 void Texture2D::load_image(const std::string &name,
@@ -5,6 +5,7 @@
 #define texture_hpp
 
 #include <stdio.h>
+#include <memory>
 #include "glcommon.h"
 #include "config.h"
 #include "parseutil.h"
@@ -12,6 +13,15 @@
 struct texture_filter_mode_t { GLuint min_filter, mag_filter; };
 struct texture_address_mode_t { GLuint s_mode, t_mode; };
 
+// Decoded image data, not yet loaded to VRAM
+struct texture_image_t
+{
+    std::shared_ptr<const unsigned char> pixels;
+    int width = 0, height = 0, channels = 0;
+
+    size_t size() const { return (size_t)width * height * channels; }
+};
+
 class Texture2D
 {
 public:
@@ -40,6 +50,21 @@ public:
                     int w,
                     int h,
                     int channels);
+
+    void load_image(const std::string& name,
+                    const texture_image_t& image);
+
+    // Decoding needs no GL context, so it can run on any thread
+    static texture_image_t decode_file(const std::string& fullpath);
+
+    static texture_image_t decode_memory(const std::string& name,
+                                         const unsigned char* data,
+                                         int len);
+
+    static texture_image_t copy_image(const unsigned char* image,
+                                      int w,
+                                      int h,
+                                      int channels);
     
     GLuint getHandle();
 
@@ -0,0 +1,125 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace eeng
+{
+    ThreadPool::ThreadPool(unsigned nbr_workers)
+    {
+        if (!nbr_workers)
+            nbr_workers = std::max(1u, std::thread::hardware_concurrency());
+        m_nbr_workers = nbr_workers;
+        m_queues = std::make_unique<WorkQueue[]>(nbr_workers);
+
+        // Worker 0 is the thread calling parallelFor
+        for (unsigned i = 1; i < nbr_workers; i++)
+            m_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_start_cv.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    void ThreadPool::parallelFor(size_t count, size_t grain_size, const RangeFunc& func)
+    {
+        if (!count) return;
+        grain_size = std::max<size_t>(1, grain_size);
+
+        if (m_threads.empty() || count <= grain_size)
+        {
+            func(0, count);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            // Deal chunks to workers. Workers are idle, so queues can be filled without locking them.
+            unsigned worker = 0;
+            for (size_t begin = 0; begin < count; begin += grain_size)
+            {
+                m_queues[worker].ranges.push_back({ begin, std::min(begin + grain_size, count) });
+                worker = (worker + 1) % m_nbr_workers;
+            }
+
+            m_func = &func;
+            m_busy_threads = (unsigned)m_threads.size();
+            m_generation++;
+        }
+        m_start_cv.notify_all();
+
+        runWorker(0);
+
+        // Wait for workers still running their last chunks
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done_cv.wait(lock, [this] { return m_busy_threads == 0; });
+        m_func = nullptr;
+    }
+
+    void ThreadPool::workerLoop(unsigned worker)
+    {
+        uint64_t generation = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_start_cv.wait(lock, [&] { return m_stop || m_generation != generation; });
+                if (m_stop) return;
+                generation = m_generation;
+            }
+
+            runWorker(worker);
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (--m_busy_threads == 0)
+                    m_done_cv.notify_one();
+            }
+        }
+    }
+
+    void ThreadPool::runWorker(unsigned worker)
+    {
+        Range range;
+        while (popOrSteal(worker, range))
+            (*m_func)(range.begin, range.end);
+    }
+
+    bool ThreadPool::popOrSteal(unsigned worker, Range& range)
+    {
+        {
+            auto& queue = m_queues[worker];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.ranges.empty())
+            {
+                range = queue.ranges.front();
+                queue.ranges.pop_front();
+                return true;
+            }
+        }
+
+        // No work is added during a parallelFor, so all queues being empty means we are done
+        for (unsigned i = 1; i < m_nbr_workers; i++)
+        {
+            auto& queue = m_queues[(worker + i) % m_nbr_workers];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.ranges.empty())
+            {
+                range = queue.ranges.back();
+                queue.ranges.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+} // namespace eeng
@@ -0,0 +1,77 @@
+// Licensed under the MIT License. See LICENSE file for details.
+
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace eeng
+{
+    /// @brief Fixed set of worker threads that run parallel loops
+    /// Work is split into chunks that are dealt out to per-worker queues.
+    /// A worker takes chunks from the front of its own queue, and when it
+    /// runs dry, steals from the back of the queues of other workers.
+    /// The calling thread takes part as worker 0.
+    class ThreadPool
+    {
+    public:
+        /// Function run for a chunk of indices [begin, end)
+        using RangeFunc = std::function<void(size_t begin, size_t end)>;
+
+        /// @brief Start worker threads
+        /// @param nbr_workers Workers including the calling thread. 0 gives one per hardware thread.
+        explicit ThreadPool(unsigned nbr_workers = 0);
+
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /// @brief Number of workers, including the calling thread
+        unsigned nbrWorkers() const { return m_nbr_workers; }
+
+        /// @brief Run func over [0, count) in chunks, and return when all chunks are done
+        /// Not reentrant: func must not call parallelFor on the same pool, and must not throw.
+        /// @param count Number of indices
+        /// @param grain_size Largest number of indices per chunk
+        /// @param func Function to run per chunk
+        void parallelFor(size_t count, size_t grain_size, const RangeFunc& func);
+
+    private:
+        struct Range
+        {
+            size_t begin, end;
+        };
+
+        struct WorkQueue
+        {
+            std::mutex mutex;
+            std::deque<Range> ranges;
+        };
+
+        void workerLoop(unsigned worker);
+        void runWorker(unsigned worker);
+        bool popOrSteal(unsigned worker, Range& range);
+
+        unsigned m_nbr_workers = 1;
+        std::vector<std::thread> m_threads;
+        std::unique_ptr<WorkQueue[]> m_queues;
+
+        std::mutex m_mutex;
+        std::condition_variable m_start_cv;
+        std::condition_variable m_done_cv;
+        const RangeFunc* m_func = nullptr;
+        uint64_t m_generation = 0;  // Incremented per parallelFor
+        unsigned m_busy_threads = 0;
+        bool m_stop = false;
+    };
+
+} // namespace eeng
+
+#endif /* ThreadPool_hpp */
@@ -329,24 +329,21 @@ bool erase_branch(const PayloadType& payload)
 }
 
 
-    /// @brief Traverse depth-first in a per-level manner
-    /// @param node_name Name of node to descend from
-    /// Useful for hierarchical transformations. The tree is optimized for this type of traversal.
-    /// F is a function of type void(PayloadType* node, PayloadType* parent, size_t node_index, size_t parent_index)
-    template<class F>
-        requires std::invocable<F, PayloadType*, PayloadType*, size_t, size_t>
-    void traverse_progressive(
+private:
+    template<class T, class F>
+    static void traverse_progressive_impl(
+        T& self,
         size_t start_index,
         const F& func)
     {
         //auto start_node_index = find_node_index(payload);
         // assert(start_node_index != VecTree_NullIndex);
-        assert(start_index >= 0 && start_index < size());
+        assert(start_index >= 0 && start_index < self.size());
 
-        for (int i = 0; i < nodes[start_index].m_branch_stride; i++)
+        for (int i = 0; i < self.nodes[start_index].m_branch_stride; i++)
         {
             auto node_index = start_index + i;
-            auto& node = nodes[node_index];
+            auto& node = self.nodes[node_index];
 
             if (!node.m_parent_ofs)
                 func(&node.m_payload, nullptr, node_index, 0);
@@ -354,12 +351,51 @@ bool erase_branch(const PayloadType& payload)
             size_t child_index = node_index + 1;
             for (int j = 0; j < node.m_nbr_children; j++)
             {
-                func(&nodes[child_index].m_payload, &node.m_payload, child_index, node_index);
-                child_index += nodes[child_index].m_branch_stride;
+                func(&self.nodes[child_index].m_payload, &node.m_payload, child_index, node_index);
+                child_index += self.nodes[child_index].m_branch_stride;
             }
         }
     }
 
+    template<class T, class F>
+    static void traverse_progressive_impl(
+        T& self,
+        const F& func)
+    {
+        // if (size())
+        //     traverse_progressive(0, func);
+
+        size_t i = 0;
+        while (i < self.size())
+        {
+            traverse_progressive_impl(self, i, func);
+            i += self.nodes[i].m_branch_stride;
+        }
+    }
+
+public:
+    /// @brief Traverse depth-first in a per-level manner
+    /// @param node_name Name of node to descend from
+    /// Useful for hierarchical transformations. The tree is optimized for this type of traversal.
+    /// F is a function of type void(PayloadType* node, PayloadType* parent, size_t node_index, size_t parent_index)
+    template<class F>
+        requires std::invocable<F, PayloadType*, PayloadType*, size_t, size_t>
+    void traverse_progressive(
+        size_t start_index,
+        const F& func)
+    {
+        traverse_progressive_impl(*this, start_index, func);
+    }
+
+    template<class F>
+        requires std::invocable<F, const PayloadType*, const PayloadType*, size_t, size_t>
+    void traverse_progressive(
+        size_t start_index,
+        const F& func) const
+    {
+        traverse_progressive_impl(*this, start_index, func);
+    }
+
     template<class F>
         requires std::invocable<F, PayloadType*, PayloadType*, size_t, size_t>
     void traverse_progressive(
@@ -376,15 +412,15 @@ bool erase_branch(const PayloadType& payload)
     void traverse_progressive(
         const F& func)
     {
-        // if (size())
-        //     traverse_progressive(0, func);
+        traverse_progressive_impl(*this, func);
+    }
 
-        size_t i = 0;
-        while (i < size())
-        {
-            traverse_progressive(i, func);
-            i += nodes[i].m_branch_stride;
-        }
+    template<class F>
+        requires std::invocable<F, const PayloadType*, const PayloadType*, size_t, size_t>
+    void traverse_progressive(
+        const F& func) const
+    {
+        traverse_progressive_impl(*this, func);
     }
 
     /// @brief Traverse tree depth-first without level information